@@ -41,29 +41,32 @@ layout (std140, binding = 1) uniform Lights
 struct Material
 {
     vec3 ambient;
+    float shininess;
     vec3 diffuse;
+    uint useAmbient;
     vec3 specular;
-    float shininess;
+    uint useDiffuse;
+    uint useSpecular;
 };
-struct Textures
+
+layout (std430, binding = 2) readonly buffer Materials
 {
-    bool useAmbient;
-    sampler2D ambient;
-    bool useDiffuse;
-    sampler2D diffuse;
-    bool useSpecular;
-    sampler2D specular;
+    Material materials[];
 };
 
+layout (binding = 0) uniform sampler2D ambientTexture;
+layout (binding = 1) uniform sampler2D diffuseTexture;
+layout (binding = 2) uniform sampler2D specularTexture;
+
 in vec3 normal;
 in vec3 fragPos;
 in vec3 viewLightPos;
 in vec2 TexCoord;
+flat in uint materialIndex;
 
 out vec4 FragColour;
 
-uniform Material material;
-uniform Textures textures;
+Material material;
 
 vec3 pointLightContribution(PointLight pointLight, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 spotlightContribution(Spotlight spotlight, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -71,6 +74,8 @@ vec3 directionalLightContribution(DirectionalLight directionalLight, vec3 normal
 
 void main()
 {
+    material = materials[materialIndex];
+
     vec3 ambientLight = ambientLightColour * material.ambient;
 
     vec3 norm = normalize(normal);
@@ -107,18 +112,18 @@ vec3 pointLightContribution(PointLight pointLight, vec3 normal, vec3 fragPos, ve
     float attenuation = 1.0 / (pointLight.constantAttenuation + pointLight.linearAttenuation * dist + pointLight.quadraticAttenuation * dist * dist);
     // combine
     vec3 diffuse;
-    if (textures.useDiffuse) 
+    if (material.useDiffuse != 0u) 
     {
-        diffuse = pointLight.colour * diff * vec3(texture(textures.diffuse, TexCoord));
+        diffuse = pointLight.colour * diff * vec3(texture(diffuseTexture, TexCoord));
     }
     else
     {
         diffuse = pointLight.colour * diff * material.diffuse;
     }
     vec3 specular;
-    if (textures.useSpecular)
+    if (material.useSpecular != 0u)
     {
-        specular = pointLight.colour * spec * vec3(texture(textures.specular, TexCoord));
+        specular = pointLight.colour * spec * vec3(texture(specularTexture, TexCoord));
     }
     else
     {
@@ -143,18 +148,18 @@ vec3 spotlightContribution(Spotlight spotlight, vec3 normal, vec3 fragPos, vec3
     float attenuation = 1.0 / (spotlight.constantAttenuation + spotlight.linearAttenuation * dist + spotlight.quadraticAttenuation * dist * dist);
     // combine
     vec3 diffuse;
-    if (textures.useDiffuse) 
+    if (material.useDiffuse != 0u) 
     {
-        diffuse = spotlight.colour * diff * vec3(texture(textures.diffuse, TexCoord));
+        diffuse = spotlight.colour * diff * vec3(texture(diffuseTexture, TexCoord));
     }
     else
     {
         diffuse = spotlight.colour * diff * material.diffuse;
     }
     vec3 specular;
-    if (textures.useSpecular)
+    if (material.useSpecular != 0u)
     {
-        specular = spotlight.colour * spec * vec3(texture(textures.specular, TexCoord));
+        specular = spotlight.colour * spec * vec3(texture(specularTexture, TexCoord));
     }
     else
     {
@@ -173,18 +178,18 @@ vec3 directionalLightContribution(DirectionalLight directionalLight, vec3 normal
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine
     vec3 diffuse;
-    if (textures.useDiffuse) 
+    if (material.useDiffuse != 0u) 
     {
-        diffuse = directionalLight.colour * diff * vec3(texture(textures.diffuse, TexCoord));
+        diffuse = directionalLight.colour * diff * vec3(texture(diffuseTexture, TexCoord));
     }
     else
     {
         diffuse = directionalLight.colour * diff * material.diffuse;
     }
     vec3 specular;
-    if (textures.useSpecular)
+    if (material.useSpecular != 0u)
     {
-        specular = directionalLight.colour * spec * vec3(texture(textures.specular, TexCoord));
+        specular = directionalLight.colour * spec * vec3(texture(specularTexture, TexCoord));
     }
     else
     {
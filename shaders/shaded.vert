@@ -1,8 +1,16 @@
 #version 460 core
 
+#ifdef STERLING_PACKED_VERTICES
+// positions are fractions of the primitive's bounds, the model matrix takes them back to local space
+layout (location = 0) in vec3 packedPos;
+layout (location = 1) in vec2 packedNormal;
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 texCoord;
+layout (location = 3) in mat4 model;
+layout (location = 7) in uint instanceMaterial;
 
 layout (std140, binding = 0) uniform Matrices
 {
@@ -14,14 +22,30 @@ out vec3 normal;
 out vec3 fragPos;
 out vec3 viewLightPos;
 out vec2 TexCoord;
+flat out uint materialIndex;
 
-uniform mat4 model;
+#ifdef STERLING_PACKED_VERTICES
+vec3 octahedralDecode(vec2 encoded)
+{
+    vec3 decoded = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (decoded.z < 0.0)
+    {
+        decoded.xy = (1.0 - abs(encoded.yx)) * vec2(encoded.x >= 0.0 ? 1.0 : -1.0, encoded.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(decoded);
+}
+#endif
 
 void main()
 {
+#ifdef STERLING_PACKED_VERTICES
+    vec3 aPos = packedPos;
+    vec3 aNormal = octahedralDecode(packedNormal);
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     vec3 modelNormal = mat3(transpose(inverse(model))) * aNormal;
     normal = mat3(view) * modelNormal;
     fragPos = vec3(view * model * vec4(aPos, 1.0));
     TexCoord = texCoord;
+    materialIndex = instanceMaterial;
 }
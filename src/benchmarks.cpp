@@ -0,0 +1,264 @@
+#include "benchmarks.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string.h>
+#include "mesh.h"
+#include "objectfile.h"
+#include "objparser.h"
+
+/// <summary>
+/// A reader of a file into a mesh, for timing
+/// </summary>
+typedef bool (*MeshReader)(const char* path, Mesh* mesh);
+
+/// <summary>
+/// Run a task several times and keep the best time
+/// </summary>
+static BenchmarkResult time_task(const char* name, std::function<bool()> task, unsigned long long fileBytes, unsigned int repetitions)
+{
+	BenchmarkResult result;
+	result.name = name;
+	result.milliseconds = 0;
+	result.megabytesPerSecond = 0;
+	result.succeeded = true;
+	for (unsigned int repetition = 0; repetition < repetitions && result.succeeded; repetition++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		result.succeeded = task();
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (repetition == 0 || milliseconds < result.milliseconds)
+		{
+			result.milliseconds = milliseconds;
+		}
+	}
+	if (result.succeeded && result.milliseconds > 0)
+	{
+		result.megabytesPerSecond = fileBytes / (1024.0 * 1024.0) / (result.milliseconds / 1000.0);
+	}
+	return result;
+}
+
+/// <summary>
+/// Run a reader several times on a file and keep the best time
+/// </summary>
+static BenchmarkResult time_reader(const char* name, MeshReader reader, const std::string& path, unsigned long long fileBytes, unsigned int repetitions)
+{
+	return time_task(name, [reader, &path]()
+	{
+		Mesh* mesh = new Mesh();
+		bool succeeded = reader(path.c_str(), mesh);
+		delete mesh;
+		return succeeded;
+	}, fileBytes, repetitions);
+}
+
+/// <summary>
+/// Whether two names are equal, or both missing
+/// </summary>
+static bool same_name(const char* a, const char* b)
+{
+	return (a == NULL && b == NULL) || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+/// <summary>
+/// Whether two materials have the same name, parameters and texture maps, their maps compared by texture name and path
+/// </summary>
+static bool same_material(fastObjMesh* a, const fastObjMaterial& materialA, fastObjMesh* b, const fastObjMaterial& materialB)
+{
+	// the parameters run from Ka to fallback without padding
+	bool same = same_name(materialA.name, materialB.name)
+		&& memcmp(&materialA.Ka, &materialB.Ka, (const char*)&materialA.map_Ka - (const char*)&materialA.Ka) == 0;
+	const unsigned int* mapsA = &materialA.map_Ka;
+	const unsigned int* mapsB = &materialB.map_Ka;
+	for (int map = 0; map < 9 && same; map++)
+	{
+		same = mapsA[map] < a->texture_count && mapsB[map] < b->texture_count && same_name(a->textures[mapsA[map]].name, b->textures[mapsB[map]].name)
+			&& same_name(a->textures[mapsA[map]].path, b->textures[mapsB[map]].path);
+	}
+	return same;
+}
+
+/// <summary>
+/// Whether two parsed .obj files have the same attributes, faces, materials and textures
+/// </summary>
+static bool same_obj(fastObjMesh* a, fastObjMesh* b)
+{
+	bool same = a->position_count == b->position_count && a->texcoord_count == b->texcoord_count && a->normal_count == b->normal_count
+		&& a->face_count == b->face_count && a->index_count == b->index_count && a->material_count == b->material_count
+		&& a->texture_count == b->texture_count
+		&& memcmp(a->positions, b->positions, a->position_count * 3 * sizeof(float)) == 0
+		&& memcmp(a->texcoords, b->texcoords, a->texcoord_count * 2 * sizeof(float)) == 0
+		&& memcmp(a->normals, b->normals, a->normal_count * 3 * sizeof(float)) == 0
+		&& memcmp(a->face_vertices, b->face_vertices, a->face_count * sizeof(unsigned int)) == 0
+		&& memcmp(a->face_materials, b->face_materials, a->face_count * sizeof(unsigned int)) == 0
+		&& memcmp(a->indices, b->indices, a->index_count * sizeof(fastObjIndex)) == 0;
+	for (unsigned int materialIndex = 0; materialIndex < a->material_count && same; materialIndex++)
+	{
+		same = same_material(a, a->materials[materialIndex], b, b->materials[materialIndex]);
+	}
+	return same;
+}
+
+std::vector<BenchmarkResult> benchmarks::object_readers(unsigned int faceCount, unsigned int repetitions)
+{
+	std::vector<BenchmarkResult> results;
+	if (faceCount == 0)
+	{
+		return results;
+	}
+	std::error_code error;
+	std::string path = (std::filesystem::temp_directory_path(error) / "sterling_benchmark.object").string();
+
+	// one faced primitive with as many of each attribute as faces, indexed in a scattered order
+	std::ofstream objectFile(path, std::ios::binary);
+	if (!objectFile)
+	{
+		std::cerr << "ERROR::BENCHMARK::CANNOT_WRITE_FILE\n" << path << std::endl;
+		return results;
+	}
+	unsigned int zero = 0;
+	unsigned int one = 1;
+	unsigned char renderingMode = 0x02;
+	objectFile.write("OBJT", 4);
+	objectFile.write((const char*)&zero, 4);
+	objectFile.write((const char*)&one, 4);
+	objectFile.write((const char*)&zero, 4);
+	objectFile.write((const char*)&renderingMode, 1);
+	for (int count = 0; count < 4; count++)
+	{
+		objectFile.write((const char*)&faceCount, 4);
+	}
+	unsigned int random = 12345;
+	std::vector<float> attributes((size_t)faceCount * 3);
+	for (int attribute = 0; attribute < 3; attribute++)
+	{
+		// positions and normals have 3 components, texture coordinates 2
+		unsigned int components = attribute < 2 ? 3 : 2;
+		for (size_t component = 0; component < (size_t)faceCount * components; component++)
+		{
+			random = random * 1664525u + 1013904223u;
+			attributes[component] = (random >> 8) / 16777216.0f;
+		}
+		objectFile.write((const char*)attributes.data(), (size_t)faceCount * components * sizeof(float));
+	}
+	std::vector<unsigned int> faces((size_t)faceCount * 9);
+	for (size_t index = 0; index < faces.size(); index++)
+	{
+		random = random * 1664525u + 1013904223u;
+		faces[index] = (random >> 8) % faceCount;
+	}
+	objectFile.write((const char*)faces.data(), faces.size() * sizeof(unsigned int));
+	objectFile.close();
+	if (!objectFile)
+	{
+		std::cerr << "ERROR::BENCHMARK::CANNOT_WRITE_FILE\n" << path << std::endl;
+		return results;
+	}
+	unsigned long long fileBytes = std::filesystem::file_size(path, error);
+
+	results.push_back(time_reader("Stream reader", objectfile::read_stream, path, fileBytes, repetitions));
+	results.push_back(time_reader("Mapped reader", objectfile::read_mapped, path, fileBytes, repetitions));
+	std::filesystem::remove(path, error);
+	return results;
+}
+
+std::vector<BenchmarkResult> benchmarks::obj_parsers(unsigned int faceCount, unsigned int repetitions)
+{
+	std::vector<BenchmarkResult> results;
+	if (faceCount == 0)
+	{
+		return results;
+	}
+	std::error_code error;
+	std::string path = (std::filesystem::temp_directory_path(error) / "sterling_benchmark.obj").string();
+
+	// as many of each attribute as faces, indexed in a scattered order, with a material switch every thousand faces
+	std::ofstream objFile(path, std::ios::binary);
+	if (!objFile)
+	{
+		std::cerr << "ERROR::BENCHMARK::CANNOT_WRITE_FILE\n" << path << std::endl;
+		return results;
+	}
+	unsigned int random = 12345;
+	char line[128];
+	const char* attributeTags[3] = { "v", "vn", "vt" };
+	for (int attribute = 0; attribute < 3; attribute++)
+	{
+		for (unsigned int index = 0; index < faceCount; index++)
+		{
+			float components[3];
+			for (int component = 0; component < 3; component++)
+			{
+				random = random * 1664525u + 1013904223u;
+				components[component] = (random >> 8) / 16777216.0f;
+			}
+			int length = attribute < 2
+				? snprintf(line, sizeof(line), "%s %f %f %f\n", attributeTags[attribute], components[0], components[1], components[2])
+				: snprintf(line, sizeof(line), "%s %f %f\n", attributeTags[attribute], components[0], components[1]);
+			objFile.write(line, length);
+		}
+	}
+	for (unsigned int faceIndex = 0; faceIndex < faceCount; faceIndex++)
+	{
+		if (faceIndex % 1000 == 0)
+		{
+			int length = snprintf(line, sizeof(line), "usemtl material%u\n", faceIndex / 1000 % 4);
+			objFile.write(line, length);
+		}
+		unsigned int corners[9];
+		for (int corner = 0; corner < 9; corner++)
+		{
+			random = random * 1664525u + 1013904223u;
+			corners[corner] = (random >> 8) % faceCount + 1;
+		}
+		int length = snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", corners[0], corners[1], corners[2], corners[3], corners[4], corners[5], corners[6], corners[7], corners[8]);
+		objFile.write(line, length);
+	}
+	objFile.close();
+	if (!objFile)
+	{
+		std::cerr << "ERROR::BENCHMARK::CANNOT_WRITE_FILE\n" << path << std::endl;
+		return results;
+	}
+	unsigned long long fileBytes = std::filesystem::file_size(path, error);
+
+	results.push_back(time_task("fast_obj", [&path]()
+	{
+		fastObjMesh* objMesh = fast_obj_read(path.c_str());
+		if (objMesh != NULL)
+		{
+			fast_obj_destroy(objMesh);
+		}
+		return objMesh != NULL;
+	}, fileBytes, repetitions));
+
+	JobSystem* jobs = new JobSystem(0);
+	ObjParser* parser = new ObjParser();
+	results.push_back(time_task("Parallel parser", [&path, jobs, parser]()
+	{
+		return parser->read(path.c_str(), jobs) != NULL;
+	}, fileBytes, repetitions));
+	if (results.back().succeeded)
+	{
+		fastObjMesh* whole = fast_obj_read(path.c_str());
+		fastObjMesh* chunked = parser->read(path.c_str(), jobs);
+		results.back().succeeded = whole != NULL && chunked != NULL && same_obj(whole, chunked);
+		if (!results.back().succeeded)
+		{
+			std::cerr << "ERROR::BENCHMARK::PARSERS_DIFFER\n" << path << std::endl;
+		}
+		if (whole != NULL)
+		{
+			fast_obj_destroy(whole);
+		}
+	}
+	delete parser;
+	delete jobs;
+	std::filesystem::remove(path, error);
+	return results;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef STERLING_BENCHMARKS_H
+#define STERLING_BENCHMARKS_H
+
+#include <string>
+#include <vector>
+
+/// <summary>
+/// The best time of one way of doing a benchmarked task
+/// </summary>
+struct BenchmarkResult
+{
+	std::string name;
+	double milliseconds;
+	/// <summary>
+	/// The size of the input over the best time
+	/// </summary>
+	double megabytesPerSecond;
+	bool succeeded;
+};
+
+/// <summary>
+/// Throughput benchmarks on synthetic inputs, run from the settings window. Each task is run several times and the
+/// best time kept, so the results are with the input already in the OS's file cache.
+/// </summary>
+namespace benchmarks
+{
+	/// <summary>
+	/// Write a synthetic .object file of one faced primitive, then time the stream and mapped readers on it
+	/// </summary>
+	/// <param name="faceCount">The number of faces in the file, each with its own positions, normals and texture coordinates</param>
+	/// <param name="repetitions">How many times to run each reader</param>
+	/// <returns>One result per reader</returns>
+	std::vector<BenchmarkResult> object_readers(unsigned int faceCount, unsigned int repetitions);
+	/// <summary>
+	/// Write a synthetic .obj file of triangles switching between a few materials, then time fast_obj parsing it whole
+	/// against the chunked parallel parser. The parallel result fails if it differs from fast_obj's.
+	/// </summary>
+	/// <param name="faceCount">The number of faces in the file, each with its own positions, normals and texture coordinates</param>
+	/// <param name="repetitions">How many times to run each parser</param>
+	/// <returns>One result per parser</returns>
+	std::vector<BenchmarkResult> obj_parsers(unsigned int faceCount, unsigned int repetitions);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "bvh.h"
+
+#include <math.h>
+#include <stddef.h>
+
+/// <summary>
+/// Slab test of a ray against a box
+/// </summary>
+/// <param name="inverseDirection">1 / each component of the ray's direction</param>
+/// <param name="entryDistance">Set to the distance along the ray where it enters the box (0 if it starts inside)</param>
+/// <returns>Whether the ray hits the box before maxDistance</returns>
+static bool ray_hits_box(maths::vec3f origin, maths::vec3f inverseDirection, float maxDistance, const maths::bounding_box& box, float* entryDistance)
+{
+	float near1 = (box.minimum.x - origin.x) * inverseDirection.x;
+	float far1 = (box.maximum.x - origin.x) * inverseDirection.x;
+	float near2 = (box.minimum.y - origin.y) * inverseDirection.y;
+	float far2 = (box.maximum.y - origin.y) * inverseDirection.y;
+	float near3 = (box.minimum.z - origin.z) * inverseDirection.z;
+	float far3 = (box.maximum.z - origin.z) * inverseDirection.z;
+	float entry = fmaxf(fmaxf(fminf(near1, far1), fminf(near2, far2)), fmaxf(fminf(near3, far3), 0.0f));
+	float exit = fminf(fminf(fmaxf(near1, far1), fmaxf(near2, far2)), fminf(fmaxf(near3, far3), maxDistance));
+	*entryDistance = entry;
+	return entry <= exit;
+}
+
+/// <summary>
+/// A box grown by a margin on every side
+/// </summary>
+static maths::bounding_box enlarge(const maths::bounding_box& box, float margin)
+{
+	return maths::bounding_box(
+		maths::vec3f(box.minimum.x - margin, box.minimum.y - margin, box.minimum.z - margin),
+		maths::vec3f(box.maximum.x + margin, box.maximum.y + margin, box.maximum.z + margin)
+	);
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+	root = -1;
+	freeList = -1;
+	proxyCount = 0;
+	margin = 0.1f;
+}
+
+int BoundingVolumeHierarchy::allocate_node()
+{
+	int node;
+	if (freeList == -1)
+	{
+		node = nodes.size();
+		nodes.push_back(Node());
+	}
+	else
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	nodes[node].box = maths::bounding_box();
+	nodes[node].objectBox = maths::bounding_box();
+	nodes[node].object = NULL;
+	nodes[node].parent = -1;
+	nodes[node].child1 = -1;
+	nodes[node].child2 = -1;
+	nodes[node].height = 0;
+	return node;
+}
+
+void BoundingVolumeHierarchy::free_node(int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+int BoundingVolumeHierarchy::create_proxy(const maths::bounding_box& box, Object* object)
+{
+	int proxy = allocate_node();
+	nodes[proxy].box = enlarge(box, margin);
+	nodes[proxy].objectBox = box;
+	nodes[proxy].object = object;
+	insert_leaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void BoundingVolumeHierarchy::destroy_proxy(int proxy)
+{
+	remove_leaf(proxy);
+	free_node(proxy);
+	proxyCount--;
+}
+
+bool BoundingVolumeHierarchy::move_proxy(int proxy, const maths::bounding_box& box)
+{
+	nodes[proxy].objectBox = box;
+	if (nodes[proxy].box.contains(box))
+	{
+		return false;
+	}
+	remove_leaf(proxy);
+	nodes[proxy].box = enlarge(box, margin);
+	insert_leaf(proxy);
+	return true;
+}
+
+Object* BoundingVolumeHierarchy::proxy_object(int proxy)
+{
+	return nodes[proxy].object;
+}
+
+unsigned int BoundingVolumeHierarchy::proxy_count()
+{
+	return proxyCount;
+}
+
+int BoundingVolumeHierarchy::height()
+{
+	if (root == -1)
+	{
+		return -1;
+	}
+	return nodes[root].height;
+}
+
+void BoundingVolumeHierarchy::insert_leaf(int leaf)
+{
+	if (root == -1)
+	{
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// walk down the tree, at each level going wherever enlarges the total surface area the least
+	maths::bounding_box leafBox = nodes[leaf].box;
+	int index = root;
+	bool found = false;
+	while (nodes[index].child1 != -1 && !found)
+	{
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		float area = nodes[index].box.surface_area();
+		float combinedArea = maths::bounding_box::combine(nodes[index].box, leafBox).surface_area();
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+		// every ancestor of the leaf grows by at least this much
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = maths::bounding_box::combine(nodes[child1].box, leafBox).surface_area() + inheritanceCost;
+		if (nodes[child1].child1 != -1)
+		{
+			cost1 -= nodes[child1].box.surface_area();
+		}
+		float cost2 = maths::bounding_box::combine(nodes[child2].box, leafBox).surface_area() + inheritanceCost;
+		if (nodes[child2].child1 != -1)
+		{
+			cost2 -= nodes[child2].box.surface_area();
+		}
+
+		if (cost < cost1 && cost < cost2)
+		{
+			found = true;
+		}
+		else if (cost1 < cost2)
+		{
+			index = child1;
+		}
+		else
+		{
+			index = child2;
+		}
+	}
+
+	// give the sibling and the leaf a new parent
+	int sibling = index;
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocate_node();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = maths::bounding_box::combine(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent == -1)
+	{
+		root = newParent;
+	}
+	else if (nodes[oldParent].child1 == sibling)
+	{
+		nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		nodes[oldParent].child2 = newParent;
+	}
+
+	refit_ancestors(newParent);
+}
+
+void BoundingVolumeHierarchy::remove_leaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	// replace the leaf's parent with the leaf's sibling
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	free_node(parent);
+	nodes[sibling].parent = grandParent;
+	if (grandParent == -1)
+	{
+		root = sibling;
+		return;
+	}
+	if (nodes[grandParent].child1 == parent)
+	{
+		nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		nodes[grandParent].child2 = sibling;
+	}
+
+	refit_ancestors(grandParent);
+}
+
+void BoundingVolumeHierarchy::refit_ancestors(int node)
+{
+	int index = node;
+	while (index != -1)
+	{
+		index = balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+		nodes[index].box = maths::bounding_box::combine(nodes[child1].box, nodes[child2].box);
+		index = nodes[index].parent;
+	}
+}
+
+int BoundingVolumeHierarchy::balance(int a)
+{
+	if (nodes[a].child1 == -1 || nodes[a].height < 2)
+	{
+		return a;
+	}
+
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+	int difference = nodes[c].height - nodes[b].height;
+
+	if (difference > 1)
+	{
+		// rotate c up, a becomes its first child and keeps the shorter of c's children
+		int f = nodes[c].child1;
+		int g = nodes[c].child2;
+		nodes[c].child1 = a;
+		nodes[c].parent = nodes[a].parent;
+		nodes[a].parent = c;
+		if (nodes[c].parent == -1)
+		{
+			root = c;
+		}
+		else if (nodes[nodes[c].parent].child1 == a)
+		{
+			nodes[nodes[c].parent].child1 = c;
+		}
+		else
+		{
+			nodes[nodes[c].parent].child2 = c;
+		}
+
+		int kept = g;
+		int moved = f;
+		if (nodes[f].height > nodes[g].height)
+		{
+			kept = f;
+			moved = g;
+		}
+		nodes[c].child2 = kept;
+		nodes[a].child2 = moved;
+		nodes[moved].parent = a;
+		nodes[a].box = maths::bounding_box::combine(nodes[b].box, nodes[moved].box);
+		nodes[c].box = maths::bounding_box::combine(nodes[a].box, nodes[kept].box);
+		nodes[a].height = 1 + (nodes[b].height > nodes[moved].height ? nodes[b].height : nodes[moved].height);
+		nodes[c].height = 1 + (nodes[a].height > nodes[kept].height ? nodes[a].height : nodes[kept].height);
+		return c;
+	}
+	if (difference < -1)
+	{
+		// rotate b up, a becomes its first child and keeps the shorter of b's children
+		int d = nodes[b].child1;
+		int e = nodes[b].child2;
+		nodes[b].child1 = a;
+		nodes[b].parent = nodes[a].parent;
+		nodes[a].parent = b;
+		if (nodes[b].parent == -1)
+		{
+			root = b;
+		}
+		else if (nodes[nodes[b].parent].child1 == a)
+		{
+			nodes[nodes[b].parent].child1 = b;
+		}
+		else
+		{
+			nodes[nodes[b].parent].child2 = b;
+		}
+
+		int kept = e;
+		int moved = d;
+		if (nodes[d].height > nodes[e].height)
+		{
+			kept = d;
+			moved = e;
+		}
+		nodes[b].child2 = kept;
+		nodes[a].child1 = moved;
+		nodes[moved].parent = a;
+		nodes[a].box = maths::bounding_box::combine(nodes[c].box, nodes[moved].box);
+		nodes[b].box = maths::bounding_box::combine(nodes[a].box, nodes[kept].box);
+		nodes[a].height = 1 + (nodes[c].height > nodes[moved].height ? nodes[c].height : nodes[moved].height);
+		nodes[b].height = 1 + (nodes[a].height > nodes[kept].height ? nodes[a].height : nodes[kept].height);
+		return b;
+	}
+	return a;
+}
+
+void BoundingVolumeHierarchy::collect_leaves(int node, std::vector<Object*>& results)
+{
+	collectStack.clear();
+	collectStack.push_back(node);
+	while (collectStack.size() > 0)
+	{
+		int index = collectStack.back();
+		collectStack.pop_back();
+		if (nodes[index].child1 == -1)
+		{
+			results.push_back(nodes[index].object);
+		}
+		else
+		{
+			collectStack.push_back(nodes[index].child1);
+			collectStack.push_back(nodes[index].child2);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::query_frustum(const maths::frustum& viewFrustum, std::vector<Object*>& results)
+{
+	if (root == -1)
+	{
+		return;
+	}
+	stack.clear();
+	stack.push_back(root);
+	while (stack.size() > 0)
+	{
+		int index = stack.back();
+		stack.pop_back();
+		if (viewFrustum.intersects(nodes[index].box))
+		{
+			if (nodes[index].child1 == -1)
+			{
+				if (viewFrustum.intersects(nodes[index].objectBox))
+				{
+					results.push_back(nodes[index].object);
+				}
+			}
+			else if (viewFrustum.contains(nodes[index].box))
+			{
+				collect_leaves(index, results);
+			}
+			else
+			{
+				stack.push_back(nodes[index].child1);
+				stack.push_back(nodes[index].child2);
+			}
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::query_box(const maths::bounding_box& box, std::vector<Object*>& results)
+{
+	if (root == -1)
+	{
+		return;
+	}
+	stack.clear();
+	stack.push_back(root);
+	while (stack.size() > 0)
+	{
+		int index = stack.back();
+		stack.pop_back();
+		if (nodes[index].box.overlaps(box))
+		{
+			if (nodes[index].child1 == -1)
+			{
+				if (nodes[index].objectBox.overlaps(box))
+				{
+					results.push_back(nodes[index].object);
+				}
+			}
+			else
+			{
+				stack.push_back(nodes[index].child1);
+				stack.push_back(nodes[index].child2);
+			}
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::all_objects(std::vector<Object*>& results)
+{
+	if (root != -1)
+	{
+		collect_leaves(root, results);
+	}
+}
+
+Object* BoundingVolumeHierarchy::ray_cast(maths::vec3f origin, maths::vec3f direction, float maxDistance, float* hitDistance)
+{
+	Object* closest = NULL;
+	if (root == -1)
+	{
+		return closest;
+	}
+	maths::vec3f inverseDirection = maths::vec3f(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float closestDistance = maxDistance;
+	stack.clear();
+	stack.push_back(root);
+	while (stack.size() > 0)
+	{
+		int index = stack.back();
+		stack.pop_back();
+		float entry;
+		// anything further away than the closest hit so far can be skipped
+		if (ray_hits_box(origin, inverseDirection, closestDistance, nodes[index].box, &entry))
+		{
+			if (nodes[index].child1 == -1)
+			{
+				if (ray_hits_box(origin, inverseDirection, closestDistance, nodes[index].objectBox, &entry))
+				{
+					closest = nodes[index].object;
+					closestDistance = entry;
+				}
+			}
+			else
+			{
+				stack.push_back(nodes[index].child1);
+				stack.push_back(nodes[index].child2);
+			}
+		}
+	}
+	if (closest != NULL)
+	{
+		*hitDistance = closestDistance;
+	}
+	return closest;
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef STERLING_BVH_H
+#define STERLING_BVH_H
+
+#include <vector>
+#include "maths.h"
+
+class Object;
+
+/// <summary>
+/// A dynamic bounding volume hierarchy over objects. Each object is a leaf (a proxy) with a box slightly larger than
+/// the object, so small movements don't touch the tree. Objects that move out of their box are removed and reinserted,
+/// and the tree is kept balanced with rotations as it changes, so it never needs a full rebuild.
+/// </summary>
+class BoundingVolumeHierarchy
+{
+private:
+	struct Node
+	{
+		/// <summary>
+		/// The box around everything below this node. For leaves this is the enlarged box.
+		/// </summary>
+		maths::bounding_box box;
+		/// <summary>
+		/// Leaves only: the object's actual box and the object itself
+		/// </summary>
+		maths::bounding_box objectBox;
+		Object* object;
+		/// <summary>
+		/// The parent node, or the next free node while the node is on the free list
+		/// </summary>
+		int parent;
+		int child1;
+		int child2;
+		/// <summary>
+		/// 0 for leaves, -1 for free nodes
+		/// </summary>
+		int height;
+	};
+	std::vector<Node> nodes;
+	int root;
+	int freeList;
+	unsigned int proxyCount;
+	/// <summary>
+	/// Scratch storage for the traversals
+	/// </summary>
+	std::vector<int> stack;
+	std::vector<int> collectStack;
+
+	int allocate_node();
+	void free_node(int node);
+	/// <summary>
+	/// Find the best sibling for a leaf by surface area and insert it there
+	/// </summary>
+	void insert_leaf(int leaf);
+	void remove_leaf(int leaf);
+	/// <summary>
+	/// Recompute the heights and boxes of a node and everything above it, rebalancing on the way up
+	/// </summary>
+	void refit_ancestors(int node);
+	/// <summary>
+	/// If one child of the node is more than one level taller than the other, rotate it up to take the node's place
+	/// </summary>
+	/// <returns>The node now at the original node's position in the tree</returns>
+	int balance(int node);
+	/// <summary>
+	/// Add the object of every leaf below a node to a list
+	/// </summary>
+	void collect_leaves(int node, std::vector<Object*>& results);
+
+public:
+	/// <summary>
+	/// How far leaf boxes extend beyond their objects
+	/// </summary>
+	float margin;
+
+	BoundingVolumeHierarchy();
+
+	/// <summary>
+	/// Add an object to the tree
+	/// </summary>
+	/// <param name="box">The object's world space box</param>
+	/// <param name="object">The object</param>
+	/// <returns>The proxy ID, used to move or remove the object later</returns>
+	int create_proxy(const maths::bounding_box& box, Object* object);
+	/// <summary>
+	/// Remove an object from the tree
+	/// </summary>
+	void destroy_proxy(int proxy);
+	/// <summary>
+	/// Update the box of an object. The tree only changes if the object moved out of its enlarged box.
+	/// </summary>
+	/// <returns>Whether the object was reinserted</returns>
+	bool move_proxy(int proxy, const maths::bounding_box& box);
+	Object* proxy_object(int proxy);
+	unsigned int proxy_count();
+	/// <summary>
+	/// The height of the tree, 0 for a single leaf and -1 for an empty tree
+	/// </summary>
+	int height();
+
+	/// <summary>
+	/// Find every object whose box intersects the frustum. Subtrees entirely inside the frustum are taken without further tests.
+	/// </summary>
+	/// <param name="viewFrustum">The frustum to test against</param>
+	/// <param name="results">The list to add the objects to</param>
+	void query_frustum(const maths::frustum& viewFrustum, std::vector<Object*>& results);
+	/// <summary>
+	/// Find every object whose box overlaps a box
+	/// </summary>
+	/// <param name="box">The box to test against</param>
+	/// <param name="results">The list to add the objects to</param>
+	void query_box(const maths::bounding_box& box, std::vector<Object*>& results);
+	/// <summary>
+	/// Every object in the tree
+	/// </summary>
+	/// <param name="results">The list to add the objects to</param>
+	void all_objects(std::vector<Object*>& results);
+	/// <summary>
+	/// Find the nearest object whose box the ray hits
+	/// </summary>
+	/// <param name="origin">Where the ray starts</param>
+	/// <param name="direction">The direction of the ray, normalised</param>
+	/// <param name="maxDistance">How far along the ray to look</param>
+	/// <param name="hitDistance">Set to the distance along the ray to the hit, if there is one</param>
+	/// <returns>The object that was hit, NULL if nothing was hit</returns>
+	Object* ray_cast(maths::vec3f origin, maths::vec3f direction, float maxDistance, float* hitDistance);
+};
+
+#endif
\ No newline at end of file
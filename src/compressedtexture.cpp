@@ -0,0 +1,796 @@
+#include "compressedtexture.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <glad/glad.h>
+#include "mappedfile.h"
+#include "stb/stb_image.h"
+
+#define DDS_MAGIC "DDS "
+#define DDS_HEADER_SIZE 124
+#define DDS_PIXEL_FORMAT_SIZE 32
+// header flags: caps, height, width, pixel format, mip map count and linear size
+#define DDS_HEADER_FLAGS 0x000A1007
+#define DDS_PIXEL_FORMAT_FOURCC 0x4
+// caps: a texture with a chain of mip maps
+#define DDS_CAPS 0x00401008
+// the largest width or height read, the most any OpenGL 4.6 driver is required to support
+#define DDS_MAXIMUM_SIZE 16384
+#define DXGI_FORMAT_BC1_UNORM 71
+#define DXGI_FORMAT_BC1_UNORM_SRGB 72
+#define DXGI_FORMAT_BC3_UNORM 77
+#define DXGI_FORMAT_BC3_UNORM_SRGB 78
+#define DXGI_FORMAT_BC5_UNORM 83
+#define DXGI_FORMAT_BC7_UNORM 98
+#define DXGI_FORMAT_BC7_UNORM_SRGB 99
+#define DX10_RESOURCE_DIMENSION_TEXTURE2D 3
+
+/// <summary>
+/// The .dds header after the magic number, as laid out in the file
+/// </summary>
+struct DdsHeader
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int height;
+	unsigned int width;
+	unsigned int pitchOrLinearSize;
+	unsigned int depth;
+	unsigned int mipMapCount;
+	unsigned int reserved1[11];
+	unsigned int pixelFormatSize;
+	unsigned int pixelFormatFlags;
+	unsigned int fourCC;
+	unsigned int rgbBitCount;
+	unsigned int bitMasks[4];
+	unsigned int caps;
+	unsigned int caps2;
+	unsigned int caps3;
+	unsigned int caps4;
+	unsigned int reserved2;
+};
+
+/// <summary>
+/// The extended header of .dds files with a "DX10" four character code, needed for BC7
+/// </summary>
+struct DdsHeaderDx10
+{
+	unsigned int dxgiFormat;
+	unsigned int resourceDimension;
+	unsigned int miscFlag;
+	unsigned int arraySize;
+	unsigned int miscFlags2;
+};
+
+/// <summary>
+/// The weights BC7 interpolates between endpoints with 4-bit indices, out of 64
+/// </summary>
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static unsigned int four_character_code(const char* code)
+{
+	return (unsigned int)(unsigned char)code[0] | (unsigned int)(unsigned char)code[1] << 8 | (unsigned int)(unsigned char)code[2] << 16 | (unsigned int)(unsigned char)code[3] << 24;
+}
+
+static size_t level_bytes(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedtexture::block_bytes(format);
+}
+
+static bool is_dds(const char* path)
+{
+	return std::filesystem::path(path).extension() == ".dds";
+}
+
+/* Encoding */
+
+/// <summary>
+/// Lookup tables between 8-bit sRGB and linear light. Decoding needs every byte; encoding rounds the linear value to
+/// one of 4096 steps, which is finer than the darkest sRGB step.
+/// </summary>
+struct GammaTables
+{
+	float toLinear[256];
+	unsigned char toSRGB[4096];
+
+	GammaTables()
+	{
+		for (int value = 0; value < 256; value++)
+		{
+			float colour = value / 255.0f;
+			toLinear[value] = colour <= 0.04045f ? colour / 12.92f : powf((colour + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int step = 0; step < 4096; step++)
+		{
+			float linear = step / 4095.0f;
+			float colour = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+			toSRGB[step] = (unsigned char)(colour * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const GammaTables& gamma_tables()
+{
+	static GammaTables tables;
+	return tables;
+}
+
+/// <summary>
+/// Halve a level into the next, averaging each 2x2 block. Odd edges repeat their last row or column.
+/// </summary>
+/// <param name="gammaCorrect">Whether to average the colour channels as linear light, as sRGB images need to keep their
+/// brightness in smaller levels. Alpha is always averaged as it is.</param>
+static void downsample(const unsigned char* source, int width, int height, unsigned char* destination, int levelWidth, int levelHeight, bool gammaCorrect)
+{
+	const GammaTables& tables = gamma_tables();
+	for (int y = 0; y < levelHeight; y++)
+	{
+		int top = 2 * y < height ? 2 * y : height - 1;
+		int bottom = 2 * y + 1 < height ? 2 * y + 1 : height - 1;
+		for (int x = 0; x < levelWidth; x++)
+		{
+			int left = 2 * x < width ? 2 * x : width - 1;
+			int right = 2 * x + 1 < width ? 2 * x + 1 : width - 1;
+			const unsigned char* corners[4] = { source + (top * width + left) * 4, source + (top * width + right) * 4,
+				source + (bottom * width + left) * 4, source + (bottom * width + right) * 4 };
+			unsigned char* pixel = destination + (y * levelWidth + x) * 4;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				if (gammaCorrect && channel < 3)
+				{
+					float sum = tables.toLinear[corners[0][channel]] + tables.toLinear[corners[1][channel]]
+						+ tables.toLinear[corners[2][channel]] + tables.toLinear[corners[3][channel]];
+					pixel[channel] = tables.toSRGB[(int)(sum * (4095.0f / 4.0f) + 0.5f)];
+				}
+				else
+				{
+					unsigned int sum = corners[0][channel] + corners[1][channel] + corners[2][channel] + corners[3][channel];
+					pixel[channel] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Gather a 4x4 block of RGBA pixels, repeating the last row and column past the edges of the level
+/// </summary>
+static void fetch_block(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char block[64])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int row = blockY * 4 + y < height ? blockY * 4 + y : height - 1;
+		for (int x = 0; x < 4; x++)
+		{
+			int column = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+			memcpy(block + (y * 4 + x) * 4, pixels + ((size_t)row * width + column) * 4, 4);
+		}
+	}
+}
+
+/// <summary>
+/// Find the line a block's pixels lie closest to, through their mean along the axis they vary most in, and the two
+/// ends of the pixels' spread along it
+/// </summary>
+/// <param name="channels">How many of the RGBA channels to consider, 3 to ignore alpha</param>
+static void fit_endpoints(const unsigned char block[64], int channels, float endpoints[2][4])
+{
+	float mean[4] = { 0, 0, 0, 0 };
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		for (int channel = 0; channel < channels; channel++)
+		{
+			mean[channel] += block[pixel * 4 + channel] / 16.0f;
+		}
+	}
+	float covariance[4][4] = {};
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		for (int row = 0; row < channels; row++)
+		{
+			for (int column = 0; column < channels; column++)
+			{
+				covariance[row][column] += (block[pixel * 4 + row] - mean[row]) * (block[pixel * 4 + column] - mean[column]);
+			}
+		}
+	}
+	// power iteration, starting from the channel that varies most
+	float axis[4] = { 0, 0, 0, 0 };
+	int widest = 0;
+	for (int channel = 1; channel < channels; channel++)
+	{
+		widest = covariance[channel][channel] > covariance[widest][widest] ? channel : widest;
+	}
+	axis[widest] = 1;
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0, 0, 0, 0 };
+		float length = 0;
+		for (int row = 0; row < channels; row++)
+		{
+			for (int column = 0; column < channels; column++)
+			{
+				next[row] += covariance[row][column] * axis[column];
+			}
+			length += next[row] * next[row];
+		}
+		if (length > 0)
+		{
+			length = sqrtf(length);
+			for (int channel = 0; channel < channels; channel++)
+			{
+				axis[channel] = next[channel] / length;
+			}
+		}
+	}
+	float lowest = 0;
+	float highest = 0;
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		float projection = 0;
+		for (int channel = 0; channel < channels; channel++)
+		{
+			projection += (block[pixel * 4 + channel] - mean[channel]) * axis[channel];
+		}
+		lowest = projection < lowest ? projection : lowest;
+		highest = projection > highest ? projection : highest;
+	}
+	for (int channel = 0; channel < 4; channel++)
+	{
+		float low = mean[channel] + lowest * axis[channel];
+		float high = mean[channel] + highest * axis[channel];
+		endpoints[0][channel] = high < 0 ? 0 : (high > 255 ? 255 : high);
+		endpoints[1][channel] = low < 0 ? 0 : (low > 255 ? 255 : low);
+	}
+}
+
+static unsigned short pack_565(const float colour[4])
+{
+	int red = (int)(colour[0] * 31 / 255 + 0.5f);
+	int green = (int)(colour[1] * 63 / 255 + 0.5f);
+	int blue = (int)(colour[2] * 31 / 255 + 0.5f);
+	return (unsigned short)(red << 11 | green << 5 | blue);
+}
+
+static void unpack_565(unsigned short packed, int colour[3])
+{
+	int red = packed >> 11 & 31;
+	int green = packed >> 5 & 63;
+	int blue = packed & 31;
+	colour[0] = red << 3 | red >> 2;
+	colour[1] = green << 2 | green >> 4;
+	colour[2] = blue << 3 | blue >> 2;
+}
+
+/// <summary>
+/// Write the index of each pixel's nearest palette entry
+/// </summary>
+static void nearest_indices(const unsigned char block[64], int channelStart, int channelCount, const int* palette, int paletteSize, int indices[16])
+{
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		int bestError = 0x7FFFFFFF;
+		for (int entry = 0; entry < paletteSize; entry++)
+		{
+			int error = 0;
+			for (int channel = 0; channel < channelCount; channel++)
+			{
+				int difference = block[pixel * 4 + channelStart + channel] - palette[entry * channelCount + channel];
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[pixel] = entry;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Encode the colour of a block as 2 565 endpoints and 2-bit indices between them, ignoring alpha
+/// </summary>
+static void encode_bc1(const unsigned char block[64], unsigned char* output)
+{
+	float endpoints[2][4];
+	fit_endpoints(block, 3, endpoints);
+	unsigned short colour0 = pack_565(endpoints[0]);
+	unsigned short colour1 = pack_565(endpoints[1]);
+	// the first endpoint must be the greater, or the block is decoded with 3 colours and transparency
+	if (colour0 < colour1)
+	{
+		unsigned short swap = colour0;
+		colour0 = colour1;
+		colour1 = swap;
+	}
+	int indices[16] = {};
+	if (colour0 != colour1)
+	{
+		int palette[12];
+		unpack_565(colour0, palette);
+		unpack_565(colour1, palette + 3);
+		for (int channel = 0; channel < 3; channel++)
+		{
+			palette[6 + channel] = (2 * palette[channel] + palette[3 + channel]) / 3;
+			palette[9 + channel] = (palette[channel] + 2 * palette[3 + channel]) / 3;
+		}
+		nearest_indices(block, 0, 3, palette, 4, indices);
+	}
+	unsigned int packedIndices = 0;
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		packedIndices |= (unsigned int)indices[pixel] << (pixel * 2);
+	}
+	memcpy(output, &colour0, 2);
+	memcpy(output + 2, &colour1, 2);
+	memcpy(output + 4, &packedIndices, 4);
+}
+
+/// <summary>
+/// Encode one channel of a block as 2 8-bit endpoints and 3-bit indices between them
+/// </summary>
+static void encode_bc4(const unsigned char block[64], int channel, unsigned char* output)
+{
+	int highest = 0;
+	int lowest = 255;
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		int value = block[pixel * 4 + channel];
+		highest = value > highest ? value : highest;
+		lowest = value < lowest ? value : lowest;
+	}
+	int indices[16] = {};
+	if (highest > lowest)
+	{
+		// the greater endpoint first selects 6 interpolated values between them
+		int palette[8];
+		palette[0] = highest;
+		palette[1] = lowest;
+		for (int entry = 2; entry < 8; entry++)
+		{
+			palette[entry] = ((8 - entry) * highest + (entry - 1) * lowest) / 7;
+		}
+		nearest_indices(block, channel, 1, palette, 8, indices);
+	}
+	unsigned long long packedIndices = 0;
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		packedIndices |= (unsigned long long)indices[pixel] << (pixel * 3);
+	}
+	output[0] = (unsigned char)highest;
+	output[1] = (unsigned char)lowest;
+	memcpy(output + 2, &packedIndices, 6);
+}
+
+static void write_bits(unsigned char* output, unsigned int* position, unsigned int value, unsigned int count)
+{
+	for (unsigned int bit = 0; bit < count; bit++)
+	{
+		if (value >> bit & 1)
+		{
+			output[*position / 8] |= (unsigned char)(1 << (*position % 8));
+		}
+		(*position)++;
+	}
+}
+
+/// <summary>
+/// Encode a block in BC7 mode 6: one pair of 7-bit RGBA endpoints with a shared low bit each, and 4-bit indices
+/// </summary>
+static void encode_bc7(const unsigned char block[64], unsigned char* output)
+{
+	float endpoints[2][4];
+	fit_endpoints(block, 4, endpoints);
+	// quantise each endpoint with whichever low bit is closer
+	int quantised[2][4];
+	int lowBits[2];
+	int palette[16 * 4];
+	for (int endpoint = 0; endpoint < 2; endpoint++)
+	{
+		float bestError = -1;
+		for (int lowBit = 0; lowBit < 2; lowBit++)
+		{
+			int candidate[4];
+			float error = 0;
+			for (int channel = 0; channel < 4; channel++)
+			{
+				int value = (int)((endpoints[endpoint][channel] - lowBit) / 2 + 0.5f);
+				candidate[channel] = value < 0 ? 0 : (value > 127 ? 127 : value);
+				float difference = (candidate[channel] << 1 | lowBit) - endpoints[endpoint][channel];
+				error += difference * difference;
+			}
+			if (bestError < 0 || error < bestError)
+			{
+				bestError = error;
+				memcpy(quantised[endpoint], candidate, sizeof(candidate));
+				lowBits[endpoint] = lowBit;
+			}
+		}
+	}
+	for (int entry = 0; entry < 16; entry++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			int low = quantised[0][channel] << 1 | lowBits[0];
+			int high = quantised[1][channel] << 1 | lowBits[1];
+			palette[entry * 4 + channel] = ((64 - BC7_WEIGHTS[entry]) * low + BC7_WEIGHTS[entry] * high + 32) >> 6;
+		}
+	}
+	int indices[16];
+	nearest_indices(block, 0, 4, palette, 16, indices);
+	// the first pixel's index is stored without its top bit, so it must be in the lower half
+	if (indices[0] >= 8)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			int swap = quantised[0][channel];
+			quantised[0][channel] = quantised[1][channel];
+			quantised[1][channel] = swap;
+		}
+		int swap = lowBits[0];
+		lowBits[0] = lowBits[1];
+		lowBits[1] = swap;
+		for (int pixel = 0; pixel < 16; pixel++)
+		{
+			indices[pixel] = 15 - indices[pixel];
+		}
+	}
+	memset(output, 0, 16);
+	unsigned int position = 0;
+	write_bits(output, &position, 1 << 6, 7);
+	for (int channel = 0; channel < 4; channel++)
+	{
+		write_bits(output, &position, quantised[0][channel], 7);
+		write_bits(output, &position, quantised[1][channel], 7);
+	}
+	write_bits(output, &position, lowBits[0], 1);
+	write_bits(output, &position, lowBits[1], 1);
+	for (int pixel = 0; pixel < 16; pixel++)
+	{
+		write_bits(output, &position, indices[pixel], pixel == 0 ? 3 : 4);
+	}
+}
+
+/* Compressed Texture */
+
+unsigned int compressedtexture::block_bytes(BlockFormat format)
+{
+	return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+unsigned int compressedtexture::gl_format(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_FORMAT_BC1:
+		return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case BLOCK_FORMAT_BC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_FORMAT_BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+const char* compressedtexture::format_name(BlockFormat format)
+{
+	const char* names[BLOCK_FORMAT_COUNT] = { "bc1", "bc3", "bc5", "bc7" };
+	return format < BLOCK_FORMAT_COUNT ? names[format] : "";
+}
+
+bool compressedtexture::parse_format(const char* name, BlockFormat* format)
+{
+	bool found = false;
+	for (int candidate = 0; candidate < BLOCK_FORMAT_COUNT && !found; candidate++)
+	{
+		if (strcmp(name, format_name((BlockFormat)candidate)) == 0)
+		{
+			*format = (BlockFormat)candidate;
+			found = true;
+		}
+	}
+	return found;
+}
+
+std::string compressedtexture::compressed_path(const char* sourcePath)
+{
+	return std::filesystem::path(sourcePath).replace_extension(".dds").string();
+}
+
+bool compressedtexture::has_current_compressed(const char* sourcePath)
+{
+	if (is_dds(sourcePath))
+	{
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath, error);
+	if (error)
+	{
+		return false;
+	}
+	std::filesystem::file_time_type compressedTime = std::filesystem::last_write_time(compressed_path(sourcePath), error);
+	return !error && compressedTime >= sourceTime;
+}
+
+void compressedtexture::build_levels(int width, int height, bool gammaCorrect, std::vector<std::vector<unsigned char>>* levels)
+{
+	while (width > 1 || height > 1)
+	{
+		int levelWidth = width > 1 ? width / 2 : 1;
+		int levelHeight = height > 1 ? height / 2 : 1;
+		levels->push_back(std::vector<unsigned char>((size_t)levelWidth * levelHeight * 4));
+		unsigned int level = levels->size() - 1;
+		downsample((*levels)[level - 1].data(), width, height, (*levels)[level].data(), levelWidth, levelHeight, gammaCorrect);
+		width = levelWidth;
+		height = levelHeight;
+	}
+}
+
+void compressedtexture::compress_level(const unsigned char* pixels, int width, int height, BlockFormat format, std::vector<unsigned char>* blocks)
+{
+	unsigned int blockSize = block_bytes(format);
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	blocks->resize(level_bytes(format, width, height));
+	unsigned char block[64];
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			fetch_block(pixels, width, height, blockX, blockY, block);
+			unsigned char* output = blocks->data() + ((size_t)blockY * blocksWide + blockX) * blockSize;
+			switch (format)
+			{
+			case BLOCK_FORMAT_BC1:
+				encode_bc1(block, output);
+				break;
+			case BLOCK_FORMAT_BC3:
+				encode_bc4(block, 3, output);
+				encode_bc1(block, output + 8);
+				break;
+			case BLOCK_FORMAT_BC5:
+				encode_bc4(block, 0, output);
+				encode_bc4(block, 1, output + 8);
+				break;
+			default:
+				encode_bc7(block, output);
+				break;
+			}
+		}
+	}
+}
+
+bool compressedtexture::read_dds(const char* path, CompressedImage* image)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return false;
+	}
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+	DdsHeader header;
+	bool intact = size >= 4 + sizeof(DdsHeader) && memcmp(data, DDS_MAGIC, 4) == 0;
+	if (intact)
+	{
+		memcpy(&header, data + 4, sizeof(DdsHeader));
+		intact = header.size == DDS_HEADER_SIZE && header.width > 0 && header.height > 0;
+	}
+	if (!intact)
+	{
+		std::cerr << "ERROR::TEXTURE::DDS_CORRUPT\n" << path << std::endl;
+		return false;
+	}
+
+	size_t offset = 4 + sizeof(DdsHeader);
+	bool supported = (header.pixelFormatFlags & DDS_PIXEL_FORMAT_FOURCC) != 0;
+	if (supported && header.fourCC == four_character_code("DX10"))
+	{
+		DdsHeaderDx10 extension;
+		supported = size >= offset + sizeof(DdsHeaderDx10);
+		if (supported)
+		{
+			memcpy(&extension, data + offset, sizeof(DdsHeaderDx10));
+			offset += sizeof(DdsHeaderDx10);
+			supported = extension.resourceDimension == DX10_RESOURCE_DIMENSION_TEXTURE2D && extension.arraySize <= 1;
+		}
+		if (supported && (extension.dxgiFormat == DXGI_FORMAT_BC1_UNORM || extension.dxgiFormat == DXGI_FORMAT_BC1_UNORM_SRGB))
+		{
+			image->format = BLOCK_FORMAT_BC1;
+		}
+		else if (supported && (extension.dxgiFormat == DXGI_FORMAT_BC3_UNORM || extension.dxgiFormat == DXGI_FORMAT_BC3_UNORM_SRGB))
+		{
+			image->format = BLOCK_FORMAT_BC3;
+		}
+		else if (supported && extension.dxgiFormat == DXGI_FORMAT_BC5_UNORM)
+		{
+			image->format = BLOCK_FORMAT_BC5;
+		}
+		else if (supported && (extension.dxgiFormat == DXGI_FORMAT_BC7_UNORM || extension.dxgiFormat == DXGI_FORMAT_BC7_UNORM_SRGB))
+		{
+			image->format = BLOCK_FORMAT_BC7;
+		}
+		else
+		{
+			supported = false;
+		}
+	}
+	else if (supported && header.fourCC == four_character_code("DXT1"))
+	{
+		image->format = BLOCK_FORMAT_BC1;
+	}
+	else if (supported && header.fourCC == four_character_code("DXT5"))
+	{
+		image->format = BLOCK_FORMAT_BC3;
+	}
+	else if (supported && (header.fourCC == four_character_code("ATI2") || header.fourCC == four_character_code("BC5U")))
+	{
+		image->format = BLOCK_FORMAT_BC5;
+	}
+	else
+	{
+		supported = false;
+	}
+	if (!supported)
+	{
+		std::cerr << "ERROR::TEXTURE::DDS_UNSUPPORTED_FORMAT\n" << path << std::endl;
+		return false;
+	}
+
+	if (header.width == 0 || header.height == 0 || header.width > DDS_MAXIMUM_SIZE || header.height > DDS_MAXIMUM_SIZE)
+	{
+		std::cerr << "ERROR::TEXTURE::DDS_CORRUPT\n" << path << std::endl;
+		return false;
+	}
+
+	// files without mip maps may leave the count 0, and it can't exceed a full chain
+	image->width = header.width;
+	image->height = header.height;
+	unsigned int fullChain = 1;
+	while (fullChain < 32 && ((header.width >> fullChain) > 0 || (header.height >> fullChain) > 0))
+	{
+		fullChain++;
+	}
+	unsigned int levelCount = header.mipMapCount > 0 ? header.mipMapCount : 1;
+	levelCount = levelCount < fullChain ? levelCount : fullChain;
+	image->levels.clear();
+	for (unsigned int level = 0; level < levelCount && intact; level++)
+	{
+		int levelWidth = header.width >> level > 0 ? header.width >> level : 1;
+		int levelHeight = header.height >> level > 0 ? header.height >> level : 1;
+		size_t bytes = level_bytes(image->format, levelWidth, levelHeight);
+		intact = offset + bytes <= size;
+		if (intact)
+		{
+			image->levels.push_back(std::vector<unsigned char>(data + offset, data + offset + bytes));
+			offset += bytes;
+		}
+	}
+	if (!intact)
+	{
+		std::cerr << "ERROR::TEXTURE::DDS_CORRUPT\n" << path << std::endl;
+	}
+	return intact;
+}
+
+bool compressedtexture::write_dds(const char* path, const CompressedImage& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "ERROR::TEXTURE::CANNOT_WRITE_FILE\n" << path << std::endl;
+		return false;
+	}
+	DdsHeader header;
+	memset(&header, 0, sizeof(DdsHeader));
+	header.size = DDS_HEADER_SIZE;
+	header.flags = DDS_HEADER_FLAGS;
+	header.height = image.height;
+	header.width = image.width;
+	header.pitchOrLinearSize = image.levels.size() > 0 ? image.levels[0].size() : 0;
+	header.mipMapCount = image.levels.size();
+	header.pixelFormatSize = DDS_PIXEL_FORMAT_SIZE;
+	header.pixelFormatFlags = DDS_PIXEL_FORMAT_FOURCC;
+	header.caps = DDS_CAPS;
+	// BC7 has no four character code of its own, so it needs the extended header
+	const char* fourCCs[BLOCK_FORMAT_COUNT] = { "DXT1", "DXT5", "ATI2", "DX10" };
+	header.fourCC = four_character_code(fourCCs[image.format]);
+	file.write(DDS_MAGIC, 4);
+	file.write((const char*)&header, sizeof(DdsHeader));
+	if (image.format == BLOCK_FORMAT_BC7)
+	{
+		DdsHeaderDx10 extension;
+		memset(&extension, 0, sizeof(DdsHeaderDx10));
+		extension.dxgiFormat = DXGI_FORMAT_BC7_UNORM;
+		extension.resourceDimension = DX10_RESOURCE_DIMENSION_TEXTURE2D;
+		extension.arraySize = 1;
+		file.write((const char*)&extension, sizeof(DdsHeaderDx10));
+	}
+	for (unsigned int level = 0; level < image.levels.size(); level++)
+	{
+		file.write((const char*)image.levels[level].data(), image.levels[level].size());
+	}
+	file.close();
+	if (!file)
+	{
+		std::cerr << "ERROR::TEXTURE::CANNOT_WRITE_FILE\n" << path << std::endl;
+	}
+	return (bool)file;
+}
+
+bool compressedtexture::transcode(const char* sourcePath, BlockFormat format, bool colour)
+{
+	int width;
+	int height;
+	int channelCount;
+	unsigned char* data = stbi_load(sourcePath, &width, &height, &channelCount, 4);
+	if (data == NULL)
+	{
+		std::cerr << "ERROR::TEXTURE::LOAD_FAILED\n" << sourcePath << std::endl;
+		return false;
+	}
+	std::vector<std::vector<unsigned char>> levels;
+	levels.push_back(std::vector<unsigned char>(data, data + (size_t)width * height * 4));
+	stbi_image_free(data);
+	build_levels(width, height, colour, &levels);
+
+	CompressedImage image;
+	image.format = format;
+	image.width = width;
+	image.height = height;
+	image.levels.resize(levels.size());
+	for (unsigned int level = 0; level < levels.size(); level++)
+	{
+		int levelWidth = width >> level > 0 ? width >> level : 1;
+		int levelHeight = height >> level > 0 ? height >> level : 1;
+		compress_level(levels[level].data(), levelWidth, levelHeight, format, &image.levels[level]);
+		std::vector<unsigned char>().swap(levels[level]);
+	}
+	return write_dds(compressed_path(sourcePath).c_str(), image);
+}
+
+unsigned int compressedtexture::transcode_all(const char* path, BlockFormat format, bool colour, JobSystem* jobs)
+{
+	std::vector<std::string> sources;
+	std::error_code error;
+	if (std::filesystem::is_directory(path, error))
+	{
+		const char* extensions[5] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+		for (std::filesystem::recursive_directory_iterator entry(path, error); entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+		{
+			std::string extension = entry->path().extension().string();
+			for (unsigned int character = 0; character < extension.size(); character++)
+			{
+				extension[character] = (char)tolower(extension[character]);
+			}
+			bool image = false;
+			for (int candidate = 0; candidate < 5; candidate++)
+			{
+				image = image || extension == extensions[candidate];
+			}
+			if (image && entry->is_regular_file(error))
+			{
+				sources.push_back(entry->path().string());
+			}
+		}
+	}
+	else
+	{
+		sources.push_back(path);
+	}
+	std::atomic<unsigned int> transcoded(0);
+	jobs->parallel_for(sources.size(), [&sources, &transcoded, format, colour](unsigned int sourceIndex)
+	{
+		if (transcode(sources[sourceIndex].c_str(), format, colour))
+		{
+			transcoded++;
+		}
+	});
+	return transcoded;
+}
\ No newline at end of file
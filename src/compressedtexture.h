@@ -0,0 +1,112 @@
+#ifndef STERLING_COMPRESSEDTEXTURE_H
+#define STERLING_COMPRESSEDTEXTURE_H
+
+#include <string>
+#include <vector>
+#include "jobs.h"
+
+// S3TC isn't core OpenGL, so glad doesn't define its formats, but every desktop driver supports it
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/// <summary>
+/// The GPU block compression formats textures can be stored in. Each encodes 4x4 pixel blocks.
+/// </summary>
+enum BlockFormat
+{
+	/// <summary>
+	/// Opaque colour, 8 bytes a block
+	/// </summary>
+	BLOCK_FORMAT_BC1,
+	/// <summary>
+	/// Colour with a separate alpha, 16 bytes a block
+	/// </summary>
+	BLOCK_FORMAT_BC3,
+	/// <summary>
+	/// Two independent channels, for normal and bump maps, 16 bytes a block
+	/// </summary>
+	BLOCK_FORMAT_BC5,
+	/// <summary>
+	/// High quality colour and alpha, 16 bytes a block
+	/// </summary>
+	BLOCK_FORMAT_BC7,
+	BLOCK_FORMAT_COUNT
+};
+
+/// <summary>
+/// A block compressed image and its mip chain, as stored in a .dds file
+/// </summary>
+struct CompressedImage
+{
+	BlockFormat format;
+	int width;
+	int height;
+	/// <summary>
+	/// The blocks of every level, largest first
+	/// </summary>
+	std::vector<std::vector<unsigned char>> levels;
+};
+
+/// <summary>
+/// Reading and writing block compressed .dds textures, and the offline transcoder that makes them from ordinary images.
+/// A transcoded texture sits next to its source with a .dds extension, and is used in its place while it is newer.
+/// </summary>
+namespace compressedtexture
+{
+	unsigned int block_bytes(BlockFormat format);
+	/// <summary>
+	/// The OpenGL internal format of a block format
+	/// </summary>
+	unsigned int gl_format(BlockFormat format);
+	const char* format_name(BlockFormat format);
+	/// <summary>
+	/// Find a block format from its name, as in "bc7"
+	/// </summary>
+	/// <returns>Whether the name is a block format</returns>
+	bool parse_format(const char* name, BlockFormat* format);
+	/// <summary>
+	/// The .dds file the transcoder writes for a source image
+	/// </summary>
+	std::string compressed_path(const char* sourcePath);
+	/// <summary>
+	/// Whether a source image has a transcoded .dds at least as new as it
+	/// </summary>
+	bool has_current_compressed(const char* sourcePath);
+
+	/// <summary>
+	/// Build every level below an RGBA image by halving it until it is one pixel, averaging each 2x2 block
+	/// </summary>
+	/// <param name="gammaCorrect">Whether the colour is sRGB, and so averaged in linear light</param>
+	/// <param name="levels">Holds the image itself as its first level, and receives the rest after it</param>
+	void build_levels(int width, int height, bool gammaCorrect, std::vector<std::vector<unsigned char>>* levels);
+	/// <summary>
+	/// Encode a level of RGBA pixels into blocks. Partial blocks at the right and bottom edges repeat their last pixels.
+	/// </summary>
+	void compress_level(const unsigned char* pixels, int width, int height, BlockFormat format, std::vector<unsigned char>* blocks);
+
+	/// <summary>
+	/// Read a .dds file in one of the block formats, with all of its levels
+	/// </summary>
+	/// <returns>Whether the file was read. Uncompressed and unsupported formats fail.</returns>
+	bool read_dds(const char* path, CompressedImage* image);
+	bool write_dds(const char* path, const CompressedImage& image);
+
+	/// <summary>
+	/// Decode an image, build its levels and compress them into a .dds next to it
+	/// </summary>
+	/// <param name="colour">Whether the image is sRGB colour, so its levels are averaged in linear light, rather than
+	/// data such as bumps, shininess or dissolve, which is averaged as it is</param>
+	/// <returns>Whether the .dds was written</returns>
+	bool transcode(const char* sourcePath, BlockFormat format, bool colour);
+	/// <summary>
+	/// Transcode a file, or every .png, .jpg, .tga and .bmp under a directory, spread over the job system's workers
+	/// </summary>
+	/// <returns>The number of images transcoded</returns>
+	unsigned int transcode_all(const char* path, BlockFormat format, bool colour, JobSystem* jobs);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "cookedmesh.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+
+/// <summary>
+/// The texture maps of a material, in the order they are stored in a material record
+/// </summary>
+static void texture_maps(Material* material, Texture2D** maps[cookedmesh::TEXTURE_MAP_COUNT])
+{
+	maps[0] = &material->ambientMap;
+	maps[1] = &material->diffuseMap;
+	maps[2] = &material->specularMap;
+	maps[3] = &material->emissionMap;
+	maps[4] = &material->transmittanceMap;
+	maps[5] = &material->shininessMap;
+	maps[6] = &material->indexOfRefractionMap;
+	maps[7] = &material->dissolveMap;
+	maps[8] = &material->bumpMap;
+}
+
+static void store(float* destination, maths::vec3f vector)
+{
+	destination[0] = vector.x;
+	destination[1] = vector.y;
+	destination[2] = vector.z;
+}
+
+static maths::vec3f load(const float* source)
+{
+	return maths::vec3f(source[0], source[1], source[2]);
+}
+
+static size_t padded(size_t length)
+{
+	return (length + 3) & ~(size_t)3;
+}
+
+/// <summary>
+/// Whether a primitive record's counts, sizes, index type and mode agree, so uploading it reads only the bytes it has
+/// </summary>
+static bool consistent(const cookedmesh::PrimitiveRecord* record)
+{
+	size_t stride = record->format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+	bool validIndexType = record->indexType == GL_UNSIGNED_SHORT || record->indexType == GL_UNSIGNED_INT;
+	size_t indexSize = record->indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+	bool validMode = record->mode == GL_TRIANGLES || record->mode == GL_LINES || record->mode == GL_POINTS;
+	return validIndexType && validMode && record->vertexBytes == (size_t)record->vertexCount * stride && record->indexBytes == (size_t)record->indexCount * indexSize;
+}
+
+/// <summary>
+/// Whether every index in a primitive's index data names one of its vertices, so drawing it never reads past them
+/// </summary>
+static bool indices_in_range(const cookedmesh::PrimitiveRecord* record, const unsigned char* indexData)
+{
+	bool inRange = true;
+	for (unsigned int index = 0; index < record->indexCount && inRange; index++)
+	{
+		// the blob is only 4-byte aligned, and a copy keeps the reads legal either way
+		unsigned int vertex;
+		if (record->indexType == GL_UNSIGNED_SHORT)
+		{
+			unsigned short shortVertex;
+			memcpy(&shortVertex, indexData + index * sizeof(unsigned short), sizeof(unsigned short));
+			vertex = shortVertex;
+		}
+		else
+		{
+			memcpy(&vertex, indexData + index * sizeof(unsigned int), sizeof(unsigned int));
+		}
+		inRange = vertex < record->vertexCount;
+	}
+	return inRange;
+}
+
+/// <summary>
+/// The size and modification time of a file, both 0 if it can't be read
+/// </summary>
+/// <returns>Whether the file exists</returns>
+static bool file_stamp(const char* path, unsigned long long* size, long long* modified)
+{
+	std::error_code error;
+	*size = std::filesystem::file_size(path, error);
+	if (!error)
+	{
+		*modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	}
+	if (error)
+	{
+		*size = 0;
+		*modified = 0;
+	}
+	return !error;
+}
+
+bool CookedMeshSource::read(const char* sourcePath, unsigned int importSettings)
+{
+	libraries.clear();
+	settings = importSettings;
+	return file_stamp(sourcePath, &size, &modified);
+}
+
+void CookedMeshSource::add_library(const std::string& libraryPath)
+{
+	Library library;
+	library.path = libraryPath;
+	file_stamp(libraryPath.c_str(), &library.size, &library.modified);
+	libraries.push_back(library);
+}
+
+std::string cookedmesh::cooked_path(const char* sourcePath)
+{
+	// 64-bit FNV-1a hash of the path, so meshes with the same file name in different folders don't collide
+	unsigned long long hash = 14695981039346656037ULL;
+	for (const char* character = sourcePath; *character != '\0'; character++)
+	{
+		hash = (hash ^ (unsigned char)*character) * 1099511628211ULL;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cooked", hash);
+	return std::string(COOKED_MESH_CACHE_DIRECTORY) + "/" + name;
+}
+
+/*
+Writer
+*/
+
+CookedMeshWriter::CookedMeshWriter()
+{
+	primitiveCount = 0;
+}
+
+void CookedMeshWriter::append(std::vector<unsigned char>* data, const void* bytes, size_t length)
+{
+	const unsigned char* source = (const unsigned char*)bytes;
+	data->insert(data->end(), source, source + length);
+	data->resize(padded(data->size()), 0);
+}
+
+void CookedMeshWriter::add_primitive(MeshPrimitive* primitive, Material* material, const std::vector<unsigned char>& vertexData, const std::vector<unsigned char>& indexData)
+{
+	// find the material's slot, adding a record the first time it is used
+	unsigned int materialSlot = 0;
+	while (materialSlot < materials.size() && materials[materialSlot] != material)
+	{
+		materialSlot++;
+	}
+	if (materialSlot == materials.size())
+	{
+		materials.push_back(material);
+		Texture2D** maps[cookedmesh::TEXTURE_MAP_COUNT];
+		texture_maps(material, maps);
+
+		cookedmesh::MaterialRecord record;
+		memset(&record, 0, sizeof(record));
+		store(record.ambient, material->ambientColour);
+		store(record.diffuse, material->diffuseColour);
+		store(record.specular, material->specularColour);
+		store(record.emission, material->emissionColour);
+		store(record.transmittance, material->transmittanceColour);
+		store(record.transmissionFilter, material->transmissionFilter);
+		record.shininess = material->shininess;
+		record.indexOfRefraction = material->indexOfRefraction;
+		record.dissolve = material->dissolve;
+		record.nameLength = material->name.size() + 1;
+		for (int map = 0; map < cookedmesh::TEXTURE_MAP_COUNT; map++)
+		{
+			record.texturePathLengths[map] = *maps[map] != NULL ? strlen((*maps[map])->path()) + 1 : 0;
+		}
+		append(&materialData, &record, sizeof(record));
+		append(&materialData, material->name.c_str(), record.nameLength);
+		for (int map = 0; map < cookedmesh::TEXTURE_MAP_COUNT; map++)
+		{
+			if (*maps[map] != NULL)
+			{
+				append(&materialData, (*maps[map])->path(), record.texturePathLengths[map]);
+			}
+		}
+	}
+
+	cookedmesh::PrimitiveRecord record;
+	memset(&record, 0, sizeof(record));
+	record.material = materialSlot;
+	record.format = primitive->format;
+	record.mode = primitive->mode;
+	record.indexType = primitive->indexType;
+	record.vertexCount = primitive->vertexCount;
+	record.indexCount = primitive->indexCount;
+	record.vertexBytes = vertexData.size();
+	record.indexBytes = indexData.size();
+	store(record.boundsMinimum, primitive->bounds.minimum);
+	store(record.boundsMaximum, primitive->bounds.maximum);
+	store(record.sphereCentre, primitive->boundingSphere.centre);
+	record.sphereRadius = primitive->boundingSphere.radius;
+	memcpy(record.vertexTransform, &primitive->vertexTransform, sizeof(record.vertexTransform));
+	record.acmrBefore = primitive->acmrBefore;
+	record.acmrAfter = primitive->acmrAfter;
+	append(&primitiveData, &record, sizeof(record));
+	append(&primitiveData, vertexData.data(), vertexData.size());
+	append(&primitiveData, indexData.data(), indexData.size());
+	primitiveCount++;
+}
+
+bool CookedMeshWriter::write(const std::string& path, const CookedMeshSource& source)
+{
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	std::ofstream cookedFile(path, std::ios::binary);
+	if (!cookedFile)
+	{
+		std::cerr << "ERROR::MESH::CANNOT_WRITE_COOKED_MESH\n" << path << std::endl;
+		return false;
+	}
+
+	cookedmesh::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "STMC", 4);
+	header.version = COOKED_MESH_CACHE_VERSION;
+	header.sourceSize = source.size;
+	header.sourceModified = source.modified;
+	header.settings = source.settings;
+	header.materialCount = materials.size();
+	header.primitiveCount = primitiveCount;
+	header.libraryCount = source.libraries.size();
+	cookedFile.write((const char*)&header, sizeof(header));
+	std::vector<unsigned char> libraryData;
+	for (unsigned int libraryIndex = 0; libraryIndex < source.libraries.size(); libraryIndex++)
+	{
+		const CookedMeshSource::Library* library = &source.libraries[libraryIndex];
+		cookedmesh::LibraryRecord record;
+		memset(&record, 0, sizeof(record));
+		record.size = library->size;
+		record.modified = library->modified;
+		record.pathLength = library->path.size() + 1;
+		append(&libraryData, &record, sizeof(record));
+		append(&libraryData, library->path.c_str(), record.pathLength);
+	}
+	cookedFile.write((const char*)libraryData.data(), libraryData.size());
+	cookedFile.write((const char*)materialData.data(), materialData.size());
+	cookedFile.write((const char*)primitiveData.data(), primitiveData.size());
+	if (!cookedFile)
+	{
+		std::cerr << "ERROR::MESH::CANNOT_WRITE_COOKED_MESH\n" << path << std::endl;
+		cookedFile.close();
+		std::filesystem::remove(path, error);
+		return false;
+	}
+	return true;
+}
+
+/*
+Reader
+*/
+
+bool CookedMeshReader::open(const std::string& path, const CookedMeshSource& source)
+{
+	materials.clear();
+	primitives.clear();
+	if (!file.open(path.c_str()) || file.size() < sizeof(cookedmesh::Header))
+	{
+		return false;
+	}
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+
+	const cookedmesh::Header* header = (const cookedmesh::Header*)data;
+	if (memcmp(header->magic, "STMC", 4) != 0 || header->version != COOKED_MESH_CACHE_VERSION ||
+		header->sourceSize != source.size || header->sourceModified != source.modified || header->settings != source.settings)
+	{
+		file.close();
+		return false;
+	}
+
+	// walk the records, checking every length against the end of the file in case it was cut short
+	size_t offset = sizeof(cookedmesh::Header);
+	bool intact = true;
+	bool current = true;
+	for (unsigned int libraryIndex = 0; libraryIndex < header->libraryCount && intact && current; libraryIndex++)
+	{
+		const cookedmesh::LibraryRecord* record = NULL;
+		intact = offset + sizeof(cookedmesh::LibraryRecord) <= size;
+		if (intact)
+		{
+			record = (const cookedmesh::LibraryRecord*)(data + offset);
+			offset += padded(sizeof(cookedmesh::LibraryRecord));
+			intact = record->pathLength > 0 && offset + record->pathLength <= size && data[offset + record->pathLength - 1] == '\0';
+		}
+		if (intact)
+		{
+			// the materials were cooked from the .mtl files, so an edited one makes the cooked mesh stale
+			unsigned long long librarySize;
+			long long libraryModified;
+			file_stamp((const char*)(data + offset), &librarySize, &libraryModified);
+			current = librarySize == record->size && libraryModified == record->modified;
+			offset += padded(record->pathLength);
+		}
+	}
+	if (!current)
+	{
+		file.close();
+		return false;
+	}
+	for (unsigned int materialIndex = 0; materialIndex < header->materialCount && intact; materialIndex++)
+	{
+		CookedMaterial material;
+		intact = offset + sizeof(cookedmesh::MaterialRecord) <= size;
+		if (intact)
+		{
+			material.record = (const cookedmesh::MaterialRecord*)(data + offset);
+			offset += padded(sizeof(cookedmesh::MaterialRecord));
+			intact = material.record->nameLength > 0 && offset + material.record->nameLength <= size && data[offset + material.record->nameLength - 1] == '\0';
+		}
+		if (intact)
+		{
+			material.name = (const char*)(data + offset);
+			offset += padded(material.record->nameLength);
+		}
+		for (int map = 0; map < cookedmesh::TEXTURE_MAP_COUNT && intact; map++)
+		{
+			unsigned int length = material.record->texturePathLengths[map];
+			material.texturePaths[map] = NULL;
+			if (length > 0)
+			{
+				intact = offset + length <= size && data[offset + length - 1] == '\0';
+				material.texturePaths[map] = (const char*)(data + offset);
+				offset += padded(length);
+			}
+		}
+		if (intact)
+		{
+			materials.push_back(material);
+		}
+	}
+	for (unsigned int primitiveIndex = 0; primitiveIndex < header->primitiveCount && intact; primitiveIndex++)
+	{
+		CookedPrimitive primitive;
+		intact = offset + sizeof(cookedmesh::PrimitiveRecord) <= size;
+		if (intact)
+		{
+			primitive.record = (const cookedmesh::PrimitiveRecord*)(data + offset);
+			offset += padded(sizeof(cookedmesh::PrimitiveRecord));
+			intact = primitive.record->material < materials.size() && primitive.record->format < VERTEX_FORMAT_COUNT && consistent(primitive.record) &&
+				offset + padded(primitive.record->vertexBytes) + primitive.record->indexBytes <= size &&
+				indices_in_range(primitive.record, data + offset + padded(primitive.record->vertexBytes));
+		}
+		if (intact)
+		{
+			primitive.vertexData = data + offset;
+			offset += padded(primitive.record->vertexBytes);
+			primitive.indexData = data + offset;
+			offset += padded(primitive.record->indexBytes);
+			primitives.push_back(primitive);
+		}
+	}
+
+	if (!intact)
+	{
+		std::cerr << "ERROR::MESH::COOKED_MESH_CORRUPT\n" << path << std::endl;
+		materials.clear();
+		primitives.clear();
+		file.close();
+	}
+	return intact;
+}
+
+Material* CookedMeshReader::create_material(unsigned int materialIndex, TextureCache* textures)
+{
+	const CookedMaterial* cooked = &materials[materialIndex];
+	Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
+	material->name = cooked->name;
+	material->textureCache = textures;
+	material->ambientColour = load(cooked->record->ambient);
+	material->diffuseColour = load(cooked->record->diffuse);
+	material->specularColour = load(cooked->record->specular);
+	material->emissionColour = load(cooked->record->emission);
+	material->transmittanceColour = load(cooked->record->transmittance);
+	material->shininess = cooked->record->shininess;
+	material->indexOfRefraction = cooked->record->indexOfRefraction;
+	material->transmissionFilter = load(cooked->record->transmissionFilter);
+	material->dissolve = cooked->record->dissolve;
+
+	Texture2D** maps[cookedmesh::TEXTURE_MAP_COUNT];
+	texture_maps(material, maps);
+	for (int map = 0; map < cookedmesh::TEXTURE_MAP_COUNT; map++)
+	{
+		if (cooked->texturePaths[map] != NULL)
+		{
+			*maps[map] = textures->acquire(cooked->texturePaths[map], map < cookedmesh::COLOUR_MAP_COUNT);
+		}
+	}
+	return material;
+}
+
+MeshPrimitive* CookedMeshReader::create_primitive(unsigned int primitiveIndex, GeometryBuffer* geometry)
+{
+	const cookedmesh::PrimitiveRecord* record = primitives[primitiveIndex].record;
+	MeshPrimitive* primitive = new MeshPrimitive();
+	primitive->format = (VertexFormat)record->format;
+	primitive->mode = record->mode;
+	primitive->indexType = record->indexType;
+	primitive->vertexCount = record->vertexCount;
+	primitive->indexCount = record->indexCount;
+	primitive->bounds = maths::bounding_box(load(record->boundsMinimum), load(record->boundsMaximum));
+	primitive->boundingSphere.centre = load(record->sphereCentre);
+	primitive->boundingSphere.radius = record->sphereRadius;
+	memcpy(&primitive->vertexTransform, record->vertexTransform, sizeof(record->vertexTransform));
+	primitive->acmrBefore = record->acmrBefore;
+	primitive->acmrAfter = record->acmrAfter;
+	primitive->upload(geometry, primitives[primitiveIndex].vertexData, primitives[primitiveIndex].indexData);
+	return primitive;
+}
\ No newline at end of file
@@ -0,0 +1,215 @@
+#ifndef STERLING_COOKEDMESH_H
+#define STERLING_COOKEDMESH_H
+
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+#include "mesh.h"
+#include "material.h"
+#include "textures.h"
+
+// Cooked meshes are written here, named by a hash of the source file's path
+#define COOKED_MESH_CACHE_DIRECTORY "models/cache"
+#define COOKED_MESH_CACHE_VERSION 2
+
+/// <summary>
+/// Identifies the exact source file, .mtl files and import settings a cooked mesh was made from, so a stale cooked mesh is never used
+/// </summary>
+struct CookedMeshSource
+{
+	struct Library
+	{
+		std::string path;
+		unsigned long long size;
+		long long modified;
+	};
+
+	unsigned long long size;
+	long long modified;
+	/// <summary>
+	/// Import settings that change the cooked data, e.g. the vertex format
+	/// </summary>
+	unsigned int settings;
+	/// <summary>
+	/// The .mtl files the source references. They are only known once the source has been parsed, so this is
+	/// filled in by add_library before a cooked mesh is written, and read back from the cooked mesh when it is opened.
+	/// </summary>
+	std::vector<Library> libraries;
+
+	/// <summary>
+	/// Read the size and modification time of a source file, forgetting its .mtl files
+	/// </summary>
+	/// <returns>Whether the source file exists</returns>
+	bool read(const char* sourcePath, unsigned int importSettings);
+	/// <summary>
+	/// Read the size and modification time of a .mtl file the source references. A missing one is recorded with
+	/// both 0, so creating it later also makes the cooked mesh stale.
+	/// </summary>
+	void add_library(const std::string& libraryPath);
+};
+
+/// <summary>
+/// The layout of the file: a header, the .mtl file records, the material records, then the primitive records. Every record is followed
+/// by its variable-length data (strings including their terminators, vertex and index blobs), padded to 4 bytes.
+/// </summary>
+namespace cookedmesh
+{
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long sourceSize;
+		long long sourceModified;
+		unsigned int settings;
+		unsigned int materialCount;
+		unsigned int primitiveCount;
+		unsigned int libraryCount;
+	};
+
+	/// <summary>
+	/// A .mtl file the source referenced when it was cooked, followed by its path
+	/// </summary>
+	struct LibraryRecord
+	{
+		unsigned long long size;
+		long long modified;
+		/// <summary>
+		/// Length including the terminator
+		/// </summary>
+		unsigned int pathLength;
+		unsigned int padding;
+	};
+
+	/// <summary>
+	/// The number of texture maps a material has, in the order ambient, diffuse, specular, emission, transmittance,
+	/// shininess, index of refraction, dissolve, bump
+	/// </summary>
+	const int TEXTURE_MAP_COUNT = 9;
+	/// <summary>
+	/// The maps before this hold colour, the rest other data
+	/// </summary>
+	const int COLOUR_MAP_COUNT = 5;
+
+	struct MaterialRecord
+	{
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		float emission[3];
+		float transmittance[3];
+		float transmissionFilter[3];
+		float shininess;
+		float indexOfRefraction;
+		float dissolve;
+		/// <summary>
+		/// Lengths including the terminator, 0 for a map the material doesn't have
+		/// </summary>
+		unsigned int nameLength;
+		unsigned int texturePathLengths[TEXTURE_MAP_COUNT];
+	};
+
+	struct PrimitiveRecord
+	{
+		/// <summary>
+		/// The index of the primitive's material among the file's material records
+		/// </summary>
+		unsigned int material;
+		unsigned int format;
+		unsigned int mode;
+		unsigned int indexType;
+		unsigned int vertexCount;
+		unsigned int indexCount;
+		unsigned int vertexBytes;
+		unsigned int indexBytes;
+		float boundsMinimum[3];
+		float boundsMaximum[3];
+		float sphereCentre[3];
+		float sphereRadius;
+		float vertexTransform[16];
+		float acmrBefore;
+		float acmrAfter;
+	};
+
+	/// <summary>
+	/// The path of the cooked mesh for a source file
+	/// </summary>
+	std::string cooked_path(const char* sourcePath);
+}
+
+/// <summary>
+/// Collects a mesh's materials and GPU-ready primitive data while it is imported, then writes them out as a cooked mesh
+/// </summary>
+class CookedMeshWriter
+{
+private:
+	std::vector<unsigned char> materialData;
+	std::vector<unsigned char> primitiveData;
+	std::vector<Material*> materials;
+	unsigned int primitiveCount;
+
+	static void append(std::vector<unsigned char>* data, const void* bytes, size_t length);
+
+public:
+	CookedMeshWriter();
+
+	/// <summary>
+	/// Add a primitive, with its vertices and indices laid out by MeshPrimitive::build
+	/// </summary>
+	void add_primitive(MeshPrimitive* primitive, Material* material, const std::vector<unsigned char>& vertexData, const std::vector<unsigned char>& indexData);
+	/// <summary>
+	/// Write the cooked mesh file. Only the collected data is read, not the materials, so it is safe on a worker thread.
+	/// </summary>
+	/// <returns>Whether the file could be written</returns>
+	bool write(const std::string& path, const CookedMeshSource& source);
+};
+
+/// <summary>
+/// Maps a cooked mesh and finds its records. The vertex and index data point straight into the mapping,
+/// ready to be handed to MeshPrimitive::upload.
+/// </summary>
+class CookedMeshReader
+{
+private:
+	MappedFile file;
+
+public:
+	struct CookedMaterial
+	{
+		const cookedmesh::MaterialRecord* record;
+		const char* name;
+		/// <summary>
+		/// NULL for maps the material doesn't have
+		/// </summary>
+		const char* texturePaths[cookedmesh::TEXTURE_MAP_COUNT];
+	};
+	struct CookedPrimitive
+	{
+		const cookedmesh::PrimitiveRecord* record;
+		const void* vertexData;
+		const void* indexData;
+	};
+	std::vector<CookedMaterial> materials;
+	std::vector<CookedPrimitive> primitives;
+
+	/// <summary>
+	/// Map a cooked mesh and check it was made from the given source and the .mtl files it recorded, as they are now,
+	/// with the current version
+	/// </summary>
+	/// <returns>Whether the cooked mesh is present, current and intact</returns>
+	bool open(const std::string& path, const CookedMeshSource& source);
+	/// <summary>
+	/// Create a material from a material record, streaming its textures in
+	/// </summary>
+	/// <param name="materialIndex">The index into materials</param>
+	/// <param name="textures">The cache to take the textures from</param>
+	Material* create_material(unsigned int materialIndex, TextureCache* textures);
+	/// <summary>
+	/// Create a primitive from a primitive record, uploading its vertices and indices straight from the mapping.
+	/// Its material index is left for the caller to set.
+	/// </summary>
+	/// <param name="primitiveIndex">The index into primitives</param>
+	/// <param name="geometry">The scene's geometry buffer</param>
+	MeshPrimitive* create_primitive(unsigned int primitiveIndex, GeometryBuffer* geometry);
+};
+
+#endif
\ No newline at end of file
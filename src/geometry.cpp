@@ -0,0 +1,296 @@
+#include "geometry.h"
+
+#include "glad/glad.h"
+#include "mesh.h"
+#include <stddef.h>
+
+#define GEOMETRY_INITIAL_VERTICES 65536
+#define GEOMETRY_INITIAL_INDEX_BYTES 786432
+
+RangeAllocator::RangeAllocator()
+{
+	capacity = 0;
+	used = 0;
+}
+
+RangeAllocator::RangeAllocator(unsigned int capacity)
+{
+	this->capacity = 0;
+	used = 0;
+	grow(capacity);
+}
+
+void RangeAllocator::insert_free(unsigned int offset, unsigned int size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+	// find the first free range after the new one
+	unsigned int next = 0;
+	while (next < freeRanges.size() && freeRanges[next].offset < offset)
+	{
+		next++;
+	}
+	bool joinsPrevious = next > 0 && freeRanges[next - 1].offset + freeRanges[next - 1].size == offset;
+	bool joinsNext = next < freeRanges.size() && offset + size == freeRanges[next].offset;
+	if (joinsPrevious && joinsNext)
+	{
+		freeRanges[next - 1].size += size + freeRanges[next].size;
+		freeRanges.erase(freeRanges.begin() + next);
+	}
+	else if (joinsPrevious)
+	{
+		freeRanges[next - 1].size += size;
+	}
+	else if (joinsNext)
+	{
+		freeRanges[next].offset = offset;
+		freeRanges[next].size += size;
+	}
+	else
+	{
+		Range range;
+		range.offset = offset;
+		range.size = size;
+		freeRanges.insert(freeRanges.begin() + next, range);
+	}
+}
+
+bool RangeAllocator::allocate(unsigned int size, unsigned int alignment, unsigned int* offset)
+{
+	for (unsigned int rangeIndex = 0; rangeIndex < freeRanges.size(); rangeIndex++)
+	{
+		Range range = freeRanges[rangeIndex];
+		unsigned int start = (range.offset + alignment - 1) / alignment * alignment;
+		unsigned int padding = start - range.offset;
+		if (range.size >= padding + size)
+		{
+			// take the range out, then give back whatever is left either side of the allocation
+			freeRanges.erase(freeRanges.begin() + rangeIndex);
+			insert_free(range.offset, padding);
+			insert_free(start + size, range.size - padding - size);
+			used += size;
+			*offset = start;
+			return true;
+		}
+	}
+	return false;
+}
+
+void RangeAllocator::free(unsigned int offset, unsigned int size)
+{
+	insert_free(offset, size);
+	used -= size;
+}
+
+void RangeAllocator::grow(unsigned int newCapacity)
+{
+	if (newCapacity > capacity)
+	{
+		insert_free(capacity, newCapacity - capacity);
+		capacity = newCapacity;
+	}
+}
+
+unsigned int RangeAllocator::total()
+{
+	return capacity;
+}
+
+unsigned int RangeAllocator::allocated()
+{
+	return used;
+}
+
+unsigned int RangeAllocator::free_range_count()
+{
+	return freeRanges.size();
+}
+
+GeometryBuffer::GeometryBuffer()
+{
+	indexAllocator = RangeAllocator(GEOMETRY_INITIAL_INDEX_BYTES);
+	glCreateBuffers(1, &indexBuffer);
+	glNamedBufferData(indexBuffer, indexAllocator.total(), NULL, GL_STATIC_DRAW);
+
+	pools[VERTEX_FORMAT_STANDARD].stride = sizeof(Vertex);
+	pools[VERTEX_FORMAT_PACKED].stride = sizeof(PackedVertex);
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		VertexPool* pool = &pools[format];
+		pool->allocator = RangeAllocator(GEOMETRY_INITIAL_VERTICES);
+		pool->instanceBuffer = 0;
+		glCreateBuffers(1, &pool->buffer);
+		glNamedBufferData(pool->buffer, pool->allocator.total() * pool->stride, NULL, GL_STATIC_DRAW);
+		setup_format((VertexFormat)format);
+	}
+}
+
+GeometryBuffer::~GeometryBuffer()
+{
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		glDeleteVertexArrays(1, &pools[format].VAO);
+		glDeleteBuffers(1, &pools[format].buffer);
+	}
+	glDeleteBuffers(1, &indexBuffer);
+}
+
+void GeometryBuffer::setup_format(VertexFormat format)
+{
+	VertexPool* pool = &pools[format];
+	unsigned int VAO;
+	// binding 0 is the vertices, binding 1 the per-instance data
+	glCreateVertexArrays(1, &VAO);
+	glVertexArrayVertexBuffer(VAO, 0, pool->buffer, 0, pool->stride);
+	glVertexArrayElementBuffer(VAO, indexBuffer);
+	if (format == VERTEX_FORMAT_STANDARD)
+	{
+		// vertex positions
+		glEnableVertexArrayAttrib(VAO, 0);
+		glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+		glVertexArrayAttribBinding(VAO, 0, 0);
+		// vertex normals
+		glEnableVertexArrayAttrib(VAO, 1);
+		glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+		glVertexArrayAttribBinding(VAO, 1, 0);
+		// vertex texture coords
+		glEnableVertexArrayAttrib(VAO, 2);
+		glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, textureCoords));
+		glVertexArrayAttribBinding(VAO, 2, 0);
+	}
+	else if (format == VERTEX_FORMAT_PACKED)
+	{
+		// positions within the primitive's bounds, read as [0, 1]
+		glEnableVertexArrayAttrib(VAO, 0);
+		glVertexArrayAttribFormat(VAO, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, position));
+		glVertexArrayAttribBinding(VAO, 0, 0);
+		// octahedral normals, read as [-1, 1]
+		glEnableVertexArrayAttrib(VAO, 1);
+		glVertexArrayAttribFormat(VAO, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+		glVertexArrayAttribBinding(VAO, 1, 0);
+		// half float texture coords
+		glEnableVertexArrayAttrib(VAO, 2);
+		glVertexArrayAttribFormat(VAO, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, textureCoords));
+		glVertexArrayAttribBinding(VAO, 2, 0);
+	}
+	// model matrix, one column per attribute location, then the material index
+	for (unsigned int column = 0; column < 4; column++)
+	{
+		glEnableVertexArrayAttrib(VAO, 3 + column);
+		glVertexArrayAttribFormat(VAO, 3 + column, 4, GL_FLOAT, GL_FALSE, column * 4 * sizeof(float));
+		glVertexArrayAttribBinding(VAO, 3 + column, 1);
+	}
+	glEnableVertexArrayAttrib(VAO, 7);
+	glVertexArrayAttribIFormat(VAO, 7, 1, GL_UNSIGNED_INT, offsetof(InstanceData, materialIndex));
+	glVertexArrayAttribBinding(VAO, 7, 1);
+	glVertexArrayBindingDivisor(VAO, 1, 1);
+	pool->VAO = VAO;
+}
+
+void GeometryBuffer::grow(unsigned int* buffer, unsigned int oldBytes, unsigned int newBytes)
+{
+	unsigned int newBuffer;
+	glCreateBuffers(1, &newBuffer);
+	glNamedBufferData(newBuffer, newBytes, NULL, GL_STATIC_DRAW);
+	if (oldBytes > 0)
+	{
+		glCopyNamedBufferSubData(*buffer, newBuffer, 0, 0, oldBytes);
+	}
+	glDeleteBuffers(1, buffer);
+	*buffer = newBuffer;
+}
+
+bool GeometryBuffer::allocate_growing(RangeAllocator* allocator, unsigned int* buffer, unsigned int unitSize, unsigned int size, unsigned int alignment, unsigned int* offset)
+{
+	bool grown = false;
+	while (!allocator->allocate(size, alignment, offset))
+	{
+		// doubling keeps the number of copies logarithmic in the final size
+		unsigned int oldCapacity = allocator->total();
+		unsigned int newCapacity = oldCapacity * 2 > oldCapacity + size + alignment ? oldCapacity * 2 : oldCapacity + size + alignment;
+		grow(buffer, oldCapacity * unitSize, newCapacity * unitSize);
+		allocator->grow(newCapacity);
+		grown = true;
+	}
+	return grown;
+}
+
+GeometryRange GeometryBuffer::add(VertexFormat format, const void* vertices, unsigned int vertexCount, const void* indices, unsigned int indexCount, unsigned int indexSize)
+{
+	VertexPool* pool = &pools[format];
+	GeometryRange range;
+	range.format = format;
+	range.vertexCount = vertexCount;
+	range.indexBytes = indexCount * indexSize;
+	range.baseVertex = 0;
+	range.indexOffset = 0;
+
+	if (vertexCount > 0)
+	{
+		if (allocate_growing(&pool->allocator, &pool->buffer, pool->stride, vertexCount, 1, &range.baseVertex))
+		{
+			glVertexArrayVertexBuffer(pool->VAO, 0, pool->buffer, 0, pool->stride);
+		}
+		glNamedBufferSubData(pool->buffer, range.baseVertex * pool->stride, vertexCount * pool->stride, vertices);
+	}
+	if (range.indexBytes > 0)
+	{
+		// indices are aligned to their own size so the offset can be given to draw calls as a first index
+		if (allocate_growing(&indexAllocator, &indexBuffer, 1, range.indexBytes, indexSize, &range.indexOffset))
+		{
+			for (int otherFormat = 0; otherFormat < VERTEX_FORMAT_COUNT; otherFormat++)
+			{
+				glVertexArrayElementBuffer(pools[otherFormat].VAO, indexBuffer);
+			}
+		}
+		glNamedBufferSubData(indexBuffer, range.indexOffset, range.indexBytes, indices);
+	}
+	return range;
+}
+
+void GeometryBuffer::release(const GeometryRange& range)
+{
+	if (range.vertexCount > 0)
+	{
+		pools[range.format].allocator.free(range.baseVertex, range.vertexCount);
+	}
+	if (range.indexBytes > 0)
+	{
+		indexAllocator.free(range.indexOffset, range.indexBytes);
+	}
+}
+
+void GeometryBuffer::bind(VertexFormat format, unsigned int buffer)
+{
+	VertexPool* pool = &pools[format];
+	if (pool->instanceBuffer != buffer)
+	{
+		pool->instanceBuffer = buffer;
+		glVertexArrayVertexBuffer(pool->VAO, 1, buffer, 0, sizeof(InstanceData));
+	}
+	glBindVertexArray(pool->VAO);
+}
+
+unsigned int GeometryBuffer::vertex_array(VertexFormat format)
+{
+	return pools[format].VAO;
+}
+
+GeometryStatistics GeometryBuffer::statistics()
+{
+	GeometryStatistics statistics;
+	statistics.vertexBytesUsed = 0;
+	statistics.vertexBytesTotal = 0;
+	statistics.freeRanges = indexAllocator.free_range_count();
+	for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+	{
+		statistics.vertexBytesUsed += pools[format].allocator.allocated() * pools[format].stride;
+		statistics.vertexBytesTotal += pools[format].allocator.total() * pools[format].stride;
+		statistics.freeRanges += pools[format].allocator.free_range_count();
+	}
+	statistics.indexBytesUsed = indexAllocator.allocated();
+	statistics.indexBytesTotal = indexAllocator.total();
+	return statistics;
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#ifndef STERLING_GEOMETRY_H
+#define STERLING_GEOMETRY_H
+
+#include <vector>
+
+/// <summary>
+/// The layouts vertices can be stored in. Each has its own vertex buffer and vertex array in the geometry buffer.
+/// </summary>
+enum VertexFormat
+{
+	/// <summary>
+	/// Vertex: float positions, normals and texture coordinates
+	/// </summary>
+	VERTEX_FORMAT_STANDARD,
+	/// <summary>
+	/// PackedVertex: quantised positions, octahedral normals and half float texture coordinates, drawn with the
+	/// STERLING_PACKED_VERTICES shader variant
+	/// </summary>
+	VERTEX_FORMAT_PACKED,
+	VERTEX_FORMAT_COUNT
+};
+
+/// <summary>
+/// Hands out ranges of a larger block, keeping the free space as a list of ranges sorted by offset.
+/// Neighbouring free ranges are merged when a range is freed, so freed space can be reused by larger allocations.
+/// </summary>
+class RangeAllocator
+{
+private:
+	struct Range
+	{
+		unsigned int offset;
+		unsigned int size;
+	};
+	std::vector<Range> freeRanges;
+	unsigned int capacity;
+	unsigned int used;
+
+	/// <summary>
+	/// Add a range to the free list, merging it with the ranges either side if they touch
+	/// </summary>
+	void insert_free(unsigned int offset, unsigned int size);
+
+public:
+	RangeAllocator();
+	/// <param name="capacity">The size of the block to allocate from</param>
+	RangeAllocator(unsigned int capacity);
+
+	/// <summary>
+	/// Find room for a range, taking it from the first free range it fits in
+	/// </summary>
+	/// <param name="size">The size of the range</param>
+	/// <param name="alignment">What the offset must be a multiple of</param>
+	/// <param name="offset">Set to the start of the range</param>
+	/// <returns>Whether there was room</returns>
+	bool allocate(unsigned int size, unsigned int alignment, unsigned int* offset);
+	/// <summary>
+	/// Give a range back
+	/// </summary>
+	void free(unsigned int offset, unsigned int size);
+	/// <summary>
+	/// Make the block larger, the new space being free
+	/// </summary>
+	void grow(unsigned int newCapacity);
+	unsigned int total();
+	unsigned int allocated();
+	/// <summary>
+	/// How many separate free ranges there are, a measure of fragmentation
+	/// </summary>
+	unsigned int free_range_count();
+};
+
+/// <summary>
+/// Where a primitive's geometry was placed in the geometry buffer
+/// </summary>
+struct GeometryRange
+{
+	VertexFormat format;
+	/// <summary>
+	/// The first vertex, in vertices, and the number of vertices
+	/// </summary>
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+	/// <summary>
+	/// The start of the indices and their total size, in bytes
+	/// </summary>
+	unsigned int indexOffset;
+	unsigned int indexBytes;
+};
+
+/// <summary>
+/// Usage of the geometry buffer's GPU memory, in bytes
+/// </summary>
+struct GeometryStatistics
+{
+	unsigned int vertexBytesUsed;
+	unsigned int vertexBytesTotal;
+	unsigned int indexBytesUsed;
+	unsigned int indexBytesTotal;
+	unsigned int freeRanges;
+};
+
+/// <summary>
+/// A few large GL buffers that every mesh primitive's geometry is suballocated from: one vertex buffer and vertex array
+/// per vertex format, and one index buffer shared by all of them. Any primitive of a format can be drawn without
+/// rebinding, many can be drawn with one indirect call, and released ranges are reused instead of leaving holes.
+/// </summary>
+class GeometryBuffer
+{
+private:
+	struct VertexPool
+	{
+		unsigned int VAO;
+		unsigned int buffer;
+		unsigned int stride;
+		RangeAllocator allocator;
+		/// <summary>
+		/// The instance buffer currently attached to the vertex array
+		/// </summary>
+		unsigned int instanceBuffer;
+	};
+	VertexPool pools[VERTEX_FORMAT_COUNT];
+	unsigned int indexBuffer;
+	RangeAllocator indexAllocator;
+
+	/// <summary>
+	/// Move a buffer's contents into a new, larger buffer
+	/// </summary>
+	/// <param name="buffer">The buffer to grow, replaced with the new buffer</param>
+	/// <param name="oldBytes">The size of the old buffer</param>
+	/// <param name="newBytes">The size of the new buffer</param>
+	static void grow(unsigned int* buffer, unsigned int oldBytes, unsigned int newBytes);
+	/// <summary>
+	/// Allocate from a range allocator, growing it and its buffer until there is room
+	/// </summary>
+	/// <returns>Whether the buffer was replaced</returns>
+	static bool allocate_growing(RangeAllocator* allocator, unsigned int* buffer, unsigned int unitSize, unsigned int size, unsigned int alignment, unsigned int* offset);
+	/// <summary>
+	/// Create a format's vertex array and describe its vertex layout
+	/// </summary>
+	void setup_format(VertexFormat format);
+
+public:
+	GeometryBuffer();
+	~GeometryBuffer();
+
+	/// <summary>
+	/// Place a primitive's vertices and indices in the buffers. The indices stay relative to the primitive's first vertex.
+	/// </summary>
+	/// <param name="format">The layout of the vertices</param>
+	/// <param name="vertices">The vertices to add</param>
+	/// <param name="vertexCount">How many vertices to add</param>
+	/// <param name="indices">The indices to add</param>
+	/// <param name="indexCount">How many indices to add</param>
+	/// <param name="indexSize">The size of each index in bytes</param>
+	/// <returns>Where the geometry was placed, to draw it from and to release it with</returns>
+	GeometryRange add(VertexFormat format, const void* vertices, unsigned int vertexCount, const void* indices, unsigned int indexCount, unsigned int indexSize);
+	/// <summary>
+	/// Free the space of geometry placed by add(), so later geometry can reuse it
+	/// </summary>
+	void release(const GeometryRange& range);
+	/// <summary>
+	/// Bind a format's vertex array, reading per-instance data (InstanceData) from an instance buffer
+	/// </summary>
+	/// <param name="format">The vertex format to bind</param>
+	/// <param name="buffer">The buffer holding the InstanceData of each instance</param>
+	void bind(VertexFormat format, unsigned int buffer);
+	unsigned int vertex_array(VertexFormat format);
+	GeometryStatistics statistics();
+};
+
+#endif
\ No newline at end of file
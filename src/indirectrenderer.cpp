@@ -0,0 +1,247 @@
+#include "indirectrenderer.h"
+
+#include "glad/glad.h"
+#include <algorithm>
+
+/// <summary>
+/// The state a batch has to set up, primitives with equal keys can share a batch
+/// </summary>
+struct BatchKey
+{
+	unsigned int format;
+	unsigned int indexType;
+	unsigned int shader;
+	unsigned int textures[3];
+	unsigned int mode;
+
+	BatchKey(Material* material, VertexFormat primitiveFormat, unsigned int primitiveIndexType, unsigned int primitiveMode)
+	{
+		format = primitiveFormat;
+		indexType = primitiveIndexType;
+		shader = material->get_shader(primitiveFormat)->ID;
+		textures[0] = material->ambientMap != NULL ? material->ambientMap->id() : 0;
+		textures[1] = material->diffuseMap != NULL ? material->diffuseMap->id() : 0;
+		textures[2] = material->specularMap != NULL ? material->specularMap->id() : 0;
+		mode = primitiveMode;
+	}
+
+	bool operator<(const BatchKey& key) const
+	{
+		if (format != key.format)
+		{
+			return format < key.format;
+		}
+		if (indexType != key.indexType)
+		{
+			return indexType < key.indexType;
+		}
+		if (shader != key.shader)
+		{
+			return shader < key.shader;
+		}
+		for (int unit = 0; unit < 3; unit++)
+		{
+			if (textures[unit] != key.textures[unit])
+			{
+				return textures[unit] < key.textures[unit];
+			}
+		}
+		return mode < key.mode;
+	}
+
+	bool operator==(const BatchKey& key) const
+	{
+		return !(*this < key) && !(key < *this);
+	}
+};
+
+IndirectRenderer::IndirectRenderer(GeometryBuffer* geometry)
+{
+	this->geometry = geometry;
+	cullShader = Shader::load_compute("shaders/cull.comp");
+	planesLocation = cullShader->uniform_location("planes");
+	cullInstanceCountLocation = cullShader->uniform_location("cullInstanceCount");
+
+	glGenBuffers(1, &commandBuffer);
+	glGenBuffers(1, &cullInstanceBuffer);
+	glGenBuffers(1, &instanceBuffer);
+	cullInstanceCapacity = 0;
+	instancesTested = 0;
+	drawCalls = 0;
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+	glDeleteBuffers(1, &commandBuffer);
+	glDeleteBuffers(1, &cullInstanceBuffer);
+	glDeleteBuffers(1, &instanceBuffer);
+}
+
+void IndirectRenderer::clear()
+{
+	primitives.clear();
+	cullInstances.clear();
+	instancePrimitives.clear();
+}
+
+void IndirectRenderer::add(unsigned int primitiveNumber, MeshPrimitive* primitive, Material* material, unsigned int materialIndex, maths::mat4f worldMatrix)
+{
+	if (primitiveNumber >= primitives.size())
+	{
+		PrimitiveSlot empty;
+		empty.primitive = NULL;
+		empty.material = NULL;
+		empty.instanceCount = 0;
+		empty.command = 0;
+		primitives.resize(primitiveNumber + 1, empty);
+	}
+	primitives[primitiveNumber].primitive = primitive;
+	primitives[primitiveNumber].material = material;
+	primitives[primitiveNumber].instanceCount++;
+
+	CullInstance instance;
+	maths::bounding_box bounds = maths::bounding_box::transform(worldMatrix, primitive->bounds);
+	// transposed because GL reads matrices by column
+	instance.model = maths::mat4f::transpose(primitive->model_matrix(worldMatrix));
+	instance.boundsMinimum[0] = bounds.minimum.x;
+	instance.boundsMinimum[1] = bounds.minimum.y;
+	instance.boundsMinimum[2] = bounds.minimum.z;
+	instance.boundsMinimum[3] = 1;
+	instance.boundsMaximum[0] = bounds.maximum.x;
+	instance.boundsMaximum[1] = bounds.maximum.y;
+	instance.boundsMaximum[2] = bounds.maximum.z;
+	instance.boundsMaximum[3] = 1;
+	instance.command = 0;
+	instance.materialIndex = materialIndex;
+	instance.padding[0] = 0;
+	instance.padding[1] = 0;
+	cullInstances.push_back(instance);
+	instancePrimitives.push_back(primitiveNumber);
+}
+
+void IndirectRenderer::build()
+{
+	// order the primitives so that those sharing a batch are next to each other
+	std::vector<unsigned int> order;
+	for (unsigned int primitiveNumber = 0; primitiveNumber < primitives.size(); primitiveNumber++)
+	{
+		if (primitives[primitiveNumber].instanceCount > 0)
+		{
+			order.push_back(primitiveNumber);
+		}
+	}
+	std::vector<PrimitiveSlot>& slots = primitives;
+	std::stable_sort(order.begin(), order.end(), [&slots](unsigned int first, unsigned int second)
+		{
+			MeshPrimitive* firstPrimitive = slots[first].primitive;
+			MeshPrimitive* secondPrimitive = slots[second].primitive;
+			return BatchKey(slots[first].material, firstPrimitive->format, firstPrimitive->indexType, firstPrimitive->mode) < BatchKey(slots[second].material, secondPrimitive->format, secondPrimitive->indexType, secondPrimitive->mode);
+		});
+
+	// one command per primitive, each with room for all of its instances, and one batch per run of matching keys
+	commands.clear();
+	batches.clear();
+	unsigned int baseInstance = 0;
+	for (unsigned int orderIndex = 0; orderIndex < order.size(); orderIndex++)
+	{
+		PrimitiveSlot* slot = &primitives[order[orderIndex]];
+		slot->command = commands.size();
+
+		DrawCommand command;
+		command.count = slot->primitive->indexCount;
+		command.instanceCount = 0;
+		command.firstIndex = slot->primitive->firstIndex;
+		command.baseVertex = slot->primitive->baseVertex;
+		command.baseInstance = baseInstance;
+		commands.push_back(command);
+		baseInstance += slot->instanceCount;
+
+		DrawBatch* last = batches.size() > 0 ? &batches.back() : NULL;
+		if (last == NULL || !(BatchKey(last->material, last->format, last->indexType, last->mode) == BatchKey(slot->material, slot->primitive->format, slot->primitive->indexType, slot->primitive->mode)))
+		{
+			DrawBatch batch;
+			batch.material = slot->material;
+			batch.format = slot->primitive->format;
+			batch.indexType = slot->primitive->indexType;
+			batch.mode = slot->primitive->mode;
+			batch.firstCommand = slot->command;
+			batch.commandCount = 0;
+			batches.push_back(batch);
+		}
+		batches.back().commandCount++;
+	}
+	for (unsigned int instanceIndex = 0; instanceIndex < cullInstances.size(); instanceIndex++)
+	{
+		cullInstances[instanceIndex].command = primitives[instancePrimitives[instanceIndex]].command;
+	}
+
+	// upload the instances, and make room for the culled output
+	if (cullInstances.size() > cullInstanceCapacity)
+	{
+		cullInstanceCapacity = cullInstances.size() * 2;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, cullInstanceBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, cullInstanceCapacity * sizeof(CullInstance), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, cullInstanceCapacity * sizeof(InstanceData), NULL, GL_DYNAMIC_COPY);
+	}
+	if (cullInstances.size() > 0)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, cullInstanceBuffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cullInstances.size() * sizeof(CullInstance), &cullInstances[0]);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	if (commands.size() > 0)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand), &commands[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void IndirectRenderer::render(const maths::frustum& viewFrustum)
+{
+	instancesTested = cullInstances.size();
+	drawCalls = 0;
+	if (cullInstances.size() == 0)
+	{
+		return;
+	}
+
+	// reset the instance counts from last frame
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawCommand), &commands[0]);
+
+	// cull
+	float planes[24];
+	for (int plane = 0; plane < 6; plane++)
+	{
+		planes[plane * 4] = viewFrustum.planeX[plane];
+		planes[plane * 4 + 1] = viewFrustum.planeY[plane];
+		planes[plane * 4 + 2] = viewFrustum.planeZ[plane];
+		planes[plane * 4 + 3] = viewFrustum.planeD[plane];
+	}
+	cullShader->use();
+	cullShader->setVec4fArray(planesLocation, planes, 6);
+	cullShader->setInt(cullInstanceCountLocation, cullInstances.size());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cullInstanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, instanceBuffer);
+	glDispatchCompute((cullInstances.size() + 63) / 64, 1, 1);
+	// the draws read the commands and instances the compute shader wrote
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+	// draw, one call per batch. The batches are sorted by vertex format, so each format's vertex array is bound once.
+	for (unsigned int batchIndex = 0; batchIndex < batches.size(); batchIndex++)
+	{
+		DrawBatch* batch = &batches[batchIndex];
+		if (batchIndex == 0 || batches[batchIndex - 1].format != batch->format)
+		{
+			geometry->bind(batch->format, instanceBuffer);
+		}
+		batch->material->use(batch->format);
+		glMultiDrawElementsIndirect(batch->mode, batch->indexType, (void*)(batch->firstCommand * sizeof(DrawCommand)), batch->commandCount, 0);
+		drawCalls++;
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
\ No newline at end of file
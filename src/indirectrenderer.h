@@ -0,0 +1,122 @@
+#ifndef STERLING_INDIRECTRENDERER_H
+#define STERLING_INDIRECTRENDERER_H
+
+#include <vector>
+#include "maths.h"
+#include "mesh.h"
+#include "material.h"
+#include "shaders.h"
+#include "geometry.h"
+
+/// <summary>
+/// Draws every instance of every mesh primitive with a handful of glMultiDrawElementsIndirect calls. A compute shader
+/// tests each instance's bounds against the frustum and appends the visible ones to their primitive's draw command,
+/// so the CPU does no per-object work unless the instances themselves change.
+/// </summary>
+class IndirectRenderer
+{
+private:
+	/// <summary>
+	/// Layout of glMultiDrawElementsIndirect's commands
+	/// </summary>
+	struct DrawCommand
+	{
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+	/// <summary>
+	/// What the compute shader reads per instance, matching CullInstance in cull.comp
+	/// </summary>
+	struct CullInstance
+	{
+		maths::mat4f model;
+		float boundsMinimum[4];
+		float boundsMaximum[4];
+		unsigned int command;
+		unsigned int materialIndex;
+		unsigned int padding[2];
+	};
+	/// <summary>
+	/// A run of draw commands sharing a vertex format, index type, shader, textures and primitive type, drawn with one call
+	/// </summary>
+	struct DrawBatch
+	{
+		Material* material;
+		VertexFormat format;
+		unsigned int indexType;
+		unsigned int mode;
+		unsigned int firstCommand;
+		unsigned int commandCount;
+	};
+	/// <summary>
+	/// The primitive behind each primitive number, and how many instances of it were added
+	/// </summary>
+	struct PrimitiveSlot
+	{
+		MeshPrimitive* primitive;
+		Material* material;
+		unsigned int instanceCount;
+		unsigned int command;
+	};
+
+	GeometryBuffer* geometry;
+	Shader* cullShader;
+	int planesLocation;
+	int cullInstanceCountLocation;
+
+	std::vector<PrimitiveSlot> primitives;
+	std::vector<DrawCommand> commands;
+	std::vector<DrawBatch> batches;
+	std::vector<CullInstance> cullInstances;
+	/// <summary>
+	/// The primitive number of each cull instance, resolved to a command index by build()
+	/// </summary>
+	std::vector<unsigned int> instancePrimitives;
+
+	unsigned int commandBuffer;
+	unsigned int cullInstanceBuffer;
+	unsigned int instanceBuffer;
+	unsigned int cullInstanceCapacity;
+
+public:
+	/// <summary>
+	/// How many instances the last frame tested and how many indirect calls it made
+	/// </summary>
+	unsigned int instancesTested;
+	unsigned int drawCalls;
+
+	/// <summary>
+	/// Set up the renderer
+	/// </summary>
+	/// <param name="geometry">The buffer every drawn primitive's geometry is in</param>
+	IndirectRenderer(GeometryBuffer* geometry);
+	~IndirectRenderer();
+
+	/// <summary>
+	/// Remove every instance
+	/// </summary>
+	void clear();
+	/// <summary>
+	/// Add one copy of a mesh primitive
+	/// </summary>
+	/// <param name="primitiveNumber">A compact number identifying the primitive, the same every time it is added</param>
+	/// <param name="primitive">The primitive to draw</param>
+	/// <param name="material">The material to draw it with</param>
+	/// <param name="materialIndex">The index of the material in the scene's material buffer</param>
+	/// <param name="worldMatrix">The local space -> world space matrix of the copy</param>
+	void add(unsigned int primitiveNumber, MeshPrimitive* primitive, Material* material, unsigned int materialIndex, maths::mat4f worldMatrix);
+	/// <summary>
+	/// Group the added primitives into draw commands and batches and upload the instances to the GPU.
+	/// Only needs calling again after the instances change.
+	/// </summary>
+	void build();
+	/// <summary>
+	/// Cull the instances against the frustum on the GPU, then draw the survivors
+	/// </summary>
+	void render(const maths::frustum& viewFrustum);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "jobs.h"
+
+#include <atomic>
+#include <memory>
+
+/// <summary>
+/// The state of a parallel_for, shared with its helper jobs. A helper may not start until the call has returned,
+/// so the state lives as long as the last of them.
+/// </summary>
+struct ParallelFor
+{
+	std::function<void(unsigned int)> task;
+	unsigned int count;
+	std::atomic<unsigned int> next;
+	unsigned int completed;
+	std::mutex completedMutex;
+	std::condition_variable allCompleted;
+};
+
+/// <summary>
+/// Take indices of a parallel_for and run them until none are left
+/// </summary>
+static void run_parallel_for(ParallelFor* work)
+{
+	unsigned int index = work->next++;
+	while (index < work->count)
+	{
+		work->task(index);
+		{
+			std::lock_guard<std::mutex> lock(work->completedMutex);
+			work->completed++;
+			if (work->completed == work->count)
+			{
+				work->allCompleted.notify_all();
+			}
+		}
+		index = work->next++;
+	}
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	stopping = false;
+	unfinished = 0;
+	if (threadCount == 0)
+	{
+		// leave a hardware thread for the main thread
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	for (unsigned int threadIndex = 0; threadIndex < threadCount; threadIndex++)
+	{
+		workers.push_back(std::thread(&JobSystem::work, this));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	jobAvailable.notify_all();
+	for (unsigned int threadIndex = 0; threadIndex < workers.size(); threadIndex++)
+	{
+		workers[threadIndex].join();
+	}
+}
+
+void JobSystem::work()
+{
+	bool running = true;
+	while (running)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			jobAvailable.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty())
+			{
+				// only reached once stopping, with nothing left to do
+				running = false;
+			}
+			else
+			{
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+		}
+		if (running)
+		{
+			job();
+			std::lock_guard<std::mutex> lock(queueMutex);
+			unfinished--;
+		}
+	}
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		queue.push_back(std::move(job));
+		unfinished++;
+	}
+	jobAvailable.notify_one();
+}
+
+unsigned int JobSystem::pending()
+{
+	std::lock_guard<std::mutex> lock(queueMutex);
+	return unfinished;
+}
+
+unsigned int JobSystem::thread_count()
+{
+	return workers.size();
+}
+
+void JobSystem::parallel_for(unsigned int count, std::function<void(unsigned int)> task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	std::shared_ptr<ParallelFor> work = std::make_shared<ParallelFor>();
+	work->task = task;
+	work->count = count;
+	work->next = 0;
+	work->completed = 0;
+	unsigned int helperCount = count - 1 < workers.size() ? count - 1 : workers.size();
+	for (unsigned int helper = 0; helper < helperCount; helper++)
+	{
+		submit([work]() { run_parallel_for(work.get()); });
+	}
+	run_parallel_for(work.get());
+	std::unique_lock<std::mutex> lock(work->completedMutex);
+	work->allCompleted.wait(lock, [&work] { return work->completed == work->count; });
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef STERLING_JOBS_H
+#define STERLING_JOBS_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// A fixed set of worker threads running jobs from a shared queue, in the order they were submitted.
+/// Jobs must not touch OpenGL, which only the main thread may use.
+/// </summary>
+class JobSystem
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> queue;
+	std::mutex queueMutex;
+	std::condition_variable jobAvailable;
+	bool stopping;
+	/// <summary>
+	/// Jobs that have been submitted but not finished
+	/// </summary>
+	unsigned int unfinished;
+
+	/// <summary>
+	/// Run jobs until the job system is stopped and the queue is empty
+	/// </summary>
+	void work();
+
+public:
+	/// <param name="threadCount">The number of worker threads, 0 for one less than the number of hardware threads</param>
+	JobSystem(unsigned int threadCount);
+	/// <summary>
+	/// Finish every submitted job, then stop the workers
+	/// </summary>
+	~JobSystem();
+
+	/// <summary>
+	/// Queue a job to be run on a worker thread
+	/// </summary>
+	void submit(std::function<void()> job);
+	/// <summary>
+	/// Run a task once for every index, spread over the workers and the calling thread, and wait for them all.
+	/// The calling thread takes indices too, so this may be called from inside a job without waiting on itself.
+	/// </summary>
+	/// <param name="count">The number of indices</param>
+	/// <param name="task">What to do for each index, called from several threads at once</param>
+	void parallel_for(unsigned int count, std::function<void(unsigned int)> task);
+	/// <summary>
+	/// The number of jobs submitted but not yet finished
+	/// </summary>
+	unsigned int pending();
+	unsigned int thread_count();
+};
+
+#endif
\ No newline at end of file
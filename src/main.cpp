@@ -13,11 +13,17 @@
 #include "object.h"
 #include "menus.h"
 #include "primitives.h"
+#include "compressedtexture.h"
 
 Scene* scene;
 
-int main()
+int main(int argc, char** argv)
 {
+	if (argc >= 2 && std::string(argv[1]) == "--compress-textures")
+	{
+		return sterling_compress_textures(argc - 2, argv + 2);
+	}
+
 #ifdef _DEBUG
 	// wait for user input
 	std::cout << "Type anything and press enter to start (For connection to RenderDoc): ";
@@ -132,7 +138,8 @@ int main()
 		menus::refresh();
 		menus::scene_tree(scene);
 		menus::properties();
-		menus::settings();
+		menus::settings(scene);
+		menus::viewport_picking(scene);
 		if (menus::wireframe && !wasWireframe)
 		{
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -165,6 +172,34 @@ int main()
 	return 0;
 }
 
+static int sterling_compress_textures(int argumentCount, char** arguments)
+{
+	// the format is optional, BC7 suiting colour maps with or without alpha
+	BlockFormat format = BLOCK_FORMAT_BC7;
+	int firstPath = argumentCount > 0 && compressedtexture::parse_format(arguments[0], &format) ? 1 : 0;
+	// colour unless told the images hold data, as two channel formats always do
+	bool colour = format != BLOCK_FORMAT_BC5;
+	if (firstPath < argumentCount && std::string(arguments[firstPath]) == "--linear")
+	{
+		colour = false;
+		firstPath++;
+	}
+	if (firstPath == argumentCount)
+	{
+		std::cerr << "Usage: Sterling --compress-textures [bc1|bc3|bc5|bc7] [--linear] <file or directory>..." << std::endl;
+		return 1;
+	}
+	JobSystem jobs(0);
+	bool succeeded = true;
+	for (int argument = firstPath; argument < argumentCount; argument++)
+	{
+		unsigned int transcoded = compressedtexture::transcode_all(arguments[argument], format, colour, &jobs);
+		std::cout << arguments[argument] << ": " << transcoded << " texture(s) compressed to " << compressedtexture::format_name(format) << std::endl;
+		succeeded = succeeded && transcoded > 0;
+	}
+	return succeeded ? 0 : 1;
+}
+
 static void sterling_glfw_error_callback(int id, const char* description)
 {
 	throw "ERROR::GLFW::" + std::to_string(id) + "::" + description;
@@ -2,10 +2,20 @@
 #define STERLING_MAIN_H
 
 /// <summary>
-/// Entry point for the program
+/// Entry point for the program. Run with --compress-textures to transcode textures offline instead of opening a window.
 /// </summary>
 /// <returns>0 if exitted successfully</returns>
-int main();
+int main(int argc, char** argv);
+
+/// <summary>
+/// Transcode images into block compressed .dds files next to them, which textures then load in their place.
+/// Usage: --compress-textures [bc1|bc3|bc5|bc7] [--linear] file or directory...
+/// --linear averages the levels of data maps, such as bump, shininess and dissolve maps, without gamma correction.
+/// </summary>
+/// <param name="argumentCount">The number of arguments after --compress-textures</param>
+/// <param name="arguments">The arguments after --compress-textures</param>
+/// <returns>0 if every image was transcoded</returns>
+static int sterling_compress_textures(int argumentCount, char** arguments);
 
 /// <summary>
 /// Allows GLFW to print error messages to the console
@@ -0,0 +1,124 @@
+#include "mappedfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	mapping = NULL;
+	length = 0;
+#ifdef _WIN32
+	fileHandle = NULL;
+	mappingHandle = NULL;
+#else
+	descriptor = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (fileMapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(fileMapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = fileMapping;
+	mapping = (const unsigned char*)view;
+	length = (size_t)fileSize.QuadPart;
+#else
+	int file = ::open(path, O_RDONLY);
+	if (file == -1)
+	{
+		return false;
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+	void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(file);
+		return false;
+	}
+	// the file is mostly read front to back
+	madvise(view, (size_t)status.st_size, MADV_SEQUENTIAL);
+	descriptor = file;
+	mapping = (const unsigned char*)view;
+	length = (size_t)status.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapping == NULL)
+	{
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+	CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+	fileHandle = NULL;
+	mappingHandle = NULL;
+#else
+	munmap((void*)mapping, length);
+	::close(descriptor);
+	descriptor = -1;
+#endif
+	mapping = NULL;
+	length = 0;
+}
+
+bool MappedFile::is_open() const
+{
+	return mapping != NULL;
+}
+
+const unsigned char* MappedFile::data() const
+{
+	return mapping;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
\ No newline at end of file
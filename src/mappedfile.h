@@ -0,0 +1,41 @@
+#ifndef STERLING_MAPPEDFILE_H
+#define STERLING_MAPPEDFILE_H
+
+#include <stddef.h>
+
+/// <summary>
+/// A whole file mapped read-only into memory. Pages are read in by the OS as they are touched, so large files can be
+/// parsed or handed to the GPU without first being copied into a buffer.
+/// </summary>
+class MappedFile
+{
+private:
+	const unsigned char* mapping;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int descriptor;
+#endif
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	/// <summary>
+	/// Map a file, closing any file already mapped
+	/// </summary>
+	/// <param name="path">The path of the file to map</param>
+	/// <returns>Whether the file could be opened and mapped. Empty files can't be mapped.</returns>
+	bool open(const char* path);
+	/// <summary>
+	/// Unmap the file. Pointers into it are no longer valid.
+	/// </summary>
+	void close();
+	bool is_open() const;
+	const unsigned char* data() const;
+	size_t size() const;
+};
+
+#endif
\ No newline at end of file
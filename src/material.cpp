@@ -2,8 +2,9 @@
 
 Material::Material(const char* vertexShader, const char* fragmentShader)
 {
-	// set up the shader
-	shader = new Shader(vertexShader, fragmentShader);
+	// set up the shaders
+	shaders[VERTEX_FORMAT_STANDARD] = Shader::load(vertexShader, fragmentShader);
+	shaders[VERTEX_FORMAT_PACKED] = Shader::load(vertexShader, fragmentShader, "#define STERLING_PACKED_VERTICES\n");
 
 	ambientColour = maths::vec3f(0, 0, 0);
 	diffuseColour = maths::vec3f(0, 0, 0);
@@ -24,37 +25,67 @@ Material::Material(const char* vertexShader, const char* fragmentShader)
 	indexOfRefractionMap = NULL;
 	dissolveMap = NULL;
 	bumpMap = NULL;
+	textureCache = NULL;
 }
 
-void Material::use(maths::mat4f model)
+Material::~Material()
 {
-	shader->use();
-	shader->setMat4f("model", model);
+	if (textureCache != NULL)
+	{
+		Texture2D* maps[9] = { ambientMap, diffuseMap, specularMap, emissionMap, transmittanceMap, shininessMap, indexOfRefractionMap, dissolveMap, bumpMap };
+		for (int map = 0; map < 9; map++)
+		{
+			if (maps[map] != NULL)
+			{
+				textureCache->release(maps[map]);
+			}
+		}
+	}
+}
 
-	shader->setVec3f("material.ambient", ambientColour.x, ambientColour.y, ambientColour.z);
-	shader->setVec3f("material.diffuse", diffuseColour.x, diffuseColour.y, diffuseColour.z);
-	shader->setVec3f("material.specular", specularColour.x, specularColour.y, specularColour.z);
-	shader->setFloat("material.shininess", shininess);
+void Material::use(VertexFormat format)
+{
+	shaders[format]->use();
 
+	// the samplers are bound to fixed texture units in the shader
 	if (ambientMap != NULL)
 	{
-		shader->setBool("textures.useAmbient", true);
-		shader->setInt("textures.ambient", 0);
 		glActiveTexture(GL_TEXTURE0);
 		ambientMap->use();
 	}
 	if (diffuseMap != NULL)
 	{
-		shader->setBool("textures.useDiffuse", true);
-		shader->setInt("textures.diffuse", 1);
 		glActiveTexture(GL_TEXTURE1);
 		diffuseMap->use();
 	}
 	if (specularMap != NULL)
 	{
-		shader->setBool("textures.useSpecular", true);
-		shader->setInt("textures.specular", 2);
 		glActiveTexture(GL_TEXTURE2);
 		specularMap->use();
 	}
+}
+
+Shader* Material::get_shader(VertexFormat format)
+{
+	return shaders[format];
+}
+
+void Material::pack(MaterialData* data)
+{
+	data->ambient[0] = ambientColour.x;
+	data->ambient[1] = ambientColour.y;
+	data->ambient[2] = ambientColour.z;
+	data->shininess = shininess;
+	data->diffuse[0] = diffuseColour.x;
+	data->diffuse[1] = diffuseColour.y;
+	data->diffuse[2] = diffuseColour.z;
+	data->useAmbientMap = ambientMap != NULL;
+	data->specular[0] = specularColour.x;
+	data->specular[1] = specularColour.y;
+	data->specular[2] = specularColour.z;
+	data->useDiffuseMap = diffuseMap != NULL;
+	data->useSpecularMap = specularMap != NULL;
+	data->padding[0] = 0;
+	data->padding[1] = 0;
+	data->padding[2] = 0;
 }
\ No newline at end of file
@@ -4,13 +4,36 @@
 #include "maths.h"
 #include "textures.h"
 #include "shaders.h"
+#include "geometry.h"
+
+/// <summary>
+/// The std430 layout of one material in the scene's material buffer, matching the Material struct in shaded.frag
+/// </summary>
+struct MaterialData
+{
+	float ambient[3];
+	float shininess;
+	float diffuse[3];
+	unsigned int useAmbientMap;
+	float specular[3];
+	unsigned int useDiffuseMap;
+	unsigned int useSpecularMap;
+	unsigned int padding[3];
+};
 
 class Material
 {
 private:
-	Shader* shader;
+	/// <summary>
+	/// The shader program for each vertex format, the same shader files compiled with the format's defines
+	/// </summary>
+	Shader* shaders[VERTEX_FORMAT_COUNT];
 
 public:
+	/// <summary>
+	/// The name the material was defined with, empty if it has none
+	/// </summary>
+	std::string name;
 	maths::vec3f ambientColour;
 	maths::vec3f diffuseColour;
 	maths::vec3f specularColour;
@@ -30,19 +53,37 @@ public:
 	Texture2D* indexOfRefractionMap;
 	Texture2D* dissolveMap;
 	Texture2D* bumpMap;
+	/// <summary>
+	/// The cache the maps were acquired from, given back to when the material is deleted. NULL if they weren't.
+	/// </summary>
+	TextureCache* textureCache;
 
 	/// <summary>
-	/// Initialise the material, setting up the shader
+	/// Initialise the material, setting up the shader. Materials using the same shader files share one compiled program.
 	/// </summary>
 	/// <param name="vertexShader">The path to the vertex shader to use</param>
 	/// <param name="fragmentShader">The path to the fragment shader to use</param>
 	Material(const char* vertexShader, const char* fragmentShader);
+	/// <summary>
+	/// Give the maps back to the texture cache they were acquired from, if any
+	/// </summary>
+	~Material();
 
 	/// <summary>
-	/// Set OpenGL to use this material for any future rendering calls
+	/// Set OpenGL to use this material's shader and textures for any future rendering calls.
+	/// The colours and texture flags are read from the scene's material buffer instead.
+	/// </summary>
+	/// <param name="format">The vertex format of what will be drawn</param>
+	void use(VertexFormat format);
+	/// <summary>
+	/// The shader program this material draws vertices of a format with
+	/// </summary>
+	Shader* get_shader(VertexFormat format);
+	/// <summary>
+	/// Write this material's parameters into its slot of the material buffer
 	/// </summary>
-	/// <param name="model">The matrix for the object's local space -> world space</param>
-	void use(maths::mat4f model);
+	/// <param name="data">The slot to write to</param>
+	void pack(MaterialData* data);
 };
 
 #endif
\ No newline at end of file
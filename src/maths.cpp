@@ -1,7 +1,12 @@
 #include "maths.h"
 #include <math.h>
+#include <string.h>
 #include <iostream>
 
+#ifdef STERLING_SIMD_SSE
+#include <immintrin.h>
+#endif
+
 namespace maths
 {
 	/*
@@ -172,6 +177,45 @@ namespace maths
 
 	mat4f mat4f::operator*(const mat4f& matrix)
 	{
+#if defined(STERLING_SIMD_AVX)
+		// two rows of the result per iteration, one in each 128-bit lane
+		mat4f result;
+		__m256 other0 = _mm256_broadcast_ps((const __m128*)&matrix.m11);
+		__m256 other1 = _mm256_broadcast_ps((const __m128*)&matrix.m21);
+		__m256 other2 = _mm256_broadcast_ps((const __m128*)&matrix.m31);
+		__m256 other3 = _mm256_broadcast_ps((const __m128*)&matrix.m41);
+		const float* rows = &m11;
+		float* resultRows = &result.m11;
+		for (int row = 0; row < 4; row += 2)
+		{
+			__m256 pair = _mm256_loadu_ps(rows + row * 4);
+			__m256 sum = _mm256_mul_ps(_mm256_shuffle_ps(pair, pair, _MM_SHUFFLE(0, 0, 0, 0)), other0);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 1, 1, 1)), other1));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(pair, pair, _MM_SHUFFLE(2, 2, 2, 2)), other2));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_shuffle_ps(pair, pair, _MM_SHUFFLE(3, 3, 3, 3)), other3));
+			_mm256_storeu_ps(resultRows + row * 4, sum);
+		}
+		return result;
+#elif defined(STERLING_SIMD_SSE)
+		// each row of the result is a linear combination of the rows of the right hand matrix
+		mat4f result;
+		__m128 other0 = _mm_loadu_ps(&matrix.m11);
+		__m128 other1 = _mm_loadu_ps(&matrix.m21);
+		__m128 other2 = _mm_loadu_ps(&matrix.m31);
+		__m128 other3 = _mm_loadu_ps(&matrix.m41);
+		const float* rows = &m11;
+		float* resultRows = &result.m11;
+		for (int row = 0; row < 4; row++)
+		{
+			__m128 current = _mm_loadu_ps(rows + row * 4);
+			__m128 sum = _mm_mul_ps(_mm_shuffle_ps(current, current, _MM_SHUFFLE(0, 0, 0, 0)), other0);
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(current, current, _MM_SHUFFLE(1, 1, 1, 1)), other1));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(current, current, _MM_SHUFFLE(2, 2, 2, 2)), other2));
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(current, current, _MM_SHUFFLE(3, 3, 3, 3)), other3));
+			_mm_storeu_ps(resultRows + row * 4, sum);
+		}
+		return result;
+#else
 		return mat4f(
 			m11 * matrix.m11 + m12 * matrix.m21 + m13 * matrix.m31 + m14 * matrix.m41,
 			m11 * matrix.m12 + m12 * matrix.m22 + m13 * matrix.m32 + m14 * matrix.m42,
@@ -193,16 +237,30 @@ namespace maths
 			m41 * matrix.m13 + m42 * matrix.m23 + m43 * matrix.m33 + m44 * matrix.m43,
 			m41 * matrix.m14 + m42 * matrix.m24 + m43 * matrix.m34 + m44 * matrix.m44
 		);
+#endif
 	}
 
 	vec4f mat4f::operator*(const vec4f& vector)
 	{
+#ifdef STERLING_SIMD_SSE
+		// multiply each row by the vector, then transpose so the horizontal sums become vertical adds
+		__m128 column = _mm_loadu_ps(&vector.x);
+		__m128 row0 = _mm_mul_ps(_mm_loadu_ps(&m11), column);
+		__m128 row1 = _mm_mul_ps(_mm_loadu_ps(&m21), column);
+		__m128 row2 = _mm_mul_ps(_mm_loadu_ps(&m31), column);
+		__m128 row3 = _mm_mul_ps(_mm_loadu_ps(&m41), column);
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+		vec4f result = vec4f(0, 0, 0, 0);
+		_mm_storeu_ps(&result.x, _mm_add_ps(_mm_add_ps(row0, row1), _mm_add_ps(row2, row3)));
+		return result;
+#else
 		return vec4f(
 			m11 * vector.x + m12 * vector.y + m13 * vector.z + m14 * vector.w,
 			m21 * vector.x + m22 * vector.y + m23 * vector.z + m24 * vector.w,
 			m31 * vector.x + m32 * vector.y + m33 * vector.z + m34 * vector.w,
 			m41 * vector.x + m42 * vector.y + m43 * vector.z + m44 * vector.w
 		);
+#endif
 	}
 
 	mat4f mat4f::stretch_z(float stretch)
@@ -217,12 +275,26 @@ namespace maths
 
 	mat4f mat4f::transpose(mat4f matrix)
 	{
+#ifdef STERLING_SIMD_SSE
+		mat4f result;
+		__m128 row0 = _mm_loadu_ps(&matrix.m11);
+		__m128 row1 = _mm_loadu_ps(&matrix.m21);
+		__m128 row2 = _mm_loadu_ps(&matrix.m31);
+		__m128 row3 = _mm_loadu_ps(&matrix.m41);
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+		_mm_storeu_ps(&result.m11, row0);
+		_mm_storeu_ps(&result.m21, row1);
+		_mm_storeu_ps(&result.m31, row2);
+		_mm_storeu_ps(&result.m41, row3);
+		return result;
+#else
 		return mat4f(
 			matrix.m11, matrix.m21, matrix.m31, matrix.m41,
 			matrix.m12, matrix.m22, matrix.m32, matrix.m42,
 			matrix.m13, matrix.m23, matrix.m33, matrix.m43,
 			matrix.m14, matrix.m24, matrix.m34, matrix.m44
 		);
+#endif
 	}
 
 	/*
@@ -263,12 +335,48 @@ namespace maths
 
 	mat4f unit_quaternion::to_rotation_matrix()
 	{
+#ifdef STERLING_SIMD_SSE
+		// lanes are (r, i, j, k), so r is the w component and i, j, k are x, y, z
+		__m128 quat = _mm_loadu_ps(&r);
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+		// off-diagonal terms: (xy, xz, yz) +/- (zw, yw, xw)
+		__m128 products = _mm_mul_ps(
+			_mm_shuffle_ps(quat, quat, _MM_SHUFFLE(0, 2, 1, 1)),
+			_mm_shuffle_ps(quat, quat, _MM_SHUFFLE(0, 3, 3, 2))
+		);
+		__m128 withReal = _mm_mul_ps(
+			_mm_shuffle_ps(quat, quat, _MM_SHUFFLE(0, 1, 2, 3)),
+			_mm_shuffle_ps(quat, quat, _MM_SHUFFLE(0, 0, 0, 0))
+		);
+		__m128 sum = _mm_and_ps(_mm_mul_ps(two, _mm_add_ps(products, withReal)), xyzMask);
+		__m128 difference = _mm_and_ps(_mm_mul_ps(two, _mm_sub_ps(products, withReal)), xyzMask);
+
+		// diagonal terms: 1 - 2(yy + zz), 1 - 2(xx + zz), 1 - 2(xx + yy)
+		__m128 squares = _mm_mul_ps(quat, quat);
+		__m128 diagonal = _mm_add_ps(
+			_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(0, 1, 1, 2)),
+			_mm_shuffle_ps(squares, squares, _MM_SHUFFLE(0, 2, 3, 3))
+		);
+		diagonal = _mm_and_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(two, diagonal)), xyzMask);
+
+		mat4f result;
+		__m128 diagonalDifference = _mm_unpacklo_ps(diagonal, difference);
+		__m128 sumDiagonal = _mm_unpacklo_ps(sum, diagonal);
+		__m128 differenceSum = _mm_shuffle_ps(difference, sum, _MM_SHUFFLE(2, 2, 1, 1));
+		_mm_storeu_ps(&result.m11, _mm_shuffle_ps(diagonalDifference, sum, _MM_SHUFFLE(3, 1, 1, 0)));
+		_mm_storeu_ps(&result.m21, _mm_shuffle_ps(sumDiagonal, difference, _MM_SHUFFLE(3, 2, 3, 0)));
+		_mm_storeu_ps(&result.m31, _mm_shuffle_ps(differenceSum, diagonal, _MM_SHUFFLE(3, 2, 2, 0)));
+		return result;
+#else
 		return mat4f(
 			1 - 2 * (j * j + k * k), 2 * (i * j - k * r), 2 * (i * k + j * r), 0,
 			2 * (i * j + k * r), 1 - 2 * (i * i + k * k), 2 * (j * k - i * r), 0,
 			2 * (i * k - j * r), 2 * (j * k + i * r), 1 - 2 * (i * i + j * j), 0,
 			0, 0, 0, 1
 		);
+#endif
 	}
 
 	vec3f unit_quaternion::to_euler_angles()
@@ -290,4 +398,386 @@ namespace maths
 	{
 		return unit_quaternion(r, -i, -j, -k);
 	}
+
+	/*
+	Transformation batches
+	*/
+
+	mat4f compose_transformation(vec3f position, unit_quaternion rotation, vec3f scale)
+	{
+		float r = rotation.r, i = rotation.i, j = rotation.j, k = rotation.k;
+		return mat4f(
+			(1 - 2 * (j * j + k * k)) * scale.x, 2 * (i * j - k * r) * scale.y, 2 * (i * k + j * r) * scale.z, position.x,
+			2 * (i * j + k * r) * scale.x, (1 - 2 * (i * i + k * k)) * scale.y, 2 * (j * k - i * r) * scale.z, position.y,
+			2 * (i * k - j * r) * scale.x, 2 * (j * k + i * r) * scale.y, (1 - 2 * (i * i + j * j)) * scale.z, position.z,
+			0, 0, 0, 1
+		);
+	}
+
+	unsigned int transformation_batch::size() const
+	{
+		return positionX.size();
+	}
+
+	void transformation_batch::clear()
+	{
+		positionX.clear(); positionY.clear(); positionZ.clear();
+		rotationR.clear(); rotationI.clear(); rotationJ.clear(); rotationK.clear();
+		scaleX.clear(); scaleY.clear(); scaleZ.clear();
+	}
+
+	void transformation_batch::push_back(vec3f position, unit_quaternion rotation, vec3f scale)
+	{
+		positionX.push_back(position.x); positionY.push_back(position.y); positionZ.push_back(position.z);
+		rotationR.push_back(rotation.r); rotationI.push_back(rotation.i); rotationJ.push_back(rotation.j); rotationK.push_back(rotation.k);
+		scaleX.push_back(scale.x); scaleY.push_back(scale.y); scaleZ.push_back(scale.z);
+	}
+
+	void transformation_batch::compute_matrices(mat4f* output) const
+	{
+		unsigned int count = size();
+		unsigned int index = 0;
+#ifdef STERLING_SIMD_SSE
+		// four transformations per iteration, one per lane. Every matrix element is computed as a vector
+		// across the four transformations, then each group of four elements is transposed into a row.
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 lastRow = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		for (; index + 4 <= count; index += 4)
+		{
+			__m128 w = _mm_loadu_ps(&rotationR[index]);
+			__m128 x = _mm_loadu_ps(&rotationI[index]);
+			__m128 y = _mm_loadu_ps(&rotationJ[index]);
+			__m128 z = _mm_loadu_ps(&rotationK[index]);
+			__m128 sx = _mm_loadu_ps(&scaleX[index]);
+			__m128 sy = _mm_loadu_ps(&scaleY[index]);
+			__m128 sz = _mm_loadu_ps(&scaleZ[index]);
+
+			__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+			__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+			__m128 xw = _mm_mul_ps(x, w), yw = _mm_mul_ps(y, w), zw = _mm_mul_ps(z, w);
+
+			__m128 row0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+			__m128 row1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy);
+			__m128 row2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz);
+			__m128 row3 = _mm_loadu_ps(&positionX[index]);
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(&output[index].m11, row0);
+			_mm_storeu_ps(&output[index + 1].m11, row1);
+			_mm_storeu_ps(&output[index + 2].m11, row2);
+			_mm_storeu_ps(&output[index + 3].m11, row3);
+
+			row0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx);
+			row1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+			row2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz);
+			row3 = _mm_loadu_ps(&positionY[index]);
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(&output[index].m21, row0);
+			_mm_storeu_ps(&output[index + 1].m21, row1);
+			_mm_storeu_ps(&output[index + 2].m21, row2);
+			_mm_storeu_ps(&output[index + 3].m21, row3);
+
+			row0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx);
+			row1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy);
+			row2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+			row3 = _mm_loadu_ps(&positionZ[index]);
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(&output[index].m31, row0);
+			_mm_storeu_ps(&output[index + 1].m31, row1);
+			_mm_storeu_ps(&output[index + 2].m31, row2);
+			_mm_storeu_ps(&output[index + 3].m31, row3);
+
+			_mm_storeu_ps(&output[index].m41, lastRow);
+			_mm_storeu_ps(&output[index + 1].m41, lastRow);
+			_mm_storeu_ps(&output[index + 2].m41, lastRow);
+			_mm_storeu_ps(&output[index + 3].m41, lastRow);
+		}
+#endif
+		// scalar remainder
+		for (; index < count; index++)
+		{
+			output[index] = compose_transformation(
+				vec3f(positionX[index], positionY[index], positionZ[index]),
+				unit_quaternion(rotationR[index], rotationI[index], rotationJ[index], rotationK[index]),
+				vec3f(scaleX[index], scaleY[index], scaleZ[index])
+			);
+		}
+	}
+
+	/*
+	Bounding volumes
+	*/
+
+	bounding_box::bounding_box()
+	{
+		minimum = vec3f(INFINITY, INFINITY, INFINITY);
+		maximum = vec3f(-INFINITY, -INFINITY, -INFINITY);
+	}
+
+	bounding_box::bounding_box(vec3f Minimum, vec3f Maximum)
+	{
+		minimum = Minimum;
+		maximum = Maximum;
+	}
+
+	bool bounding_box::empty() const
+	{
+		return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z;
+	}
+
+	vec3f bounding_box::centre() const
+	{
+		return vec3f((minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f);
+	}
+
+	vec3f bounding_box::extent() const
+	{
+		return vec3f((maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f);
+	}
+
+	float bounding_box::surface_area() const
+	{
+		float width = maximum.x - minimum.x;
+		float depth = maximum.y - minimum.y;
+		float height = maximum.z - minimum.z;
+		return 2.0f * (width * depth + depth * height + height * width);
+	}
+
+	void bounding_box::add(vec3f point)
+	{
+		minimum = vec3f(fminf(minimum.x, point.x), fminf(minimum.y, point.y), fminf(minimum.z, point.z));
+		maximum = vec3f(fmaxf(maximum.x, point.x), fmaxf(maximum.y, point.y), fmaxf(maximum.z, point.z));
+	}
+
+	void bounding_box::add(const bounding_box& box)
+	{
+		minimum = vec3f(fminf(minimum.x, box.minimum.x), fminf(minimum.y, box.minimum.y), fminf(minimum.z, box.minimum.z));
+		maximum = vec3f(fmaxf(maximum.x, box.maximum.x), fmaxf(maximum.y, box.maximum.y), fmaxf(maximum.z, box.maximum.z));
+	}
+
+	bool bounding_box::contains(const bounding_box& box) const
+	{
+		return minimum.x <= box.minimum.x && minimum.y <= box.minimum.y && minimum.z <= box.minimum.z
+			&& maximum.x >= box.maximum.x && maximum.y >= box.maximum.y && maximum.z >= box.maximum.z;
+	}
+
+	bool bounding_box::overlaps(const bounding_box& box) const
+	{
+		return minimum.x <= box.maximum.x && minimum.y <= box.maximum.y && minimum.z <= box.maximum.z
+			&& maximum.x >= box.minimum.x && maximum.y >= box.minimum.y && maximum.z >= box.minimum.z;
+	}
+
+	bounding_box bounding_box::combine(const bounding_box& box1, const bounding_box& box2)
+	{
+		bounding_box box = box1;
+		box.add(box2);
+		return box;
+	}
+
+	bounding_box bounding_box::transform(const mat4f& matrix, const bounding_box& box)
+	{
+		if (box.empty())
+		{
+			return box;
+		}
+		vec3f c = box.centre();
+		vec3f e = box.extent();
+		vec3f centre = vec3f(
+			matrix.m11 * c.x + matrix.m12 * c.y + matrix.m13 * c.z + matrix.m14,
+			matrix.m21 * c.x + matrix.m22 * c.y + matrix.m23 * c.z + matrix.m24,
+			matrix.m31 * c.x + matrix.m32 * c.y + matrix.m33 * c.z + matrix.m34
+		);
+		vec3f extent = vec3f(
+			fabsf(matrix.m11) * e.x + fabsf(matrix.m12) * e.y + fabsf(matrix.m13) * e.z,
+			fabsf(matrix.m21) * e.x + fabsf(matrix.m22) * e.y + fabsf(matrix.m23) * e.z,
+			fabsf(matrix.m31) * e.x + fabsf(matrix.m32) * e.y + fabsf(matrix.m33) * e.z
+		);
+		return bounding_box(centre - extent, centre + extent);
+	}
+
+	frustum::frustum()
+	{
+		for (int plane = 0; plane < 8; plane++)
+		{
+			planeX[plane] = 0;
+			planeY[plane] = 0;
+			planeZ[plane] = 0;
+			planeD[plane] = 0;
+		}
+	}
+
+	frustum::frustum(const mat4f& viewProjection)
+	{
+		const mat4f& m = viewProjection;
+		// clip space x, y, z, w are the rows of the matrix dotted with the point.
+		// inside means -w <= x <= w, -w <= y <= w and 0 <= z <= w
+		float planes[6][4] = {
+			{ m.m41 + m.m11, m.m42 + m.m12, m.m43 + m.m13, m.m44 + m.m14 }, // left
+			{ m.m41 - m.m11, m.m42 - m.m12, m.m43 - m.m13, m.m44 - m.m14 }, // right
+			{ m.m41 + m.m21, m.m42 + m.m22, m.m43 + m.m23, m.m44 + m.m24 }, // bottom
+			{ m.m41 - m.m21, m.m42 - m.m22, m.m43 - m.m23, m.m44 - m.m24 }, // top
+			{ m.m31, m.m32, m.m33, m.m34 }, // near
+			{ m.m41 - m.m31, m.m42 - m.m32, m.m43 - m.m33, m.m44 - m.m34 } // far
+		};
+		for (int plane = 0; plane < 8; plane++)
+		{
+			float* source = planes[plane % 6];
+			// normalised so that sphere tests can compare against the radius
+			float length = sqrtf(source[0] * source[0] + source[1] * source[1] + source[2] * source[2]);
+			if (length == 0)
+			{
+				length = 1;
+			}
+			planeX[plane] = source[0] / length;
+			planeY[plane] = source[1] / length;
+			planeZ[plane] = source[2] / length;
+			planeD[plane] = source[3] / length;
+		}
+	}
+
+	bool frustum::intersects(const bounding_box& box) const
+	{
+		if (box.empty())
+		{
+			return false;
+		}
+#ifdef STERLING_SIMD_SSE
+		// for each plane, take the corner of the box furthest along the plane's normal. If that corner is behind
+		// any plane, the whole box is outside.
+		__m128 minimumX = _mm_set1_ps(box.minimum.x), maximumX = _mm_set1_ps(box.maximum.x);
+		__m128 minimumY = _mm_set1_ps(box.minimum.y), maximumY = _mm_set1_ps(box.maximum.y);
+		__m128 minimumZ = _mm_set1_ps(box.minimum.z), maximumZ = _mm_set1_ps(box.maximum.z);
+		__m128 zero = _mm_setzero_ps();
+		int outside = 0;
+		for (int group = 0; group < 8; group += 4)
+		{
+			__m128 x = _mm_loadu_ps(&planeX[group]);
+			__m128 y = _mm_loadu_ps(&planeY[group]);
+			__m128 z = _mm_loadu_ps(&planeZ[group]);
+			__m128 distance = _mm_loadu_ps(&planeD[group]);
+			distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(x, minimumX), _mm_mul_ps(x, maximumX)));
+			distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(y, minimumY), _mm_mul_ps(y, maximumY)));
+			distance = _mm_add_ps(distance, _mm_max_ps(_mm_mul_ps(z, minimumZ), _mm_mul_ps(z, maximumZ)));
+			outside |= _mm_movemask_ps(_mm_cmplt_ps(distance, zero));
+		}
+		return outside == 0;
+#else
+		bool inside = true;
+		for (int plane = 0; plane < 6 && inside; plane++)
+		{
+			float distance = planeD[plane]
+				+ fmaxf(planeX[plane] * box.minimum.x, planeX[plane] * box.maximum.x)
+				+ fmaxf(planeY[plane] * box.minimum.y, planeY[plane] * box.maximum.y)
+				+ fmaxf(planeZ[plane] * box.minimum.z, planeZ[plane] * box.maximum.z);
+			inside = distance >= 0;
+		}
+		return inside;
+#endif
+	}
+
+	bool frustum::intersects(const bounding_sphere& sphere) const
+	{
+		bool inside = true;
+		for (int plane = 0; plane < 6 && inside; plane++)
+		{
+			float distance = planeX[plane] * sphere.centre.x + planeY[plane] * sphere.centre.y + planeZ[plane] * sphere.centre.z + planeD[plane];
+			inside = distance >= -sphere.radius;
+		}
+		return inside;
+	}
+
+	bool frustum::contains(const bounding_box& box) const
+	{
+		// the corner of the box furthest against each plane's normal must be in front of it
+		bool inside = !box.empty();
+		for (int plane = 0; plane < 6 && inside; plane++)
+		{
+			float distance = planeD[plane]
+				+ fminf(planeX[plane] * box.minimum.x, planeX[plane] * box.maximum.x)
+				+ fminf(planeY[plane] * box.minimum.y, planeY[plane] * box.maximum.y)
+				+ fminf(planeZ[plane] * box.minimum.z, planeZ[plane] * box.maximum.z);
+			inside = distance >= 0;
+		}
+		return inside;
+	}
+	/*
+	Vertex packing
+	*/
+
+	unsigned short float_to_half(float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(float));
+		unsigned int sign = (bits >> 16) & 0x8000;
+		unsigned int exponent = (bits >> 23) & 0xff;
+		unsigned int mantissa = bits & 0x7fffff;
+
+		if (exponent == 0xff)
+		{
+			// infinity stays infinity, NaN stays a NaN
+			return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+		}
+		int halfExponent = (int)exponent - 127 + 15;
+		if (halfExponent >= 31)
+		{
+			return sign | 0x7c00;
+		}
+		if (halfExponent <= 0)
+		{
+			// subnormal in half precision, or too small and flushed to zero
+			if (halfExponent < -10)
+			{
+				return sign;
+			}
+			mantissa |= 0x800000;
+			unsigned int shift = 14 - halfExponent;
+			unsigned int halfMantissa = mantissa >> shift;
+			unsigned int remainder = mantissa & ((1u << shift) - 1);
+			unsigned int halfway = 1u << (shift - 1);
+			if (remainder > halfway || (remainder == halfway && (halfMantissa & 1)))
+			{
+				halfMantissa++;
+			}
+			return sign | halfMantissa;
+		}
+		unsigned int half = sign | (halfExponent << 10) | (mantissa >> 13);
+		unsigned int remainder = mantissa & 0x1fff;
+		// a carry out of the mantissa correctly moves up to the next exponent
+		if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		{
+			half++;
+		}
+		return half;
+	}
+
+	vec2f octahedral_encode(vec3f normal)
+	{
+		float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		if (length == 0)
+		{
+			return vec2f(0, 0);
+		}
+		float x = normal.x / length;
+		float y = normal.y / length;
+		if (normal.z < 0)
+		{
+			// fold the lower half of the octahedron out over the corners
+			float foldedX = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+			float foldedY = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+		return vec2f(x, y);
+	}
+
+	vec3f octahedral_decode(vec2f encoded)
+	{
+		vec3f normal = vec3f(encoded.x, encoded.y, 1.0f - fabsf(encoded.x) - fabsf(encoded.y));
+		if (normal.z < 0)
+		{
+			normal.x = (1.0f - fabsf(encoded.y)) * (encoded.x >= 0 ? 1.0f : -1.0f);
+			normal.y = (1.0f - fabsf(encoded.x)) * (encoded.y >= 0 ? 1.0f : -1.0f);
+		}
+		return vec3f::normalise(normal);
+	}
 }
\ No newline at end of file
@@ -1,6 +1,17 @@
 #ifndef STERLING_MATHS_H
 #define STERLING_MATHS_H
 
+// SIMD code paths. SSE2 is available on every x64 target, AVX only when the compiler is told to use it (/arch:AVX).
+// Define STERLING_NO_SIMD to force the scalar fallback.
+#if !defined(STERLING_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define STERLING_SIMD_SSE
+#endif
+#if defined(STERLING_SIMD_SSE) && defined(__AVX__)
+#define STERLING_SIMD_AVX
+#endif
+
+#include <vector>
+
 namespace maths
 {
 	const float PI = 3.141592653589f;
@@ -45,7 +56,7 @@ namespace maths
 		vec3f operator-(const vec3f& vector);
 	};
 
-	struct vec4f
+	struct alignas(16) vec4f
 	{
 		float x, y, z, w;
 
@@ -64,7 +75,10 @@ namespace maths
 		vec4f operator-(const vec4f& vector);
 	};
 
-	struct mat4f
+	/// <summary>
+	/// Row-major 4x4 matrix. Rows are contiguous and 16-byte aligned so they can be loaded straight into SIMD registers.
+	/// </summary>
+	struct alignas(16) mat4f
 	{
 		float m11, m12, m13, m14;
 		float m21, m22, m23, m24;
@@ -129,6 +143,121 @@ namespace maths
 
 		unit_quaternion conjugate();
 	};
+
+	/// <summary>
+	/// Builds the matrix translation * rotation * scale directly, without the intermediate matrix products
+	/// </summary>
+	mat4f compose_transformation(vec3f position, unit_quaternion rotation, vec3f scale);
+
+	/// <summary>
+	/// A batch of positions, rotations and scales stored as structure-of-arrays, so that many model matrices can be built in one vectorised pass
+	/// </summary>
+	struct transformation_batch
+	{
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> rotationR, rotationI, rotationJ, rotationK;
+		std::vector<float> scaleX, scaleY, scaleZ;
+
+		unsigned int size() const;
+		void clear();
+		void push_back(vec3f position, unit_quaternion rotation, vec3f scale);
+
+		/// <summary>
+		/// Write translation * rotation * scale for every entry in the batch
+		/// </summary>
+		/// <param name="output">Array with room for size() matrices</param>
+		void compute_matrices(mat4f* output) const;
+	};
+
+	/// <summary>
+	/// Axis aligned bounding box. A default constructed box is empty and grows to fit whatever is added to it.
+	/// </summary>
+	struct bounding_box
+	{
+		vec3f minimum, maximum;
+
+		bounding_box();
+		bounding_box(vec3f Minimum, vec3f Maximum);
+
+		bool empty() const;
+		vec3f centre() const;
+		/// <summary>
+		/// Half of the box's size along each axis
+		/// </summary>
+		vec3f extent() const;
+		float surface_area() const;
+		void add(vec3f point);
+		void add(const bounding_box& box);
+		/// <summary>
+		/// Whether the other box is entirely inside this one
+		/// </summary>
+		bool contains(const bounding_box& box) const;
+		bool overlaps(const bounding_box& box) const;
+
+		/// <summary>
+		/// The smallest box around both boxes
+		/// </summary>
+		static bounding_box combine(const bounding_box& box1, const bounding_box& box2);
+
+		/// <summary>
+		/// The smallest axis aligned box around the transformed box, built from the transformed centre and extents (Arvo's method)
+		/// </summary>
+		static bounding_box transform(const mat4f& matrix, const bounding_box& box);
+	};
+
+	struct bounding_sphere
+	{
+		vec3f centre;
+		float radius;
+
+		bounding_sphere()
+		{
+			radius = 0;
+		}
+		bounding_sphere(vec3f Centre, float Radius)
+		{
+			centre = Centre;
+			radius = Radius;
+		}
+	};
+
+	/// <summary>
+	/// The six planes of a view frustum, pointing inwards. Stored as structure-of-arrays and padded to eight planes
+	/// (the last two repeat the first) so a box can be tested against four planes at once.
+	/// </summary>
+	struct alignas(16) frustum
+	{
+		float planeX[8], planeY[8], planeZ[8], planeD[8];
+
+		frustum();
+		/// <summary>
+		/// Extract the planes from a projection * view matrix, for a projection that maps depth to [0, 1]
+		/// </summary>
+		frustum(const mat4f& viewProjection);
+
+		/// <summary>
+		/// Whether any part of the box might be inside the frustum. Conservative: boxes near the corners can pass without being visible.
+		/// </summary>
+		bool intersects(const bounding_box& box) const;
+		bool intersects(const bounding_sphere& sphere) const;
+		/// <summary>
+		/// Whether the whole box is inside the frustum
+		/// </summary>
+		bool contains(const bounding_box& box) const;
+	};
+
+	/// <summary>
+	/// Convert a float to IEEE half precision, rounding to nearest even. Out of range values become infinity.
+	/// </summary>
+	unsigned short float_to_half(float value);
+	/// <summary>
+	/// Map a unit vector onto the octahedron and unfold it into the [-1, 1] square, so it can be stored in two components
+	/// </summary>
+	vec2f octahedral_encode(vec3f normal);
+	/// <summary>
+	/// The inverse of octahedral_encode, the result is normalised
+	/// </summary>
+	vec3f octahedral_decode(vec2f encoded);
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "menus.h"
 #include "maths.h"
 #include "primitives.h"
+#include "benchmarks.h"
 
 namespace menus
 {
@@ -12,6 +13,10 @@ namespace menus
 	Spotlight* selectedSpotlight = NULL;
 	DirectionalLight* selectedDirectionalLight = NULL;
 	bool wireframe = false;
+	/// <summary>
+	/// The results of the last benchmark run from the settings window
+	/// </summary>
+	std::vector<BenchmarkResult> benchmarkResults;
 
 	void menus::setup(GLFWwindow* window)
 	{
@@ -63,8 +68,7 @@ namespace menus
 					IM_ASSERT(payload->DataSize == sizeof(Object*));
 					Object* toAdd = *(Object**)(payload->Data);
 					toAdd->remove_from_parent();
-					toAdd->parent = NULL;
-					scene->children.push_back(toAdd);
+					scene->add_object(toAdd);
 				}
 				ImGui::EndDragDropTarget();
 			}
@@ -136,6 +140,33 @@ namespace menus
 		ImGui::End();
 	}
 
+	void menus::select_object(Object* object)
+	{
+		selectedObject = object;
+		selectedCamera = dynamic_cast<Camera*>(selectedObject);
+		selectedLight = dynamic_cast<Light*>(selectedObject);
+		selectedAmbientLight = dynamic_cast<AmbientLight*>(selectedObject);
+		selectedPointLight = dynamic_cast<PointLight*>(selectedObject);
+		selectedSpotlight = dynamic_cast<Spotlight*>(selectedObject);
+		selectedDirectionalLight = dynamic_cast<DirectionalLight*>(selectedObject);
+	}
+
+	void menus::viewport_picking(Scene* scene)
+	{
+		ImGuiIO& io = ImGui::GetIO();
+		if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !io.WantCaptureMouse && scene->activeCamera != NULL)
+		{
+			float x = 2.0f * io.MousePos.x / io.DisplaySize.x - 1.0f;
+			float y = 1.0f - 2.0f * io.MousePos.y / io.DisplaySize.y;
+			maths::vec3f origin;
+			maths::vec3f direction;
+			scene->activeCamera->screen_ray(x, y, &origin, &direction);
+			float distance;
+			// clicking on nothing clears the selection
+			menus::select_object(scene->bvh.ray_cast(origin, direction, scene->activeCamera->farClip(), &distance));
+		}
+	}
+
 	void menus::object_tree(Object* object, unsigned int* ID)
 	{
 		ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow;
@@ -155,13 +186,7 @@ namespace menus
 		{
 			if (ImGui::IsItemClicked())
 			{
-				selectedObject = object;
-				selectedCamera = dynamic_cast<Camera*>(selectedObject);
-				selectedLight = dynamic_cast<Light*>(selectedObject);
-				selectedAmbientLight = dynamic_cast<AmbientLight*>(selectedObject);
-				selectedPointLight = dynamic_cast<PointLight*>(selectedObject);
-				selectedSpotlight = dynamic_cast<Spotlight*>(selectedObject);
-				selectedDirectionalLight = dynamic_cast<DirectionalLight*>(selectedObject);
+				menus::select_object(object);
 			}
 			if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_None))
 			{
@@ -178,8 +203,7 @@ namespace menus
 					IM_ASSERT(payload->DataSize == sizeof(Object*));
 					Object* toAdd = *(Object**)(payload->Data);
 					toAdd->remove_from_parent();
-					toAdd->parent = object;
-					object->children.push_back(toAdd);
+					object->add_child(toAdd);
 				}
 				ImGui::EndDragDropTarget();
 			}
@@ -408,6 +432,39 @@ namespace menus
 					selectedSpotlight->outerCutoff(outer);
 				}
 			}
+			if (selectedObject->hasMesh && selectedObject->scene != NULL)
+			{
+				if (ImGui::TreeNodeEx("Mesh"))
+				{
+					Mesh* mesh = selectedObject->scene->meshes[selectedObject->mesh];
+					for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+					{
+						MeshPrimitive* primitive = mesh->primitives[primitiveIndex];
+						ImGui::Text("Primitive %d: %u vertices, %u indices (%u bit)", primitiveIndex, primitive->vertexCount, primitive->indexCount, primitive->index_size() * 8);
+						if (primitive->acmrAfter > 0)
+						{
+							ImGui::Text("ACMR: %.3f -> %.3f", primitive->acmrBefore, primitive->acmrAfter);
+						}
+						// the shaders read the parameters from the material buffer, which needs telling about the edit
+						Material* material = selectedObject->scene->materials[primitive->materialIndex];
+						ImGui::PushID(primitiveIndex);
+						if (ImGui::TreeNodeEx(material->name.empty() ? "Material" : material->name.c_str()))
+						{
+							bool changed = ImGui::ColorEdit3("Ambient", &material->ambientColour.x);
+							changed |= ImGui::ColorEdit3("Diffuse", &material->diffuseColour.x);
+							changed |= ImGui::ColorEdit3("Specular", &material->specularColour.x);
+							changed |= ImGui::DragFloat("Shininess", &material->shininess, 0.1f, 0.0f, 1000.0f);
+							if (changed)
+							{
+								selectedObject->scene->materials_changed();
+							}
+							ImGui::TreePop();
+						}
+						ImGui::PopID();
+					}
+					ImGui::TreePop();
+				}
+			}
 		}
 		else
 		{
@@ -416,11 +473,65 @@ namespace menus
 		ImGui::End();
 	}
 
-	void menus::settings()
+	void menus::settings(Scene* scene)
 	{
 		if (ImGui::Begin("Settings"))
 		{
 			ImGui::Checkbox("Wireframe", &wireframe);
+			ImGui::Checkbox("GPU culling", &scene->gpuCulling);
+			ImGui::Checkbox("Pack vertices of loaded meshes", &scene->packVertices);
+			ImGui::Checkbox("Split loaded meshes for 16 bit indices", &scene->splitLargePrimitives);
+			ImGui::SliderFloat("Upload budget (ms)", &scene->uploadBudget, 0.5f, 16.0f);
+			ImGui::SliderFloat("Texture budget (MiB)", &scene->textureBudget, 16.0f, 4096.0f);
+			if (ImGui::CollapsingHeader("Statistics"))
+			{
+				if (scene->gpuCulling)
+				{
+					ImGui::Text("Instances tested: %u", scene->gpu_instances_tested());
+					ImGui::Text("Indirect draw calls: %u", scene->gpu_draw_calls());
+				}
+				else
+				{
+					RenderStatistics* statistics = &scene->renderQueue.statistics;
+					ImGui::Text("Objects drawn: %u (%u culled)", scene->objectsVisible, scene->objectsCulled);
+					ImGui::Text("Draw items: %u", statistics->drawItems);
+					ImGui::Text("Draw calls: %u", statistics->drawCalls);
+					ImGui::Text("Shader binds: %u (%u avoided)", statistics->shaderBinds, statistics->shaderBindsAvoided);
+					ImGui::Text("Vertex array binds: %u (%u avoided)", statistics->vertexArrayBinds, statistics->vertexArrayBindsAvoided);
+					ImGui::Text("Texture binds: %u (%u avoided)", statistics->textureBinds, statistics->textureBindsAvoided);
+				}
+				GeometryStatistics geometry = scene->geometry.statistics();
+				ImGui::Text("Vertex memory: %u / %u KiB", geometry.vertexBytesUsed / 1024, geometry.vertexBytesTotal / 1024);
+				ImGui::Text("Index memory: %u / %u KiB", geometry.indexBytesUsed / 1024, geometry.indexBytesTotal / 1024);
+				ImGui::Text("Free geometry ranges: %u", geometry.freeRanges);
+				ImGui::Text("Meshes loading: %u", scene->meshes_loading());
+				ImGui::Text("Textures: %u (%u streaming)", scene->textureCache->count(), scene->textures_streaming());
+				ImGui::Text("Texture memory: %u KiB", (unsigned int)(scene->textureCache->video_memory() / 1024));
+			}
+			if (ImGui::CollapsingHeader("Benchmarks"))
+			{
+				if (ImGui::Button("Time .object readers"))
+				{
+					benchmarkResults = benchmarks::object_readers(1000000, 5);
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Time .obj parsers"))
+				{
+					benchmarkResults = benchmarks::obj_parsers(1000000, 3);
+				}
+				for (int resultIndex = 0; resultIndex < benchmarkResults.size(); resultIndex++)
+				{
+					BenchmarkResult* result = &benchmarkResults[resultIndex];
+					if (result->succeeded)
+					{
+						ImGui::Text("%s: %.2f ms (%.0f MiB/s)", result->name.c_str(), result->milliseconds, result->megabytesPerSecond);
+					}
+					else
+					{
+						ImGui::Text("%s: failed", result->name.c_str());
+					}
+				}
+			}
 		}
 		ImGui::End();
 	}
@@ -48,6 +48,16 @@ namespace menus
 	/// </summary>
 	/// <param name="object">The object to add</param>
 	void object_tree(Object* object, unsigned int* ID);
+	/// <summary>
+	/// Make an object the selected object, NULL to clear the selection
+	/// </summary>
+	/// <param name="object">The object to select</param>
+	void select_object(Object* object);
+	/// <summary>
+	/// Select the object under the mouse when the viewport is clicked, by casting a ray through the scene's bounding volume hierarchy
+	/// </summary>
+	/// <param name="scene">The scene shown in the viewport</param>
+	void viewport_picking(Scene* scene);
 	extern Object* selectedObject;
 	extern Camera* selectedCamera;
 	extern Light* selectedLight;
@@ -62,9 +72,10 @@ namespace menus
 	void properties();
 
 	/// <summary>
-	/// Show the settings for the rendering
+	/// Show the settings for the rendering, and statistics about the last frame
 	/// </summary>
-	void settings();
+	/// <param name="scene">The scene being rendered</param>
+	void settings(Scene* scene);
 	extern bool wireframe;
 }
 
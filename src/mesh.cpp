@@ -1,71 +1,289 @@
 #include "mesh.h"
 
 #include "glad/glad.h"
+#include "meshoptimiser.h"
 #include <stddef.h>
+#include <math.h>
+#include <string.h>
 #include <iostream>
 #include <fstream>
 
 MeshPrimitive::MeshPrimitive()
 {
-	VAO = 0;
+	geometry = NULL;
 	vertices = std::vector<Vertex>(0);
 	edges = std::vector<Edge>(0);
 	faces = std::vector<Face>(0);
 	materialIndex = 0;
+	format = VERTEX_FORMAT_STANDARD;
+	mode = GL_TRIANGLES;
+	baseVertex = 0;
+	firstIndex = 0;
+	vertexCount = 0;
+	indexCount = 0;
+	indexType = GL_UNSIGNED_INT;
+	acmrBefore = 0;
+	acmrAfter = 0;
 }
 
-void MeshPrimitive::setup()
+MeshPrimitive::~MeshPrimitive()
 {
-	glGenVertexArrays(1, &VAO);
-	unsigned int VBO, EBO;
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	if (geometry != NULL)
+	{
+		geometry->release(range);
+	}
+}
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+void MeshPrimitive::optimise()
+{
+	if (faces.size() == 0)
+	{
+		return;
+	}
+	unsigned int* indices = &faces[0].vertex1;
+	unsigned int indexCount = faces.size() * 3;
+	acmrBefore = meshoptimiser::acmr(indices, indexCount, vertices.size(), meshoptimiser::CACHE_SIZE);
+	meshoptimiser::optimise_vertex_cache(indices, indexCount, vertices.size());
+	meshoptimiser::optimise_overdraw(indices, indexCount, &vertices[0], vertices.size(), 1.05f);
+	unsigned int vertexCount = meshoptimiser::optimise_vertex_fetch(&vertices[0], vertices.size(), indices, indexCount);
+	vertices.resize(vertexCount);
+	acmrAfter = meshoptimiser::acmr(indices, indexCount, vertices.size(), meshoptimiser::CACHE_SIZE);
+}
 
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+void MeshPrimitive::setup(GeometryBuffer* geometry)
+{
+	std::vector<unsigned char> vertexData;
+	std::vector<unsigned char> indexData;
+	build(&vertexData, &indexData);
+	upload(geometry, vertexData.size() > 0 ? &vertexData[0] : NULL, indexData.size() > 0 ? &indexData[0] : NULL);
+}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	if (faces.size() == 0)
+void MeshPrimitive::build(std::vector<unsigned char>* vertexData, std::vector<unsigned char>* indexData)
+{
+	bounds = maths::bounding_box();
+	for (int vertexIndex = 0; vertexIndex < vertices.size(); vertexIndex++)
 	{
-		// render wireframe or single points
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, edges.size() * sizeof(Edge), &edges[0], GL_STATIC_DRAW);
+		bounds.add(vertices[vertexIndex].position);
 	}
-	else
+	boundingSphere = maths::bounding_sphere(bounds.centre(), 0);
+	for (int vertexIndex = 0; vertexIndex < vertices.size(); vertexIndex++)
+	{
+		maths::vec3f offset = vertices[vertexIndex].position - boundingSphere.centre;
+		boundingSphere.radius = fmaxf(boundingSphere.radius, sqrtf(maths::vec3f::dot(offset, offset)));
+	}
+
+	// everything is drawn indexed, so points get an index each
+	std::vector<unsigned int> indices;
+	if (faces.size() != 0)
 	{
 		// render faces
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(Face), &faces[0], GL_STATIC_DRAW);
+		mode = GL_TRIANGLES;
+		indices.resize(faces.size() * 3);
+		memcpy(&indices[0], &faces[0], faces.size() * sizeof(Face));
 	}
+	else if (edges.size() != 0)
+	{
+		// render wireframe
+		mode = GL_LINES;
+		indices.resize(edges.size() * 2);
+		memcpy(&indices[0], &edges[0], edges.size() * sizeof(Edge));
+	}
+	else
+	{
+		// render single points
+		mode = GL_POINTS;
+		indices.resize(vertices.size());
+		for (unsigned int vertexIndex = 0; vertexIndex < vertices.size(); vertexIndex++)
+		{
+			indices[vertexIndex] = vertexIndex;
+		}
+	}
+	vertexCount = vertices.size();
+	indexCount = indices.size();
 
-	// vertex positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	// vertex normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	// vertex texture coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureCoords));
+	vertexTransform = maths::mat4f();
+	if (format == VERTEX_FORMAT_PACKED && vertices.size() > 0)
+	{
+		// positions become fractions of the bounds, and the matrix taking them back is folded into the model matrix.
+		// Flat axes get a size of 1 so the matrix stays invertible for the normal matrix.
+		maths::vec3f size = maths::vec3f(bounds.maximum.x - bounds.minimum.x, bounds.maximum.y - bounds.minimum.y, bounds.maximum.z - bounds.minimum.z);
+		size.x = size.x > 0 ? size.x : 1;
+		size.y = size.y > 0 ? size.y : 1;
+		size.z = size.z > 0 ? size.z : 1;
+		vertexTransform = maths::mat4f(
+			size.x, 0, 0, bounds.minimum.x,
+			0, size.y, 0, bounds.minimum.y,
+			0, 0, size.z, bounds.minimum.z,
+			0, 0, 0, 1
+		);
 
-	glBindVertexArray(0);
+		vertexData->resize(vertices.size() * sizeof(PackedVertex));
+		PackedVertex* packedVertices = (PackedVertex*)&(*vertexData)[0];
+		for (int vertexIndex = 0; vertexIndex < vertices.size(); vertexIndex++)
+		{
+			Vertex* vertex = &vertices[vertexIndex];
+			PackedVertex* packed = &packedVertices[vertexIndex];
+			packed->position[0] = (unsigned short)lroundf((vertex->position.x - bounds.minimum.x) / size.x * 65535.0f);
+			packed->position[1] = (unsigned short)lroundf((vertex->position.y - bounds.minimum.y) / size.y * 65535.0f);
+			packed->position[2] = (unsigned short)lroundf((vertex->position.z - bounds.minimum.z) / size.z * 65535.0f);
+			packed->position[3] = 0;
+			// the shader's normal matrix undoes the dequantisation scale, so store the normal with that scale applied
+			maths::vec3f scaledNormal = maths::vec3f(vertex->normal.x * size.x, vertex->normal.y * size.y, vertex->normal.z * size.z);
+			maths::vec2f normal = maths::octahedral_encode(scaledNormal);
+			packed->normal[0] = (short)lroundf(normal.x * 32767.0f);
+			packed->normal[1] = (short)lroundf(normal.y * 32767.0f);
+			packed->textureCoords[0] = maths::float_to_half(vertex->textureCoords.x);
+			packed->textureCoords[1] = maths::float_to_half(vertex->textureCoords.y);
+		}
+	}
+	else
+	{
+		vertexData->resize(vertices.size() * sizeof(Vertex));
+		if (vertices.size() > 0)
+		{
+			memcpy(&(*vertexData)[0], &vertices[0], vertices.size() * sizeof(Vertex));
+		}
+	}
+
+	// 16 bit indices are enough to reach every vertex of most primitives, at half the size
+	indexType = GL_UNSIGNED_INT;
+	if (vertices.size() <= 65536)
+	{
+		indexType = GL_UNSIGNED_SHORT;
+		indexData->resize(indices.size() * sizeof(unsigned short));
+		unsigned short* shortIndices = indices.size() > 0 ? (unsigned short*)&(*indexData)[0] : NULL;
+		for (unsigned int index = 0; index < indices.size(); index++)
+		{
+			shortIndices[index] = (unsigned short)indices[index];
+		}
+	}
+	else
+	{
+		indexData->resize(indices.size() * sizeof(unsigned int));
+		memcpy(&(*indexData)[0], &indices[0], indices.size() * sizeof(unsigned int));
+	}
 }
 
-void MeshPrimitive::draw()
+void MeshPrimitive::upload(GeometryBuffer* geometry, const void* vertexData, const void* indexData)
+{
+	unsigned int indexSize = index_size();
+	if (this->geometry != NULL)
+	{
+		this->geometry->release(range);
+	}
+	this->geometry = geometry;
+	range = geometry->add(format, vertexData, vertexCount, indexData, indexCount, indexSize);
+	baseVertex = range.baseVertex;
+	firstIndex = range.indexOffset / indexSize;
+}
+
+unsigned int MeshPrimitive::index_size()
+{
+	return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+unsigned int MeshPrimitive::vertex_array()
+{
+	return geometry->vertex_array(format);
+}
+
+void MeshPrimitive::bind(unsigned int buffer)
+{
+	geometry->bind(format, buffer);
+}
+
+void MeshPrimitive::draw_instanced(unsigned int instanceCount, unsigned int baseInstance)
 {
 	// assume the shader has already been set up with the uniforms etc.
+	glDrawElementsInstancedBaseVertexBaseInstance(mode, indexCount, indexType, (void*)((size_t)firstIndex * index_size()), instanceCount, baseVertex, baseInstance);
+}
 
-	glBindVertexArray(VAO);
-	if (faces.size() != 0)
+maths::mat4f MeshPrimitive::model_matrix(maths::mat4f worldMatrix)
+{
+	if (format == VERTEX_FORMAT_STANDARD)
 	{
-		glDrawElements(GL_TRIANGLES, faces.size() * 3, GL_UNSIGNED_INT, 0);
+		return worldMatrix;
 	}
-	else if (edges.size() != 0)
+	return worldMatrix * vertexTransform;
+}
+
+std::vector<MeshPrimitive*> MeshPrimitive::split(unsigned int maximumVertices)
+{
+	std::vector<MeshPrimitive*> pieces;
+	// the vertex index in the current piece of each of this primitive's vertices, valid if its stamp is the current piece
+	std::vector<unsigned int> remap(vertices.size(), 0);
+	std::vector<unsigned int> stamps(vertices.size(), 0);
+	MeshPrimitive* piece = NULL;
+	for (int faceIndex = 0; faceIndex < faces.size(); faceIndex++)
 	{
-		glDrawElements(GL_LINES, edges.size() * 2, GL_UNSIGNED_INT, 0);
+		unsigned int* corners = &faces[faceIndex].vertex1;
+		unsigned int newVertices = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (piece == NULL || stamps[corners[corner]] != pieces.size())
+			{
+				newVertices++;
+			}
+		}
+		if (piece == NULL || piece->vertices.size() + newVertices > maximumVertices)
+		{
+			// faces are in vertex cache order, so cutting the list into runs keeps each piece's faces close together
+			piece = new MeshPrimitive();
+			piece->materialIndex = materialIndex;
+			piece->format = format;
+			pieces.push_back(piece);
+		}
+		unsigned int pieceCorners[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = corners[corner];
+			if (stamps[vertex] != pieces.size())
+			{
+				stamps[vertex] = pieces.size();
+				remap[vertex] = piece->vertices.size();
+				piece->vertices.push_back(vertices[vertex]);
+			}
+			pieceCorners[corner] = remap[vertex];
+		}
+		piece->faces.push_back(Face(pieceCorners[0], pieceCorners[1], pieceCorners[2]));
 	}
-	else
+	return pieces;
+}
+
+Mesh::~Mesh()
+{
+	for (int primitiveIndex = 0; primitiveIndex < primitives.size(); primitiveIndex++)
+	{
+		delete primitives[primitiveIndex];
+	}
+}
+
+void Mesh::split_large_primitives(unsigned int maximumVertices)
+{
+	std::vector<MeshPrimitive*> splitPrimitives;
+	for (int primitiveIndex = 0; primitiveIndex < primitives.size(); primitiveIndex++)
+	{
+		MeshPrimitive* primitive = primitives[primitiveIndex];
+		if (primitive->vertices.size() > maximumVertices && primitive->faces.size() != 0)
+		{
+			std::vector<MeshPrimitive*> pieces = primitive->split(maximumVertices);
+			splitPrimitives.insert(splitPrimitives.end(), pieces.begin(), pieces.end());
+			delete primitive;
+		}
+		else
+		{
+			splitPrimitives.push_back(primitive);
+		}
+	}
+	primitives = splitPrimitives;
+}
+
+maths::bounding_box Mesh::bounds()
+{
+	maths::bounding_box box;
+	for (int primitiveIndex = 0; primitiveIndex < primitives.size(); primitiveIndex++)
 	{
-		glDrawElements(GL_POINTS, vertices.size(), GL_UNSIGNED_INT, 0);
+		box.add(primitives[primitiveIndex]->bounds);
 	}
+	return box;
 }
\ No newline at end of file
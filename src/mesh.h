@@ -2,6 +2,7 @@
 #define STERLING_MESH_H
 
 #include "maths.h"
+#include "geometry.h"
 #include <vector>
 
 struct Vertex
@@ -26,6 +27,18 @@ public:
 	}
 };
 
+/// <summary>
+/// A Vertex in half the space. The position is stored as 16 bit fractions of the primitive's bounds (the fourth is padding),
+/// the normal octahedral encoded as two 16 bit signed fractions and the texture coordinates as half floats.
+/// </summary>
+struct PackedVertex
+{
+public:
+	unsigned short position[4];
+	short normal[2];
+	unsigned short textureCoords[2];
+};
+
 struct Edge
 {
 public:
@@ -67,25 +80,141 @@ public:
 	}
 };
 
+/// <summary>
+/// What the shaders read per instance: the model matrix (column-major) and the index of the material to draw with
+/// </summary>
+struct InstanceData
+{
+public:
+	maths::mat4f model;
+	unsigned int materialIndex;
+	unsigned int padding[3];
+};
+
 class MeshPrimitive
 {
 private:
-	unsigned int VAO;
+	/// <summary>
+	/// The shared buffer holding the primitive's vertices and indices, and where in it they are
+	/// </summary>
+	GeometryBuffer* geometry;
+	GeometryRange range;
 public:
 	std::vector<Vertex> vertices;
 	std::vector<Edge> edges;
 	std::vector<Face> faces;
 	unsigned int materialIndex;
+	/// <summary>
+	/// Local space bounds of the vertices, computed by setup()
+	/// </summary>
+	maths::bounding_box bounds;
+	maths::bounding_sphere boundingSphere;
+	/// <summary>
+	/// Where setup() placed the primitive in the geometry buffer, and how to draw it
+	/// </summary>
+	VertexFormat format;
+	/// <summary>
+	/// Takes the stored vertex positions to local space: the identity, or the dequantisation for packed vertices.
+	/// Applied to each instance's model matrix so the shader needs no extra work.
+	/// </summary>
+	maths::mat4f vertexTransform;
+	unsigned int mode;
+	unsigned int baseVertex;
+	unsigned int firstIndex;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	/// <summary>
+	/// GL_UNSIGNED_SHORT if the primitive has few enough vertices, otherwise GL_UNSIGNED_INT. firstIndex counts in this type.
+	/// </summary>
+	unsigned int indexType;
+
+	/// <summary>
+	/// The average cache miss ratio of the faces before and after optimise(), 0 if it hasn't been run
+	/// </summary>
+	float acmrBefore;
+	float acmrAfter;
 
 	MeshPrimitive();
-	void setup();
-	void draw();
+	/// <summary>
+	/// Release the primitive's space in the geometry buffer
+	/// </summary>
+	~MeshPrimitive();
+	/// <summary>
+	/// Reorder the faces for the post-transform vertex cache and for less overdraw, then reorder the vertices
+	/// into the order the faces use them. Call before setup().
+	/// </summary>
+	void optimise();
+	/// <summary>
+	/// Compute the bounds and upload the vertices and indices to the GPU in the primitive's vertex format, replacing any earlier upload
+	/// </summary>
+	/// <param name="geometry">The scene's geometry buffer, to place the vertices and indices in</param>
+	void setup(GeometryBuffer* geometry);
+	/// <summary>
+	/// The first half of setup(): compute the bounds, draw mode, counts and index type, and lay the vertices and indices
+	/// out exactly as the GPU reads them
+	/// </summary>
+	/// <param name="vertexData">Filled with the vertices in the primitive's vertex format</param>
+	/// <param name="indexData">Filled with the indices in the primitive's index type</param>
+	void build(std::vector<unsigned char>* vertexData, std::vector<unsigned char>* indexData);
+	/// <summary>
+	/// The second half of setup(): place vertices and indices laid out by build() in the geometry buffer.
+	/// The counts, format and index type must already be set, by build() or from a cooked mesh.
+	/// </summary>
+	/// <param name="geometry">The scene's geometry buffer</param>
+	/// <param name="vertexData">vertexCount vertices in the primitive's vertex format</param>
+	/// <param name="indexData">indexCount indices of the primitive's index type</param>
+	void upload(GeometryBuffer* geometry, const void* vertexData, const void* indexData);
+	/// <summary>
+	/// The size of one index in bytes
+	/// </summary>
+	unsigned int index_size();
+	/// <summary>
+	/// The vertex array object holding the primitive's vertex layout
+	/// </summary>
+	unsigned int vertex_array();
+	/// <summary>
+	/// Bind the primitive's vertex array, reading each copy's model matrix and material from an instance buffer
+	/// </summary>
+	/// <param name="buffer">The buffer holding the InstanceData of each copy</param>
+	void bind(unsigned int buffer);
+	/// <summary>
+	/// Draw several copies of the primitive. The primitive must already be bound.
+	/// </summary>
+	/// <param name="instanceCount">How many copies to draw</param>
+	/// <param name="baseInstance">The index of the first InstanceData to use</param>
+	void draw_instanced(unsigned int instanceCount, unsigned int baseInstance);
+	/// <summary>
+	/// Cut the faces into new primitives with at most a given number of vertices each, keeping the face order.
+	/// The primitive itself is left unchanged.
+	/// </summary>
+	/// <param name="maximumVertices">The most vertices a piece may have</param>
+	/// <returns>The pieces, owned by the caller and not yet set up</returns>
+	std::vector<MeshPrimitive*> split(unsigned int maximumVertices);
+	/// <summary>
+	/// The model matrix to give the shaders for a copy of the primitive
+	/// </summary>
+	/// <param name="worldMatrix">The local space -> world space matrix of the copy</param>
+	maths::mat4f model_matrix(maths::mat4f worldMatrix);
 };
 
 class Mesh
 {
 public:
 	std::vector<MeshPrimitive*> primitives;
+
+	/// <summary>
+	/// Delete the mesh's primitives, freeing their geometry
+	/// </summary>
+	~Mesh();
+	/// <summary>
+	/// Replace every triangle primitive with more than a given number of vertices by pieces that each fit,
+	/// e.g. 65536 so that every primitive can use 16 bit indices. Call before the primitives are set up.
+	/// </summary>
+	void split_large_primitives(unsigned int maximumVertices);
+	/// <summary>
+	/// The local space box around every primitive of the mesh
+	/// </summary>
+	maths::bounding_box bounds();
 };
 
 #endif
\ No newline at end of file
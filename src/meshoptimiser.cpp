@@ -0,0 +1,331 @@
+#include "meshoptimiser.h"
+
+#include "mesh.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// the scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+/// <summary>
+/// How much Forsyth's algorithm wants to use a vertex next: high if it is near the front of the cache,
+/// plus a boost for vertices with few triangles left so they get finished off instead of left stranded
+/// </summary>
+/// <param name="cachePosition">Where the vertex is in the cache, -1 if it isn't</param>
+/// <param name="remainingTriangles">How many triangles that use the vertex are still to be emitted</param>
+static float vertex_score(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// the vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse its edge
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+float meshoptimiser::acmr(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	if (indexCount < 3)
+	{
+		return 0.0f;
+	}
+	// a FIFO cache, each vertex remembering when it was added so it can tell if it has been pushed out since
+	std::vector<unsigned int> addedAt(vertexCount, 0);
+	unsigned int misses = 0;
+	for (unsigned int index = 0; index < indexCount; index++)
+	{
+		unsigned int vertex = indices[index];
+		if (addedAt[vertex] == 0 || misses - addedAt[vertex] + 1 > cacheSize)
+		{
+			misses++;
+			addedAt[vertex] = misses;
+		}
+	}
+	return (float)misses / (indexCount / 3);
+}
+
+void meshoptimiser::optimise_vertex_cache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// the triangles using each vertex, with the ones not yet emitted at the front of each vertex's list
+	std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+	for (unsigned int index = 0; index < indexCount; index++)
+	{
+		remainingTriangles[indices[index]]++;
+	}
+	std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+	for (unsigned int vertex = 0; vertex < vertexCount; vertex++)
+	{
+		adjacencyStart[vertex + 1] = adjacencyStart[vertex] + remainingTriangles[vertex];
+	}
+	std::vector<unsigned int> adjacency(indexCount);
+	std::vector<unsigned int> adjacencyFill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned int index = 0; index < indexCount; index++)
+	{
+		adjacency[adjacencyFill[indices[index]]++] = index / 3;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (unsigned int vertex = 0; vertex < vertexCount; vertex++)
+	{
+		vertexScores[vertex] = vertex_score(-1, remainingTriangles[vertex]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	unsigned int bestTriangle = 0;
+	for (unsigned int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+		if (triangleScores[triangle] > triangleScores[bestTriangle])
+		{
+			bestTriangle = triangle;
+		}
+	}
+
+	std::vector<unsigned int> output(indexCount);
+	// the cache, with room for the three vertices pushed in past the end before they are dropped
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int scanPosition = 0;
+
+	for (unsigned int outputTriangle = 0; outputTriangle < triangleCount; outputTriangle++)
+	{
+		// emit the best triangle, taking it out of its vertices' lists of remaining triangles
+		emitted[bestTriangle] = 1;
+		unsigned int* triangleVertices = &indices[bestTriangle * 3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = triangleVertices[corner];
+			output[outputTriangle * 3 + corner] = vertex;
+			unsigned int* list = &adjacency[adjacencyStart[vertex]];
+			unsigned int last = remainingTriangles[vertex] - 1;
+			for (unsigned int entry = 0; entry <= last; entry++)
+			{
+				if (list[entry] == bestTriangle)
+				{
+					list[entry] = list[last];
+					list[last] = bestTriangle;
+					entry = last;
+				}
+			}
+			remainingTriangles[vertex]--;
+		}
+
+		// move the triangle's vertices to the front of the cache
+		unsigned int newCacheCount = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			// degenerate triangles repeat a vertex, which only needs one entry
+			if (corner == 0 || (triangleVertices[corner] != newCache[newCacheCount - 1] && triangleVertices[corner] != newCache[0]))
+			{
+				newCache[newCacheCount++] = triangleVertices[corner];
+			}
+		}
+		for (unsigned int entry = 0; entry < cacheCount; entry++)
+		{
+			unsigned int vertex = cache[entry];
+			if (vertex != triangleVertices[0] && vertex != triangleVertices[1] && vertex != triangleVertices[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+
+		// rescore everything in the cache and the triangles around it, finding the next best triangle on the way
+		float bestScore = -1.0f;
+		for (unsigned int entry = 0; entry < newCacheCount; entry++)
+		{
+			unsigned int vertex = newCache[entry];
+			int position = entry < FORSYTH_CACHE_SIZE ? (int)entry : -1;
+			cachePosition[vertex] = position;
+			float scoreChange = vertex_score(position, remainingTriangles[vertex]) - vertexScores[vertex];
+			vertexScores[vertex] += scoreChange;
+			for (unsigned int entryTriangle = 0; entryTriangle < remainingTriangles[vertex]; entryTriangle++)
+			{
+				unsigned int triangle = adjacency[adjacencyStart[vertex] + entryTriangle];
+				triangleScores[triangle] += scoreChange;
+				if (triangleScores[triangle] > bestScore)
+				{
+					bestScore = triangleScores[triangle];
+					bestTriangle = triangle;
+				}
+			}
+		}
+		cacheCount = newCacheCount < FORSYTH_CACHE_SIZE ? newCacheCount : FORSYTH_CACHE_SIZE;
+		for (unsigned int entry = 0; entry < cacheCount; entry++)
+		{
+			cache[entry] = newCache[entry];
+		}
+
+		if (bestScore < 0.0f && outputTriangle + 1 < triangleCount)
+		{
+			// nothing in the cache has triangles left, so start again from the next triangle not yet emitted
+			while (emitted[scanPosition])
+			{
+				scanPosition++;
+			}
+			bestTriangle = scanPosition;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void meshoptimiser::optimise_overdraw(unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount, float threshold)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+	float originalAcmr = acmr(indices, indexCount, vertexCount, CACHE_SIZE);
+
+	// split the triangles into clusters wherever the cache order had to start afresh (all three vertices missed)
+	std::vector<unsigned int> clusterStarts;
+	std::vector<unsigned int> addedAt(vertexCount, 0);
+	unsigned int misses = 0;
+	for (unsigned int triangle = 0; triangle < triangleCount; triangle++)
+	{
+		unsigned int triangleMisses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = indices[triangle * 3 + corner];
+			if (addedAt[vertex] == 0 || misses - addedAt[vertex] + 1 > CACHE_SIZE)
+			{
+				misses++;
+				addedAt[vertex] = misses;
+				triangleMisses++;
+			}
+		}
+		if (triangleMisses == 3)
+		{
+			clusterStarts.push_back(triangle);
+		}
+	}
+	if (clusterStarts.size() < 2)
+	{
+		return;
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// the area weighted centre and normal of the mesh and of each cluster
+	unsigned int clusterCount = clusterStarts.size() - 1;
+	std::vector<float> clusterCentres(clusterCount * 3, 0.0f);
+	std::vector<float> clusterNormals(clusterCount * 3, 0.0f);
+	float meshCentre[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (unsigned int cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float clusterArea = 0.0f;
+		for (unsigned int triangle = clusterStarts[cluster]; triangle < clusterStarts[cluster + 1]; triangle++)
+		{
+			const maths::vec3f* a = &vertices[indices[triangle * 3]].position;
+			const maths::vec3f* b = &vertices[indices[triangle * 3 + 1]].position;
+			const maths::vec3f* c = &vertices[indices[triangle * 3 + 2]].position;
+			float edge1[3] = { b->x - a->x, b->y - a->y, b->z - a->z };
+			float edge2[3] = { c->x - a->x, c->y - a->y, c->z - a->z };
+			// the cross product's length is twice the area, so it is already area weighted
+			float normal[3] = {
+				edge1[1] * edge2[2] - edge1[2] * edge2[1],
+				edge1[2] * edge2[0] - edge1[0] * edge2[2],
+				edge1[0] * edge2[1] - edge1[1] * edge2[0]
+			};
+			float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float centre[3] = { (a->x + b->x + c->x) / 3.0f, (a->y + b->y + c->y) / 3.0f, (a->z + b->z + c->z) / 3.0f };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				clusterCentres[cluster * 3 + axis] += centre[axis] * area;
+				clusterNormals[cluster * 3 + axis] += normal[axis];
+				meshCentre[axis] += centre[axis] * area;
+			}
+			clusterArea += area;
+		}
+		meshArea += clusterArea;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			clusterCentres[cluster * 3 + axis] /= clusterArea > 0.0f ? clusterArea : 1.0f;
+		}
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		meshCentre[axis] /= meshArea > 0.0f ? meshArea : 1.0f;
+	}
+
+	// clusters facing away from the centre are likely to occlude the rest, so they go first
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<unsigned int> order(clusterCount);
+	for (unsigned int cluster = 0; cluster < clusterCount; cluster++)
+	{
+		float* normal = &clusterNormals[cluster * 3];
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			key += (clusterCentres[cluster * 3 + axis] - meshCentre[axis]) * normal[axis];
+		}
+		sortKeys[cluster] = length > 0.0f ? key / length : 0.0f;
+		order[cluster] = cluster;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](unsigned int first, unsigned int second)
+		{
+			return sortKeys[first] > sortKeys[second];
+		});
+
+	std::vector<unsigned int> output;
+	output.reserve(indexCount);
+	for (unsigned int orderIndex = 0; orderIndex < clusterCount; orderIndex++)
+	{
+		unsigned int cluster = order[orderIndex];
+		output.insert(output.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+	}
+	// each cluster starts cold anyway, so this rarely costs anything, but keep the cache order if it does
+	if (acmr(&output[0], indexCount, vertexCount, CACHE_SIZE) <= originalAcmr * threshold)
+	{
+		std::copy(output.begin(), output.end(), indices);
+	}
+}
+
+unsigned int meshoptimiser::optimise_vertex_fetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+	const unsigned int unused = 0xffffffff;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+	for (unsigned int index = 0; index < indexCount; index++)
+	{
+		unsigned int vertex = indices[index];
+		if (remap[vertex] == unused)
+		{
+			remap[vertex] = reordered.size();
+			reordered.push_back(vertices[vertex]);
+		}
+		indices[index] = remap[vertex];
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices);
+	return reordered.size();
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef STERLING_MESHOPTIMISER_H
+#define STERLING_MESHOPTIMISER_H
+
+struct Vertex;
+
+/// <summary>
+/// Reorders triangle lists so the GPU shades fewer vertices and fragments. Run in this order: vertex cache, overdraw,
+/// then vertex fetch, since each stage keeps the work of the ones before it.
+/// </summary>
+namespace meshoptimiser
+{
+	/// <summary>
+	/// The size of the FIFO cache the ACMR statistics are simulated with
+	/// </summary>
+	const unsigned int CACHE_SIZE = 16;
+
+	/// <summary>
+	/// The average cache miss ratio: vertex shader invocations per triangle with a FIFO post-transform cache.
+	/// 3 is the worst case, around 0.6 to 0.7 is typical for a well ordered regular mesh.
+	/// </summary>
+	/// <param name="indices">The triangle list</param>
+	/// <param name="indexCount">The number of indices, a multiple of 3</param>
+	/// <param name="vertexCount">The number of vertices the indices refer to</param>
+	/// <param name="cacheSize">The number of entries in the simulated cache</param>
+	float acmr(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize);
+	/// <summary>
+	/// Reorder triangles to reuse recently transformed vertices, using Tom Forsyth's linear-speed vertex cache optimisation
+	/// </summary>
+	/// <param name="indices">The triangle list, reordered in place</param>
+	/// <param name="indexCount">The number of indices, a multiple of 3</param>
+	/// <param name="vertexCount">The number of vertices the indices refer to</param>
+	void optimise_vertex_cache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+	/// <summary>
+	/// Reorder runs of cache-ordered triangles so that outward facing runs are drawn first and hide the rest,
+	/// as in Sander et al.'s fast triangle reordering. The order is kept unless the vertex cache efficiency stays within a threshold.
+	/// </summary>
+	/// <param name="indices">The triangle list, already in vertex cache order, reordered in place</param>
+	/// <param name="indexCount">The number of indices, a multiple of 3</param>
+	/// <param name="vertices">The vertices the indices refer to</param>
+	/// <param name="vertexCount">The number of vertices</param>
+	/// <param name="threshold">How much worse the ACMR may get, 1.05 allows 5%</param>
+	void optimise_overdraw(unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount, float threshold);
+	/// <summary>
+	/// Reorder vertices into the order the indices first use them, so vertex fetches walk memory forwards.
+	/// Vertices no triangle uses are dropped.
+	/// </summary>
+	/// <param name="vertices">The vertices, reordered in place</param>
+	/// <param name="vertexCount">The number of vertices</param>
+	/// <param name="indices">The indices, rewritten for the new order</param>
+	/// <param name="indexCount">The number of indices</param>
+	/// <returns>The number of vertices kept</returns>
+	unsigned int optimise_vertex_fetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+}
+
+#endif
\ No newline at end of file
@@ -30,19 +30,7 @@ maths::mat4f Transformation::transformationMatrix()
 	{
 		isDirty = false;
 		_changedOnLastAccess = true;
-		maths::mat4f translationMatrix = maths::mat4f(
-			1, 0, 0, _position.x,
-			0, 1, 0, _position.y,
-			0, 0, 1, _position.z,
-			0, 0, 0, 1
-		);
-		maths::mat4f scaleMatrix = maths::mat4f(
-			_scale.x, 0, 0, 0,
-			0, _scale.y, 0, 0,
-			0, 0, _scale.z, 0,
-			0, 0, 0, 1
-		);
-		_transformationMatrix = translationMatrix * _rotation.to_rotation_matrix() * scaleMatrix;
+		_transformationMatrix = maths::compose_transformation(_position, _rotation, _scale);
 	}
 	else
 	{
@@ -51,6 +39,18 @@ maths::mat4f Transformation::transformationMatrix()
 	return _transformationMatrix;
 }
 
+bool Transformation::matrixDirty()
+{
+	return isDirty;
+}
+
+void Transformation::transformationMatrix(maths::mat4f matrix)
+{
+	_transformationMatrix = matrix;
+	isDirty = false;
+	_changedOnLastAccess = true;
+}
+
 maths::mat4f Transformation::inverseMatrixNoScale()
 {
 	if (isInverseNoScaleDirty)
@@ -150,15 +150,19 @@ Object::Object(Scene* scene, const char* name)
 	hasMesh = false;
 	mesh = 0;
 	objectName = name;
+	hierarchyIndex = -1;
+	bvhProxy = -1;
 }
 
 Object::Object(const char* filepath, Scene* scene, const char* name)
 {
 	this->scene = scene;
-	mesh = scene->load_mesh(filepath);
+	mesh = scene->load_mesh_async(filepath);
 	parent = NULL;
 	hasMesh = true;
 	objectName = name;
+	hierarchyIndex = -1;
+	bvhProxy = -1;
 }
 
 Object::~Object()
@@ -188,6 +192,11 @@ Object::~Object()
 		parentsList->push_back(children[childIndex]);
 		children[childIndex]->parent = parent;
 	}
+	if (bvhProxy != -1)
+	{
+		scene->bvh.destroy_proxy(bvhProxy);
+	}
+	scene->hierarchy_changed();
 }
 
 void Object::add_child(Object* child)
@@ -195,6 +204,7 @@ void Object::add_child(Object* child)
 	children.push_back(child);
 	child->parent = this;
 	child->scene = scene;
+	scene->hierarchy_changed();
 }
 
 void Object::remove_from_parent()
@@ -219,33 +229,23 @@ void Object::remove_from_parent()
 		}
 	}
 	parent = NULL;
+	scene->hierarchy_changed();
 }
 
 maths::mat4f Object::get_global_matrix()
 {
+	if (hierarchyIndex >= 0 && scene->hierarchy_current())
+	{
+		return scene->world_matrix(hierarchyIndex);
+	}
+	// not in the flattened hierarchy yet, combine the parent matrices directly
 	if (parent == NULL)
 	{
 		return transformation.transformationMatrix();
 	}
 	else
 	{
-		return parent->transformation.transformationMatrix() * transformation.transformationMatrix();
-	}
-}
-
-void Object::render()
-{
-	if (hasMesh)
-	{
-		for (int primitiveIndex = 0; primitiveIndex < scene->meshes[mesh]->primitives.size(); primitiveIndex++)
-		{
-			scene->materials[scene->meshes[mesh]->primitives[primitiveIndex]->materialIndex]->use(get_global_matrix());
-			scene->meshes[mesh]->primitives[primitiveIndex]->draw();
-		}
-	}
-	for (int childIndex = 0; childIndex < children.size(); childIndex++)
-	{
-		children[childIndex]->render();
+		return parent->get_global_matrix() * transformation.transformationMatrix();
 	}
 }
 
@@ -364,6 +364,17 @@ maths::mat4f Camera::view_matrix()
 	return view;
 }
 
+void Camera::screen_ray(float x, float y, maths::vec3f* origin, maths::vec3f* direction)
+{
+	// undo the projection's scaling of x and y at a view space depth of 1. View space z points the opposite way to the camera's local z.
+	maths::mat4f projection = projection_matrix();
+	maths::vec4f localDirection = maths::vec4f(x / projection.m11, y / projection.m22, -1.0f, 0.0f);
+	maths::mat4f cameraToWorld = get_global_matrix();
+	maths::vec4f worldDirection = cameraToWorld * localDirection;
+	*origin = maths::vec3f(cameraToWorld.m14, cameraToWorld.m24, cameraToWorld.m34);
+	*direction = maths::vec3f::normalise(maths::vec3f(worldDirection.x, worldDirection.y, worldDirection.z));
+}
+
 Light::Light(Scene* scene, const char* name) : Object(scene, name)
 {
 	_colour = maths::vec3f(1.0f, 1.0f, 1.0f);
@@ -29,6 +29,16 @@ public:
 	maths::mat4f inverseMatrixNoScale();
 	bool changedOnLastAccess();
 
+	/// <summary>
+	/// Whether the position, rotation or scale has changed since the matrix was last built
+	/// </summary>
+	bool matrixDirty();
+	/// <summary>
+	/// Store a matrix that was built elsewhere (by a batch update) for the current position, rotation and scale
+	/// </summary>
+	/// <param name="matrix">translation * rotation * scale for this transformation</param>
+	void transformationMatrix(maths::mat4f matrix);
+
 	maths::vec3f position();
 	void position(maths::vec3f newPosition);
 
@@ -73,6 +83,14 @@ public:
 	/// </summary>
 	Scene* scene;
 	const char* objectName;
+	/// <summary>
+	/// Position of this object in the scene's flattened hierarchy, -1 if it has not been placed yet
+	/// </summary>
+	int hierarchyIndex;
+	/// <summary>
+	/// The object's proxy in the scene's bounding volume hierarchy, -1 if it isn't in it
+	/// </summary>
+	int bvhProxy;
 
 	/// <summary>
 	/// Create a new object with no mesh
@@ -80,7 +98,7 @@ public:
 	/// <param name="scene">The scene to add the object to</param>
 	Object(Scene* scene, const char* name);
 	/// <summary>
-	/// Create a new object
+	/// Create a new object. Its mesh is loaded in the background, and the object draws nothing until the mesh is ready.
 	/// </summary>
 	/// <param name="filepath">The filepath to the mesh for this object to have</param>
 	/// <param name="scene">The scene to add the object to</param>
@@ -101,13 +119,10 @@ public:
 	void remove_from_parent();
 	/// <summary>
 	/// Get the matrix to transform local space to absolute world space. Combines the matrices of all parent objects.
+	/// Returns the matrix cached by the scene's last transformation update when the object is part of the flattened hierarchy.
 	/// </summary>
 	/// <returns></returns>
 	maths::mat4f get_global_matrix();
-	/// <summary>
-	/// Render the object
-	/// </summary>
-	void render();
 };
 
 class Camera : public Object
@@ -150,6 +165,14 @@ public:
 	/// </summary>
 	/// <returns>The matrix</returns>
 	maths::mat4f view_matrix();
+	/// <summary>
+	/// The world space ray through a point on the screen
+	/// </summary>
+	/// <param name="x">The point's x coordinate, -1 at the left of the screen and 1 at the right</param>
+	/// <param name="y">The point's y coordinate, -1 at the bottom of the screen and 1 at the top</param>
+	/// <param name="origin">Set to the camera's position</param>
+	/// <param name="direction">Set to the normalised direction of the ray</param>
+	void screen_ray(float x, float y, maths::vec3f* origin, maths::vec3f* direction);
 };
 
 class Light : public Object
@@ -0,0 +1,354 @@
+#include "objectfile.h"
+
+#include <fstream>
+#include <iostream>
+#include <string.h>
+#include "mappedfile.h"
+
+/// <summary>
+/// Where one primitive's parts are in a mapped file, found before anything is built
+/// </summary>
+struct ObjectPrimitiveLayout
+{
+	unsigned int materialIndex;
+	unsigned char renderingMode;
+	unsigned int vertexCount;
+	unsigned int vertexNormalCount;
+	unsigned int texCoordCount;
+	unsigned int edgeFaceCount;
+	size_t positions;
+	size_t normals;
+	size_t texCoords;
+	size_t indices;
+};
+
+/// <summary>
+/// Read a 4 byte field, which may not be aligned as the rendering mode is a single byte
+/// </summary>
+static unsigned int read_uint(const unsigned char* data)
+{
+	unsigned int value;
+	memcpy(&value, data, 4);
+	return value;
+}
+
+bool objectfile::read_stream(const char* path, Mesh* mesh)
+{
+	// create buffers to hold vertex position, normal and texture coordinate data
+	std::vector<maths::vec3f> vertexPositions;
+	std::vector<maths::vec3f> vertexNormals;
+	std::vector<maths::vec2f> texCoords;
+
+	// retrieve the objMesh data from filePath
+	std::ifstream meshFile;
+	// ensure ifstream objects can throw exceptions
+	meshFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		// open file
+		meshFile.open(path, std::ios::binary);
+
+		// get length
+		meshFile.seekg(0, std::ios::end);
+		std::streamsize fileSize = meshFile.tellg();
+		meshFile.seekg(0, std::ios::beg);
+
+		// read format
+		char* format = new char[4];
+		meshFile.read(format, 4);
+
+		// read material file name length
+		unsigned int materialFileNameLength;
+		meshFile.read((char*)&materialFileNameLength, 4);
+
+		// read material file name
+		char* materialFileName = (char*)malloc(materialFileNameLength + 1);
+		if (materialFileName == NULL)
+		{
+			std::cerr << "ERROR::MESH::OUT_OF_MEMORY\n";
+			return false;
+		}
+		materialFileName[materialFileNameLength] = '\0';
+		meshFile.read(materialFileName, materialFileNameLength);
+		free(materialFileName);
+
+		// read primitive count
+		unsigned int primitiveCount;
+		meshFile.read((char*)&primitiveCount, 4);
+
+		for (unsigned int primitiveIndex = 0; primitiveIndex < primitiveCount; primitiveIndex++)
+		{
+			MeshPrimitive* primitive = new MeshPrimitive();
+			mesh->primitives.push_back(primitive);
+
+			// read material index
+			unsigned int materialIndex;
+			meshFile.read((char*)&materialIndex, 4);
+			primitive->materialIndex = materialIndex;
+
+			// read rendering mode
+			char renderingMode;
+			meshFile.read((char*)&renderingMode, 1);
+
+			// read vertex count
+			unsigned int vertexCount;
+			meshFile.read((char*)&vertexCount, 4);
+
+			// read vertex normal count
+			unsigned int vertexNormalCount;
+			meshFile.read((char*)&vertexNormalCount, 4);
+
+			// read texture coordinate count
+			unsigned int texCoordCount;
+			meshFile.read((char*)&texCoordCount, 4);
+
+			// read texture coordinate count
+			unsigned int edgeFaceCount;
+			meshFile.read((char*)&edgeFaceCount, 4);
+
+			// read vertex data
+			for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
+			{
+				maths::vec3f position;
+				meshFile.read((char*)&position, 12);
+				vertexPositions.push_back(position);
+			}
+
+			// read vertex normal data
+			for (unsigned int vertexNormalIndex = 0; vertexNormalIndex < vertexNormalCount; vertexNormalIndex++)
+			{
+				maths::vec3f normal;
+				meshFile.read((char*)&normal, 12);
+				vertexNormals.push_back(normal);
+			}
+
+			// read texture coordinate data
+			for (unsigned int texCoordIndex = 0; texCoordIndex < texCoordCount; texCoordIndex++)
+			{
+				maths::vec2f texCoord;
+				meshFile.read((char*)&texCoord, 8);
+				texCoords.push_back(texCoord);
+			}
+			
+			// read edge/face data
+			if (renderingMode == 0x00) // points
+			{
+				for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
+				{
+					primitive->vertices.push_back(Vertex(vertexPositions[vertexIndex], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
+				}
+			}
+			else if (renderingMode == 0x01) // edge
+			{
+				for (unsigned int edgeIndex = 0; edgeIndex < edgeFaceCount; edgeIndex++)
+				{
+					// read edge index 1
+					unsigned int edgeIndex1;
+					meshFile.read((char*)&edgeIndex1, 4);
+					unsigned int realEdgeIndex1 = primitive->vertices.size();
+					primitive->vertices.push_back(Vertex(vertexPositions[edgeIndex1], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
+
+					// read edge index 2
+					unsigned int edgeIndex2;
+					meshFile.read((char*)&edgeIndex2, 4);
+					unsigned int realEdgeIndex2 = primitive->vertices.size();
+					primitive->vertices.push_back(Vertex(vertexPositions[edgeIndex2], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
+
+					// add the edges to the edge list
+					primitive->edges.push_back(Edge(realEdgeIndex1, realEdgeIndex2));
+				}
+			}
+			else if (renderingMode == 0x02) // face
+			{
+				for (unsigned int faceIndex = 0; faceIndex < edgeFaceCount; faceIndex++)
+				{
+					// read face index 1
+					unsigned int positionIndex1;
+					unsigned int normalIndex1;
+					unsigned int texCoordIndex1;
+					meshFile.read((char*)&positionIndex1, 4);
+					meshFile.read((char*)&normalIndex1, 4);
+					meshFile.read((char*)&texCoordIndex1, 4);
+					unsigned int faceIndex1 = primitive->vertices.size();
+					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex1], vertexNormals[normalIndex1], texCoords[texCoordIndex1]));
+
+					// read face index 2
+					unsigned int positionIndex2;
+					unsigned int normalIndex2;
+					unsigned int texCoordIndex2;
+					meshFile.read((char*)&positionIndex2, 4);
+					meshFile.read((char*)&normalIndex2, 4);
+					meshFile.read((char*)&texCoordIndex2, 4);
+					unsigned int faceIndex2 = primitive->vertices.size();
+					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex2], vertexNormals[normalIndex2], texCoords[texCoordIndex2]));
+
+					// read face index 3
+					unsigned int positionIndex3;
+					unsigned int normalIndex3;
+					unsigned int texCoordIndex3;
+					meshFile.read((char*)&positionIndex3, 4);
+					meshFile.read((char*)&normalIndex3, 4);
+					meshFile.read((char*)&texCoordIndex3, 4);
+					unsigned int faceIndex3 = primitive->vertices.size();
+					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex3], vertexNormals[normalIndex3], texCoords[texCoordIndex3]));
+
+					// add the face to the face list
+					primitive->faces.push_back(Face(faceIndex1, faceIndex2, faceIndex3));
+				}
+			}
+		}
+		delete[] format;
+	}
+	catch (std::ifstream::failure e)
+	{
+		std::cerr << "ERROR::MESH::CANNOT_READ_FILE\n" << e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool objectfile::read_mapped(const char* path, Mesh* mesh)
+{
+	MappedFile file;
+	if (!file.open(path))
+	{
+		std::cerr << "ERROR::MESH::CANNOT_READ_FILE\n" << path << std::endl;
+		return false;
+	}
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+
+	// find every primitive's parts, checking each count against what is left of the file. The sizes are
+	// worked out in 64 bits so huge counts in a corrupt file can't wrap around.
+	std::vector<ObjectPrimitiveLayout> layouts;
+	bool intact = size >= 8;
+	size_t offset = 4;
+	if (intact)
+	{
+		// skip the format tag and material file name
+		unsigned long long materialFileNameLength = read_uint(data + offset);
+		intact = offset + 4 + materialFileNameLength + 4 <= size;
+		offset += 4 + materialFileNameLength;
+	}
+	unsigned int primitiveCount = 0;
+	if (intact)
+	{
+		primitiveCount = read_uint(data + offset);
+		offset += 4;
+	}
+	for (unsigned int primitiveIndex = 0; primitiveIndex < primitiveCount && intact; primitiveIndex++)
+	{
+		ObjectPrimitiveLayout layout;
+		intact = offset + 21 <= size;
+		if (intact)
+		{
+			layout.materialIndex = read_uint(data + offset);
+			layout.renderingMode = data[offset + 4];
+			layout.vertexCount = read_uint(data + offset + 5);
+			layout.vertexNormalCount = read_uint(data + offset + 9);
+			layout.texCoordCount = read_uint(data + offset + 13);
+			layout.edgeFaceCount = read_uint(data + offset + 17);
+			offset += 21;
+
+			unsigned long long indexBytes = 0;
+			if (layout.renderingMode == 0x01)
+			{
+				indexBytes = (unsigned long long)layout.edgeFaceCount * 8;
+			}
+			else if (layout.renderingMode == 0x02)
+			{
+				indexBytes = (unsigned long long)layout.edgeFaceCount * 36;
+			}
+			unsigned long long primitiveBytes = (unsigned long long)layout.vertexCount * 12 + (unsigned long long)layout.vertexNormalCount * 12 +
+				(unsigned long long)layout.texCoordCount * 8 + indexBytes;
+			intact = primitiveBytes <= size - offset;
+			layout.positions = offset;
+			layout.normals = layout.positions + (size_t)layout.vertexCount * 12;
+			layout.texCoords = layout.normals + (size_t)layout.vertexNormalCount * 12;
+			layout.indices = layout.texCoords + (size_t)layout.texCoordCount * 8;
+			offset += (size_t)primitiveBytes;
+			layouts.push_back(layout);
+		}
+	}
+	if (!intact)
+	{
+		std::cerr << "ERROR::MESH::FILE_CORRUPT\n" << path << std::endl;
+		return false;
+	}
+
+	// the attributes of every primitive so far, as indices count across primitives
+	std::vector<maths::vec3f> vertexPositions;
+	std::vector<maths::vec3f> vertexNormals;
+	std::vector<maths::vec2f> texCoords;
+	for (unsigned int primitiveIndex = 0; primitiveIndex < layouts.size() && intact; primitiveIndex++)
+	{
+		const ObjectPrimitiveLayout* layout = &layouts[primitiveIndex];
+		MeshPrimitive* primitive = new MeshPrimitive();
+		mesh->primitives.push_back(primitive);
+		primitive->materialIndex = layout->materialIndex;
+
+		// one copy per attribute block instead of one read per element
+		size_t positionCount = vertexPositions.size();
+		size_t normalCount = vertexNormals.size();
+		size_t texCoordCount = texCoords.size();
+		vertexPositions.resize(positionCount + layout->vertexCount);
+		vertexNormals.resize(normalCount + layout->vertexNormalCount);
+		texCoords.resize(texCoordCount + layout->texCoordCount);
+		memcpy(vertexPositions.data() + positionCount, data + layout->positions, (size_t)layout->vertexCount * 12);
+		memcpy(vertexNormals.data() + normalCount, data + layout->normals, (size_t)layout->vertexNormalCount * 12);
+		memcpy(texCoords.data() + texCoordCount, data + layout->texCoords, (size_t)layout->texCoordCount * 8);
+
+		const unsigned char* indices = data + layout->indices;
+		if (layout->renderingMode == 0x00) // points
+		{
+			primitive->vertices.resize(layout->vertexCount);
+			for (unsigned int vertexIndex = 0; vertexIndex < layout->vertexCount; vertexIndex++)
+			{
+				primitive->vertices[vertexIndex] = Vertex(vertexPositions[vertexIndex], maths::vec3f(0, 0, 0), maths::vec2f(0, 0));
+			}
+		}
+		else if (layout->renderingMode == 0x01) // edge
+		{
+			primitive->vertices.resize((size_t)layout->edgeFaceCount * 2);
+			primitive->edges.resize(layout->edgeFaceCount);
+			for (unsigned int edgeIndex = 0; edgeIndex < layout->edgeFaceCount && intact; edgeIndex++)
+			{
+				unsigned int positionIndex1 = read_uint(indices + (size_t)edgeIndex * 8);
+				unsigned int positionIndex2 = read_uint(indices + (size_t)edgeIndex * 8 + 4);
+				intact = positionIndex1 < vertexPositions.size() && positionIndex2 < vertexPositions.size();
+				if (intact)
+				{
+					primitive->vertices[edgeIndex * 2] = Vertex(vertexPositions[positionIndex1], maths::vec3f(0, 0, 0), maths::vec2f(0, 0));
+					primitive->vertices[edgeIndex * 2 + 1] = Vertex(vertexPositions[positionIndex2], maths::vec3f(0, 0, 0), maths::vec2f(0, 0));
+					primitive->edges[edgeIndex] = Edge(edgeIndex * 2, edgeIndex * 2 + 1);
+				}
+			}
+		}
+		else if (layout->renderingMode == 0x02) // face
+		{
+			primitive->vertices.resize((size_t)layout->edgeFaceCount * 3);
+			primitive->faces.resize(layout->edgeFaceCount);
+			for (unsigned int faceIndex = 0; faceIndex < layout->edgeFaceCount && intact; faceIndex++)
+			{
+				const unsigned char* face = indices + (size_t)faceIndex * 36;
+				for (unsigned int corner = 0; corner < 3 && intact; corner++)
+				{
+					unsigned int positionIndex = read_uint(face + corner * 12);
+					unsigned int normalIndex = read_uint(face + corner * 12 + 4);
+					unsigned int texCoordIndex = read_uint(face + corner * 12 + 8);
+					intact = positionIndex < vertexPositions.size() && normalIndex < vertexNormals.size() && texCoordIndex < texCoords.size();
+					if (intact)
+					{
+						primitive->vertices[faceIndex * 3 + corner] = Vertex(vertexPositions[positionIndex], vertexNormals[normalIndex], texCoords[texCoordIndex]);
+					}
+				}
+				primitive->faces[faceIndex] = Face(faceIndex * 3, faceIndex * 3 + 1, faceIndex * 3 + 2);
+			}
+		}
+	}
+	if (!intact)
+	{
+		std::cerr << "ERROR::MESH::FILE_CORRUPT\n" << path << std::endl;
+	}
+	return intact;
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef STERLING_OBJECTFILE_H
+#define STERLING_OBJECTFILE_H
+
+#include "mesh.h"
+
+/// <summary>
+/// Readers for Sterling's own binary mesh format. A file is a 4 byte format tag, the length and name of a material
+/// file, the primitive count, then each primitive: its material index, a 1 byte rendering mode (0 points, 1 edges,
+/// 2 faces), the position, normal, texture coordinate and edge/face counts, the positions, normals and texture
+/// coordinates, then 2 position indices per edge or 3 position/normal/texture coordinate index triples per face.
+/// Indices count from the start of the file, across every primitive read so far.
+/// </summary>
+namespace objectfile
+{
+	/// <summary>
+	/// Read a file with one stream read per field. Kept as the reference the mapped reader is benchmarked against.
+	/// </summary>
+	/// <param name="path">The path of the file to read</param>
+	/// <param name="mesh">The mesh to add the primitives to, which are not set up</param>
+	/// <returns>Whether the file could be read</returns>
+	bool read_stream(const char* path, Mesh* mesh);
+	/// <summary>
+	/// Read a file by mapping it into memory. Every count and offset is checked against the size of the file before
+	/// any primitive is built, then the vertex attributes are copied in bulk and the primitives built straight from the mapping.
+	/// </summary>
+	/// <param name="path">The path of the file to read</param>
+	/// <param name="mesh">The mesh to add the primitives to, which are not set up</param>
+	/// <returns>Whether the file could be read and is intact</returns>
+	bool read_mapped(const char* path, Mesh* mesh);
+}
+
+#endif
\ No newline at end of file
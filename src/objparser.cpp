@@ -0,0 +1,452 @@
+#include "objparser.h"
+
+#include <algorithm>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include "mappedfile.h"
+
+// the material every chunk after the first starts with, standing for whichever material was in use where the chunk begins
+#define CHUNK_START_MATERIAL "sterling_chunk_start"
+#define INHERITED_MATERIAL 0xFFFFFFFF
+
+/// <summary>
+/// A chunk of a mapped .obj, served to fast_obj as if it were a whole file. It is wrapped in two extra lines: a usemtl
+/// of the chunk start material before it, and a face after it whose material is the one in use at the end of the chunk.
+/// With no data, the whole .obj is read from disk instead.
+/// </summary>
+struct ObjChunk
+{
+	std::string prefix;
+	const char* data;
+	size_t size;
+	std::string suffix;
+	/// <summary>
+	/// Whether fast_obj has opened the chunk yet. Every file it opens afterwards is a .mtl, read from disk.
+	/// </summary>
+	bool opened;
+	/// <summary>
+	/// The paths of the .mtl files fast_obj tried to open, whether they exist or not
+	/// </summary>
+	std::vector<std::string> libraries;
+	/// <summary>
+	/// Set if a face in the chunk has a negative index, which counts back from the end of the chunk rather than the file
+	/// </summary>
+	bool relativeIndices;
+	fastObjMesh* mesh;
+};
+
+/// <summary>
+/// A file fast_obj is reading through the chunk callbacks: the chunk itself, or a whole .mtl file
+/// </summary>
+struct ObjStream
+{
+	ObjChunk* chunk;
+	MappedFile file;
+	size_t position;
+	/// <summary>
+	/// Where the scan for negative face indices is up to
+	/// </summary>
+	bool lineStart;
+	bool faceLine;
+	char previous;
+};
+
+static size_t stream_size(ObjStream* stream)
+{
+	if (stream->chunk != NULL)
+	{
+		return stream->chunk->prefix.size() + stream->chunk->size + stream->chunk->suffix.size();
+	}
+	return stream->file.size();
+}
+
+/// <summary>
+/// Look for negative indices in face lines, in the bytes just handed to fast_obj
+/// </summary>
+static void scan_faces(ObjStream* stream, const char* bytes, size_t length)
+{
+	for (size_t index = 0; index < length; index++)
+	{
+		char character = bytes[index];
+		if (stream->lineStart)
+		{
+			stream->faceLine = character == 'f';
+		}
+		else if (stream->faceLine && character == '-' && (stream->previous == ' ' || stream->previous == '\t' || stream->previous == '/'))
+		{
+			stream->chunk->relativeIndices = true;
+		}
+		// indentation doesn't end the start of a line
+		stream->lineStart = character == '\n' || (stream->lineStart && (character == ' ' || character == '\t'));
+		stream->previous = character;
+	}
+}
+
+static void* chunk_open(const char* path, void* userData)
+{
+	ObjChunk* chunk = (ObjChunk*)userData;
+	ObjStream* stream = new ObjStream();
+	stream->chunk = NULL;
+	stream->position = 0;
+	stream->lineStart = true;
+	stream->faceLine = false;
+	stream->previous = '\n';
+	if (chunk->opened)
+	{
+		chunk->libraries.push_back(path);
+	}
+	if (!chunk->opened && chunk->data != NULL)
+	{
+		stream->chunk = chunk;
+	}
+	else if (!stream->file.open(path))
+	{
+		delete stream;
+		stream = NULL;
+	}
+	chunk->opened = true;
+	return stream;
+}
+
+static void chunk_close(void* file, void* userData)
+{
+	delete (ObjStream*)file;
+}
+
+static size_t chunk_read(void* file, void* destination, size_t bytes, void* userData)
+{
+	ObjStream* stream = (ObjStream*)file;
+	char* output = (char*)destination;
+	size_t copied = 0;
+	if (stream->chunk == NULL)
+	{
+		size_t remaining = stream->file.size() - stream->position;
+		copied = bytes < remaining ? bytes : remaining;
+		memcpy(output, stream->file.data() + stream->position, copied);
+		stream->position += copied;
+	}
+	else
+	{
+		// copy from the prefix, the chunk and the suffix in turn
+		ObjChunk* chunk = stream->chunk;
+		const char* parts[3] = { chunk->prefix.data(), chunk->data, chunk->suffix.data() };
+		size_t sizes[3] = { chunk->prefix.size(), chunk->size, chunk->suffix.size() };
+		size_t partStart = 0;
+		for (int part = 0; part < 3; part++)
+		{
+			size_t partEnd = partStart + sizes[part];
+			if (stream->position < partEnd && copied < bytes)
+			{
+				size_t length = partEnd - stream->position < bytes - copied ? partEnd - stream->position : bytes - copied;
+				memcpy(output + copied, parts[part] + (stream->position - partStart), length);
+				copied += length;
+				stream->position += length;
+			}
+			partStart = partEnd;
+		}
+		scan_faces(stream, output, copied);
+	}
+	return copied;
+}
+
+static unsigned long chunk_size(void* file, void* userData)
+{
+	return (unsigned long)stream_size((ObjStream*)file);
+}
+
+ObjParser::ObjParser()
+{
+	serial = NULL;
+	chunkCount = 0;
+	memset(&merged, 0, sizeof(merged));
+}
+
+ObjParser::~ObjParser()
+{
+	clear();
+}
+
+void ObjParser::clear()
+{
+	if (serial != NULL)
+	{
+		fast_obj_destroy(serial);
+		serial = NULL;
+	}
+	// swap rather than clear, to give the memory back
+	std::vector<float>().swap(positions);
+	std::vector<float>().swap(texcoords);
+	std::vector<float>().swap(normals);
+	std::vector<unsigned int>().swap(faceVertices);
+	std::vector<unsigned int>().swap(faceMaterials);
+	std::vector<fastObjIndex>().swap(indices);
+	materials.clear();
+	textures.clear();
+	names.clear();
+	materialLibraries.clear();
+	memset(&merged, 0, sizeof(merged));
+	chunkCount = 0;
+}
+
+char* ObjParser::copy_name(const char* name)
+{
+	if (name == NULL)
+	{
+		return NULL;
+	}
+	names.push_back(name);
+	return &names.back()[0];
+}
+
+unsigned int ObjParser::chunk_count()
+{
+	return chunkCount;
+}
+
+const std::vector<std::string>& ObjParser::material_libraries()
+{
+	return materialLibraries;
+}
+
+fastObjMesh* ObjParser::read(const char* path, JobSystem* jobs)
+{
+	clear();
+	MappedFile file;
+	std::vector<ObjChunk> chunks;
+	// with a single hardware thread the chunks would only take turns, and merging them is extra work
+	if (jobs != NULL && std::thread::hardware_concurrency() > 1 && file.open(path) && file.size() >= 2 * (size_t)MINIMUM_CHUNK_SIZE)
+	{
+		// one chunk per thread, unless that would make them smaller than the minimum
+		size_t size = file.size();
+		size_t chunkTarget = jobs->thread_count() + 1;
+		if (chunkTarget > size / MINIMUM_CHUNK_SIZE)
+		{
+			chunkTarget = size / MINIMUM_CHUNK_SIZE;
+		}
+		const char* data = (const char*)file.data();
+		size_t start = 0;
+		for (size_t chunkIndex = 0; chunkIndex < chunkTarget && start < size; chunkIndex++)
+		{
+			// move each cut forward to just after the end of a line
+			size_t end = size;
+			if (chunkIndex < chunkTarget - 1)
+			{
+				end = size * (chunkIndex + 1) / chunkTarget;
+				end = end > start ? end : start;
+				const char* newline = (const char*)memchr(data + end, '\n', size - end);
+				end = newline != NULL ? newline - data + 1 : size;
+			}
+			ObjChunk chunk;
+			chunk.prefix = chunkIndex > 0 ? "usemtl " CHUNK_START_MATERIAL "\n" : "";
+			chunk.data = data + start;
+			chunk.size = end - start;
+			chunk.suffix = "\nf 1 1 1\n";
+			chunk.opened = false;
+			chunk.relativeIndices = false;
+			chunk.mesh = NULL;
+			chunks.push_back(chunk);
+			start = end;
+		}
+	}
+
+	fastObjCallbacks callbacks;
+	callbacks.file_open = chunk_open;
+	callbacks.file_close = chunk_close;
+	callbacks.file_read = chunk_read;
+	callbacks.file_size = chunk_size;
+	bool parsedInChunks = chunks.size() > 1;
+	if (parsedInChunks)
+	{
+		jobs->parallel_for(chunks.size(), [&chunks, &callbacks, path](unsigned int chunkIndex)
+		{
+			chunks[chunkIndex].mesh = fast_obj_read_with_callbacks(path, &callbacks, &chunks[chunkIndex]);
+		});
+		for (unsigned int chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+		{
+			if (chunks[chunkIndex].mesh == NULL || (chunkIndex > 0 && chunks[chunkIndex].relativeIndices))
+			{
+				parsedInChunks = false;
+			}
+		}
+		if (!parsedInChunks)
+		{
+			for (unsigned int chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+			{
+				if (chunks[chunkIndex].mesh != NULL)
+				{
+					fast_obj_destroy(chunks[chunkIndex].mesh);
+				}
+			}
+		}
+	}
+	if (!parsedInChunks)
+	{
+		// still through the callbacks, to learn which .mtl files the file references
+		file.close();
+		ObjChunk whole;
+		whole.data = NULL;
+		whole.size = 0;
+		whole.opened = false;
+		whole.relativeIndices = false;
+		whole.mesh = NULL;
+		serial = fast_obj_read_with_callbacks(path, &callbacks, &whole);
+		chunkCount = serial != NULL ? 1 : 0;
+		materialLibraries.swap(whole.libraries);
+		return serial;
+	}
+	chunkCount = chunks.size();
+	for (unsigned int chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+	{
+		for (unsigned int libraryIndex = 0; libraryIndex < chunks[chunkIndex].libraries.size(); libraryIndex++)
+		{
+			const std::string& library = chunks[chunkIndex].libraries[libraryIndex];
+			if (std::find(materialLibraries.begin(), materialLibraries.end(), library) == materialLibraries.end())
+			{
+				materialLibraries.push_back(library);
+			}
+		}
+	}
+
+	// merge the materials and textures the way fast_obj builds them over a whole file. Every material a .mtl defines is
+	// added, even one whose name is already known, and textures are shared by name. A usemtl takes the first material
+	// with its name, adding a fallback if there is none yet, so a chunk's fallback stands for an earlier chunk's
+	// material of the same name. The start material of each chunk is left to be resolved once the material at the end
+	// of the chunk before is known.
+	std::unordered_map<std::string, unsigned int> materialsByName;
+	std::unordered_map<std::string, unsigned int> texturesByName;
+	std::vector<std::vector<unsigned int>> materialMaps(chunks.size());
+	std::vector<unsigned int> endMaterials(chunks.size());
+	fastObjTexture noTexture;
+	noTexture.name = NULL;
+	noTexture.path = NULL;
+	textures.push_back(noTexture);
+	for (unsigned int chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+	{
+		fastObjMesh* mesh = chunks[chunkIndex].mesh;
+		std::vector<unsigned int> textureMap(mesh->texture_count, 0);
+		for (unsigned int textureIndex = 1; textureIndex < mesh->texture_count; textureIndex++)
+		{
+			std::string name = mesh->textures[textureIndex].name != NULL ? mesh->textures[textureIndex].name : "";
+			std::unordered_map<std::string, unsigned int>::iterator found = texturesByName.find(name);
+			if (found == texturesByName.end())
+			{
+				fastObjTexture texture;
+				texture.name = copy_name(mesh->textures[textureIndex].name);
+				texture.path = copy_name(mesh->textures[textureIndex].path);
+				texturesByName[name] = textures.size();
+				textureMap[textureIndex] = textures.size();
+				textures.push_back(texture);
+			}
+			else
+			{
+				textureMap[textureIndex] = found->second;
+			}
+		}
+		for (unsigned int materialIndex = 0; materialIndex < mesh->material_count; materialIndex++)
+		{
+			unsigned int mergedIndex = INHERITED_MATERIAL;
+			if (chunkIndex == 0 || materialIndex > 0)
+			{
+				fastObjMaterial material = mesh->materials[materialIndex];
+				std::string name = material.name != NULL ? material.name : "";
+				std::unordered_map<std::string, unsigned int>::iterator found = materialsByName.find(name);
+				// faces only use the first material with a name, so a later one's index is never looked up
+				if (found != materialsByName.end())
+				{
+					mergedIndex = found->second;
+				}
+				if (found == materialsByName.end() || !material.fallback)
+				{
+					unsigned int* maps[9] = { &material.map_Ka, &material.map_Kd, &material.map_Ks, &material.map_Ke, &material.map_Kt, &material.map_Ns, &material.map_Ni, &material.map_d, &material.map_bump };
+					for (int map = 0; map < 9; map++)
+					{
+						*maps[map] = *maps[map] < textureMap.size() ? textureMap[*maps[map]] : 0;
+					}
+					material.name = copy_name(material.name);
+					if (found == materialsByName.end())
+					{
+						mergedIndex = materials.size();
+						materialsByName[name] = mergedIndex;
+					}
+					materials.push_back(material);
+				}
+			}
+			materialMaps[chunkIndex].push_back(mergedIndex);
+		}
+		// the suffix face has the material in use at the end of the chunk
+		unsigned int startMaterial = chunkIndex > 0 ? endMaterials[chunkIndex - 1] : 0;
+		unsigned int endMaterial = mesh->face_materials[mesh->face_count - 1];
+		endMaterials[chunkIndex] = endMaterial < materialMaps[chunkIndex].size() && materialMaps[chunkIndex][endMaterial] != INHERITED_MATERIAL ? materialMaps[chunkIndex][endMaterial] : startMaterial;
+	}
+
+	// lay the chunks' arrays end to end, without each chunk's dummy attributes and suffix face
+	std::vector<size_t> positionOffsets(chunks.size());
+	std::vector<size_t> texcoordOffsets(chunks.size());
+	std::vector<size_t> normalOffsets(chunks.size());
+	std::vector<size_t> faceOffsets(chunks.size());
+	std::vector<size_t> indexOffsets(chunks.size());
+	size_t positionCount = 1;
+	size_t texcoordCount = 1;
+	size_t normalCount = 1;
+	size_t faceCount = 0;
+	size_t indexCount = 0;
+	for (unsigned int chunkIndex = 0; chunkIndex < chunks.size(); chunkIndex++)
+	{
+		fastObjMesh* mesh = chunks[chunkIndex].mesh;
+		positionOffsets[chunkIndex] = positionCount;
+		texcoordOffsets[chunkIndex] = texcoordCount;
+		normalOffsets[chunkIndex] = normalCount;
+		faceOffsets[chunkIndex] = faceCount;
+		indexOffsets[chunkIndex] = indexCount;
+		positionCount += mesh->position_count - 1;
+		texcoordCount += mesh->texcoord_count - 1;
+		normalCount += mesh->normal_count - 1;
+		faceCount += mesh->face_count - 1;
+		indexCount += mesh->index_count - 3;
+	}
+	positions.resize(positionCount * 3);
+	texcoords.resize(texcoordCount * 2);
+	normals.resize(normalCount * 3);
+	faceVertices.resize(faceCount);
+	faceMaterials.resize(faceCount);
+	indices.resize(indexCount);
+	fastObjMesh* first = chunks[0].mesh;
+	memcpy(positions.data(), first->positions, 3 * sizeof(float));
+	memcpy(texcoords.data(), first->texcoords, 2 * sizeof(float));
+	memcpy(normals.data(), first->normals, 3 * sizeof(float));
+	jobs->parallel_for(chunks.size(), [&](unsigned int chunkIndex)
+	{
+		fastObjMesh* mesh = chunks[chunkIndex].mesh;
+		memcpy(positions.data() + positionOffsets[chunkIndex] * 3, mesh->positions + 3, (mesh->position_count - 1) * 3 * sizeof(float));
+		memcpy(texcoords.data() + texcoordOffsets[chunkIndex] * 2, mesh->texcoords + 2, (mesh->texcoord_count - 1) * 2 * sizeof(float));
+		memcpy(normals.data() + normalOffsets[chunkIndex] * 3, mesh->normals + 3, (mesh->normal_count - 1) * 3 * sizeof(float));
+		memcpy(faceVertices.data() + faceOffsets[chunkIndex], mesh->face_vertices, (mesh->face_count - 1) * sizeof(unsigned int));
+		memcpy(indices.data() + indexOffsets[chunkIndex], mesh->indices, (mesh->index_count - 3) * sizeof(fastObjIndex));
+		unsigned int startMaterial = chunkIndex > 0 ? endMaterials[chunkIndex - 1] : 0;
+		const std::vector<unsigned int>& materialMap = materialMaps[chunkIndex];
+		for (unsigned int faceIndex = 0; faceIndex < mesh->face_count - 1; faceIndex++)
+		{
+			unsigned int material = mesh->face_materials[faceIndex];
+			faceMaterials[faceOffsets[chunkIndex] + faceIndex] = material < materialMap.size() && materialMap[material] != INHERITED_MATERIAL ? materialMap[material] : startMaterial;
+		}
+		fast_obj_destroy(mesh);
+	});
+
+	merged.position_count = positionCount;
+	merged.positions = positions.data();
+	merged.texcoord_count = texcoordCount;
+	merged.texcoords = texcoords.data();
+	merged.normal_count = normalCount;
+	merged.normals = normals.data();
+	merged.face_count = faceCount;
+	merged.face_vertices = faceVertices.data();
+	merged.face_materials = faceMaterials.data();
+	merged.index_count = indexCount;
+	merged.indices = indices.data();
+	merged.material_count = materials.size();
+	merged.materials = materials.data();
+	merged.texture_count = textures.size();
+	merged.textures = textures.data();
+	return &merged;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef STERLING_OBJPARSER_H
+#define STERLING_OBJPARSER_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "fast_obj/fast_obj.h"
+#include "jobs.h"
+
+/// <summary>
+/// Parses .obj files, splitting large ones across threads. The file is mapped and cut into chunks at line boundaries,
+/// fast_obj parses each chunk on a worker, then the chunks' arrays are concatenated and their materials and textures
+/// merged the way fast_obj resolves them over a whole file. The attributes, faces, indices, materials and textures are
+/// laid out as fast_obj lays out a whole file, which is all a mesh is built from. Objects, groups and vertex colours are
+/// not merged and are left empty, so don't use the result in place of fast_obj_read where those are needed.
+/// </summary>
+class ObjParser
+{
+private:
+	/// <summary>
+	/// The merged file, its arrays pointing into the vectors below, or fast_obj's own mesh if the file was parsed whole
+	/// </summary>
+	fastObjMesh merged;
+	fastObjMesh* serial;
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	std::vector<float> normals;
+	std::vector<unsigned int> faceVertices;
+	std::vector<unsigned int> faceMaterials;
+	std::vector<fastObjIndex> indices;
+	std::vector<fastObjMaterial> materials;
+	std::vector<fastObjTexture> textures;
+	/// <summary>
+	/// Copies of the material and texture names, which the merged materials and textures point to
+	/// </summary>
+	std::deque<std::string> names;
+	std::vector<std::string> materialLibraries;
+	unsigned int chunkCount;
+
+	/// <summary>
+	/// Free the last file parsed
+	/// </summary>
+	void clear();
+	char* copy_name(const char* name);
+
+public:
+	/// <summary>
+	/// Files smaller than twice this are parsed whole, as splitting them gains nothing
+	/// </summary>
+	static const unsigned int MINIMUM_CHUNK_SIZE = 4 * 1024 * 1024;
+
+	ObjParser();
+	~ObjParser();
+
+	/// <summary>
+	/// Parse a file in chunks, one per thread of the job system and one for the calling thread. Safe to call from a job.
+	/// Files using relative (negative) indices after the first chunk are parsed whole, as those can't be resolved within a chunk.
+	/// </summary>
+	/// <param name="path">The path of the .obj file</param>
+	/// <param name="jobs">The workers to parse on, NULL to parse the file whole on the calling thread</param>
+	/// <returns>The parsed file, owned by the parser and valid until the next read. NULL if it couldn't be read.</returns>
+	fastObjMesh* read(const char* path, JobSystem* jobs);
+	/// <summary>
+	/// The number of chunks the last file was parsed in, 1 if it was parsed whole
+	/// </summary>
+	unsigned int chunk_count();
+	/// <summary>
+	/// The paths of the .mtl files the last file referenced, as fast_obj resolved them, whether they exist or not
+	/// </summary>
+	const std::vector<std::string>& material_libraries();
+};
+
+#endif
\ No newline at end of file
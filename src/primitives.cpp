@@ -2,11 +2,52 @@
 #include "mesh.h"
 #include "material.h"
 #include "maths.h"
+#include <cstdio>
+
+// primitives share their meshes and material through the scene's dictionaries, under names no file path can have
+#define DEFAULT_MATERIAL_NAME "<primitive material>"
+
+/// <summary>
+/// The plain material every primitive uses, created with the first primitive
+/// </summary>
+static int default_material(Scene* scene)
+{
+	int materialIndex = scene->materialDictionary.get_entry(DEFAULT_MATERIAL_NAME);
+	if (materialIndex == -1)
+	{
+		Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
+		material->name = DEFAULT_MATERIAL_NAME;
+		material->ambientColour = maths::vec3f(0, 0, 0);
+		material->diffuseColour = maths::vec3f(0.8, 0.8, 0.8);
+		material->specularColour = maths::vec3f(0.8, 0.8, 0.8);
+		material->shininess = 32;
+		scene->materials.push_back(material);
+		materialIndex = scene->materials.size() - 1;
+		scene->materialDictionary.add_entry(DEFAULT_MATERIAL_NAME, materialIndex);
+	}
+	return materialIndex;
+}
+
+/// <summary>
+/// Create an object showing a primitive's mesh
+/// </summary>
+static Object* mesh_object(Scene* scene, const char* name, int meshIndex)
+{
+	Object* object = new Object(scene, name);
+	object->mesh = meshIndex;
+	object->hasMesh = true;
+	return object;
+}
 
 namespace primitives
 {
 	Object* cube(Scene* scene, const char* name)
 	{
+		int meshIndex = scene->meshDictionary.get_entry("<primitive cube>");
+		if (meshIndex != -1)
+		{
+			return mesh_object(scene, name, meshIndex);
+		}
 		MeshPrimitive* primitive = new MeshPrimitive();
 
 		primitive->vertices.push_back(Vertex(maths::vec3f(-1, 1, -1), maths::vec3f(0, 1, 0), maths::vec2f(0.375, 0)));
@@ -46,29 +87,25 @@ namespace primitives
 		primitive->faces.push_back(Face(20, 21, 22));
 		primitive->faces.push_back(Face(20, 22, 23));
 		
-		primitive->setup();
+		primitive->setup(&scene->geometry);
+		primitive->materialIndex = default_material(scene);
 
 		Mesh* mesh = new Mesh();
 		mesh->primitives.push_back(primitive);
 		scene->meshes.push_back(mesh);
+		meshIndex = scene->meshes.size() - 1;
+		scene->meshDictionary.add_entry("<primitive cube>", meshIndex);
 
-		Object* object = new Object(scene, name);
-		object->mesh = scene->meshes.size() - 1;
-		object->hasMesh = true;
-
-		Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
-		material->ambientColour = maths::vec3f(0, 0, 0);
-		material->diffuseColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->specularColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->shininess = 32;
-		scene->materials.push_back(material);
-		primitive->materialIndex = scene->materials.size() - 1;
-
-		return object;
+		return mesh_object(scene, name, meshIndex);
 	}
 
 	Object* plane(Scene* scene, const char* name)
 	{
+		int meshIndex = scene->meshDictionary.get_entry("<primitive plane>");
+		if (meshIndex != -1)
+		{
+			return mesh_object(scene, name, meshIndex);
+		}
 		MeshPrimitive* primitive = new MeshPrimitive();
 
 		primitive->vertices.push_back(Vertex(maths::vec3f(-1, -1, 0), maths::vec3f(0, 0, 1), maths::vec2f(0, 0)));
@@ -78,29 +115,27 @@ namespace primitives
 		primitive->faces.push_back(Face(0, 1, 2));
 		primitive->faces.push_back(Face(1, 2, 3));
 
-		primitive->setup();
+		primitive->setup(&scene->geometry);
+		primitive->materialIndex = default_material(scene);
 
 		Mesh* mesh = new Mesh();
 		mesh->primitives.push_back(primitive);
 		scene->meshes.push_back(mesh);
+		meshIndex = scene->meshes.size() - 1;
+		scene->meshDictionary.add_entry("<primitive plane>", meshIndex);
 
-		Object* object = new Object(scene, name);
-		object->mesh = scene->meshes.size() - 1;
-		object->hasMesh = true;
-
-		Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
-		material->ambientColour = maths::vec3f(0, 0, 0);
-		material->diffuseColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->specularColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->shininess = 32;
-		scene->materials.push_back(material);
-		primitive->materialIndex = scene->materials.size() - 1;
-
-		return object;
+		return mesh_object(scene, name, meshIndex);
 	}
 
 	Object* sphere(Scene* scene, const char* name, int horizontalResolution, int verticalResolution)
 	{
+		char key[64];
+		snprintf(key, sizeof(key), "<primitive sphere %d %d>", horizontalResolution, verticalResolution);
+		int meshIndex = scene->meshDictionary.get_entry(key);
+		if (meshIndex != -1)
+		{
+			return mesh_object(scene, name, meshIndex);
+		}
 		MeshPrimitive* primitive = new MeshPrimitive();
 
 		float verticalRadianStep = maths::PI / (verticalResolution - 1);
@@ -155,24 +190,15 @@ namespace primitives
 		// close bottom triangle fan
 		primitive->faces.push_back(Face(primitive->vertices.size() - 1, primitive->vertices.size() - 2, primitive->vertices.size() - horizontalResolution - 1));
 
-		primitive->setup();
+		primitive->setup(&scene->geometry);
+		primitive->materialIndex = default_material(scene);
 
 		Mesh* mesh = new Mesh();
 		mesh->primitives.push_back(primitive);
 		scene->meshes.push_back(mesh);
+		meshIndex = scene->meshes.size() - 1;
+		scene->meshDictionary.add_entry(key, meshIndex);
 
-		Object* object = new Object(scene, name);
-		object->mesh = scene->meshes.size() - 1;
-		object->hasMesh = true;
-
-		Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
-		material->ambientColour = maths::vec3f(0, 0, 0);
-		material->diffuseColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->specularColour = maths::vec3f(0.8, 0.8, 0.8);
-		material->shininess = 32;
-		scene->materials.push_back(material);
-		primitive->materialIndex = scene->materials.size() - 1;
-
-		return object;
+		return mesh_object(scene, name, meshIndex);
 	}
 }
\ No newline at end of file
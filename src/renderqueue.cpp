@@ -0,0 +1,186 @@
+#include "renderqueue.h"
+
+#include "glad/glad.h"
+#include <cstring>
+
+RenderQueue::RenderQueue()
+{
+	glGenBuffers(1, &instanceBuffer);
+	instanceBufferCapacity = 0;
+	invalidate_state();
+	memset(&statistics, 0, sizeof(RenderStatistics));
+}
+
+RenderQueue::~RenderQueue()
+{
+	glDeleteBuffers(1, &instanceBuffer);
+}
+
+unsigned long long RenderQueue::make_key(unsigned int shader, unsigned int material, unsigned int primitive, float depth)
+{
+	// the bit pattern of a non-negative float increases with its value, so its top 16 bits are a coarse depth
+	unsigned int depthBits = 0;
+	if (depth > 0)
+	{
+		memcpy(&depthBits, &depth, sizeof(float));
+	}
+	return ((unsigned long long)(shader & 0x3FF) << 54)
+		| ((unsigned long long)(material & 0xFFFF) << 38)
+		| ((unsigned long long)(primitive & 0x3FFFFF) << 16)
+		| (unsigned long long)(depthBits >> 16);
+}
+
+void RenderQueue::clear()
+{
+	items.clear();
+	keys.clear();
+}
+
+void RenderQueue::push(unsigned long long key, MeshPrimitive* primitive, Material* material, unsigned int materialIndex, maths::mat4f worldMatrix)
+{
+	DrawItem item;
+	item.primitive = primitive;
+	item.material = material;
+	// transposed because GL reads matrix attributes by column
+	item.instance.model = maths::mat4f::transpose(primitive->model_matrix(worldMatrix));
+	item.instance.materialIndex = materialIndex;
+	items.push_back(item);
+	keys.push_back(key);
+}
+
+void RenderQueue::radix_sort()
+{
+	unsigned int count = keys.size();
+	order.resize(count);
+	for (unsigned int index = 0; index < count; index++)
+	{
+		order[index] = index;
+	}
+	keyScratch.resize(count);
+	orderScratch.resize(count);
+
+	// one pass per byte, skipping any byte that is the same in every key
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (unsigned int index = 0; index < count; index++)
+		{
+			histogram[(keys[index] >> shift) & 0xFF]++;
+		}
+		if (histogram[(keys[0] >> shift) & 0xFF] != count)
+		{
+			unsigned int offset = 0;
+			for (unsigned int digit = 0; digit < 256; digit++)
+			{
+				unsigned int digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+			for (unsigned int index = 0; index < count; index++)
+			{
+				unsigned int destination = histogram[(keys[index] >> shift) & 0xFF]++;
+				keyScratch[destination] = keys[index];
+				orderScratch[destination] = order[index];
+			}
+			keys.swap(keyScratch);
+			order.swap(orderScratch);
+		}
+	}
+}
+
+void RenderQueue::invalidate_state()
+{
+	boundShader = 0;
+	boundVertexArray = 0;
+	boundTextures[0] = 0;
+	boundTextures[1] = 0;
+	boundTextures[2] = 0;
+}
+
+void RenderQueue::bind_texture(unsigned int unit, Texture2D* texture)
+{
+	if (texture != NULL)
+	{
+		if (boundTextures[unit] != texture->id())
+		{
+			glActiveTexture(GL_TEXTURE0 + unit);
+			texture->use();
+			boundTextures[unit] = texture->id();
+			statistics.textureBinds++;
+		}
+		else
+		{
+			statistics.textureBindsAvoided++;
+		}
+	}
+}
+
+void RenderQueue::submit()
+{
+	memset(&statistics, 0, sizeof(RenderStatistics));
+	statistics.drawItems = items.size();
+	if (items.size() == 0)
+	{
+		return;
+	}
+	invalidate_state();
+	radix_sort();
+
+	// lay the instance data out in sorted order so every run of matching items is contiguous
+	instances.resize(items.size());
+	for (unsigned int index = 0; index < items.size(); index++)
+	{
+		instances[index] = items[order[index]].instance;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if (instances.size() > instanceBufferCapacity)
+	{
+		instanceBufferCapacity = instances.size() * 2;
+	}
+	// orphan last frame's storage so the driver doesn't wait on draws still reading it
+	glBufferData(GL_ARRAY_BUFFER, instanceBufferCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	unsigned int runStart = 0;
+	while (runStart < items.size())
+	{
+		DrawItem* item = &items[order[runStart]];
+		unsigned int runEnd = runStart + 1;
+		while (runEnd < items.size() && items[order[runEnd]].primitive == item->primitive && items[order[runEnd]].material == item->material)
+		{
+			runEnd++;
+		}
+
+		Shader* shader = item->material->get_shader(item->primitive->format);
+		if (boundShader != shader->ID)
+		{
+			shader->use();
+			boundShader = shader->ID;
+			statistics.shaderBinds++;
+		}
+		else
+		{
+			statistics.shaderBindsAvoided++;
+		}
+		bind_texture(0, item->material->ambientMap);
+		bind_texture(1, item->material->diffuseMap);
+		bind_texture(2, item->material->specularMap);
+		if (boundVertexArray != item->primitive->vertex_array())
+		{
+			item->primitive->bind(instanceBuffer);
+			boundVertexArray = item->primitive->vertex_array();
+			statistics.vertexArrayBinds++;
+		}
+		else
+		{
+			statistics.vertexArrayBindsAvoided++;
+		}
+
+		item->primitive->draw_instanced(runEnd - runStart, runStart);
+		statistics.drawCalls++;
+		runStart = runEnd;
+	}
+	glBindVertexArray(0);
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef STERLING_RENDERQUEUE_H
+#define STERLING_RENDERQUEUE_H
+
+#include <vector>
+#include "maths.h"
+#include "mesh.h"
+#include "material.h"
+
+/// <summary>
+/// How much GL state the last submission changed, and how many changes it skipped because the state was already set
+/// </summary>
+struct RenderStatistics
+{
+public:
+	unsigned int drawItems;
+	unsigned int drawCalls;
+	unsigned int shaderBinds;
+	unsigned int shaderBindsAvoided;
+	unsigned int vertexArrayBinds;
+	unsigned int vertexArrayBindsAvoided;
+	unsigned int textureBinds;
+	unsigned int textureBindsAvoided;
+};
+
+/// <summary>
+/// Collects one draw item per object and mesh primitive, sorts them so items sharing state end up next to each other,
+/// then submits them as instanced draw calls while skipping any bind that wouldn't change anything
+/// </summary>
+class RenderQueue
+{
+private:
+	struct DrawItem
+	{
+		MeshPrimitive* primitive;
+		Material* material;
+		InstanceData instance;
+	};
+	std::vector<DrawItem> items;
+	/// <summary>
+	/// Sort key of each item. Bits 63-54 hold the shader, 53-38 the material, 37-16 the mesh primitive and 15-0 the depth,
+	/// so sorting by key groups by the most expensive state change first and draws front to back within a group.
+	/// </summary>
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned long long> keyScratch;
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> orderScratch;
+
+	/// <summary>
+	/// The instance data of every item, in sorted order
+	/// </summary>
+	unsigned int instanceBuffer;
+	unsigned int instanceBufferCapacity;
+	std::vector<InstanceData> instances;
+
+	/// <summary>
+	/// The GL state left behind by the last submission
+	/// </summary>
+	unsigned int boundShader;
+	unsigned int boundVertexArray;
+	unsigned int boundTextures[3];
+
+	/// <summary>
+	/// Least significant digit radix sort of the keys, carrying the item order along with them
+	/// </summary>
+	void radix_sort();
+	/// <summary>
+	/// Bind a texture to a texture unit, unless it is already bound there
+	/// </summary>
+	void bind_texture(unsigned int unit, Texture2D* texture);
+	/// <summary>
+	/// Forget the cached GL state, since the UI and anything else drawn between frames changes it behind the queue's back
+	/// </summary>
+	void invalidate_state();
+
+public:
+	RenderStatistics statistics;
+
+	RenderQueue();
+	~RenderQueue();
+
+	/// <summary>
+	/// Build a sort key from the state an item needs
+	/// </summary>
+	/// <param name="shader">The shader program ID</param>
+	/// <param name="material">The material index</param>
+	/// <param name="primitive">A number identifying the mesh primitive</param>
+	/// <param name="depth">The view space distance to the item</param>
+	static unsigned long long make_key(unsigned int shader, unsigned int material, unsigned int primitive, float depth);
+
+	/// <summary>
+	/// Remove every item from the queue
+	/// </summary>
+	void clear();
+	/// <summary>
+	/// Add one copy of a mesh primitive to the queue
+	/// </summary>
+	/// <param name="key">The item's sort key, from make_key</param>
+	/// <param name="primitive">The primitive to draw</param>
+	/// <param name="material">The material to draw it with</param>
+	/// <param name="materialIndex">The index of the material in the scene's material buffer</param>
+	/// <param name="worldMatrix">The local space -> world space matrix of the copy</param>
+	void push(unsigned long long key, MeshPrimitive* primitive, Material* material, unsigned int materialIndex, maths::mat4f worldMatrix);
+	/// <summary>
+	/// Sort the items, upload their instance data and draw them, merging runs of items with the same primitive and material into one instanced draw call
+	/// </summary>
+	void submit();
+};
+
+#endif
\ No newline at end of file
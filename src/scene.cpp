@@ -1,7 +1,10 @@
 #include "scene.h"
 
-#include <fstream>
+#include <cmath>
 #include <iostream>
+#include <unordered_map>
+#include "cookedmesh.h"
+#include "objectfile.h"
 
 #define FAST_OBJ_IMPLEMENTATION
 #include "fast_obj/fast_obj.h"
@@ -28,7 +31,7 @@ void PathDictionary::traverse(const char* target)
 	while (traversalResult != NULL && shouldContinue)
 	{
 		// traverse the BST
-		int difference = strcmp(traversalResult->path, target);
+		int difference = strcmp(traversalResult->path.c_str(), target);
 		if (difference == 0)
 		{
 			// strings are equal, return this
@@ -157,15 +160,53 @@ Scene::Scene()
 	meshDictionary = PathDictionary();
 	materialDictionary = PathDictionary();
 	activeCamera = NULL;
+	hierarchyRebuildNeeded = true;
+	objectsVisible = 0;
+	objectsCulled = 0;
+	gpuCulling = false;
+	packVertices = false;
+	splitLargePrimitives = false;
+	indirectRenderer = new IndirectRenderer(&geometry);
+	indirectRebuildNeeded = true;
+	jobs = new JobSystem(0);
+	textureStreamer = new TextureStreamer(jobs);
+	textureCache = new TextureCache(textureStreamer);
+	meshesLoading = 0;
+	uploadBudget = 2.0f;
+	residencyFrame = 0;
+	textureBudget = 512.0f;
 
 	glGenBuffers(1, &lightBuffer);
 	glBindBuffer(GL_UNIFORM_BUFFER, lightBuffer);
 	glBufferData(GL_UNIFORM_BUFFER, 2336, NULL, GL_STATIC_DRAW);
 	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 	glBindBufferBase(GL_UNIFORM_BUFFER, 1, lightBuffer);
+
+	glGenBuffers(1, &materialBuffer);
+	materialBufferCount = 0;
+	materialBufferDirty = true;
 }
 Scene::~Scene()
 {
+	// let the workers finish first, so no load is read into after it is deleted
+	delete jobs;
+	for (unsigned int loadIndex = 0; loadIndex < readLoads.size(); loadIndex++)
+	{
+		delete readLoads[loadIndex];
+	}
+	for (unsigned int loadIndex = 0; loadIndex < uploadQueue.size(); loadIndex++)
+	{
+		delete uploadQueue[loadIndex];
+	}
+	// the materials before the texture cache, which they give their maps back to
+	for (unsigned int materialIndex = 0; materialIndex < materials.size(); materialIndex++)
+	{
+		delete materials[materialIndex];
+	}
+	materials.clear();
+	// the textures before the streamer, which they tell about abandoned streams
+	delete textureCache;
+	delete textureStreamer;
 	// delete everything associated with this scene
 	delete activeCamera;
 	while (ambientLights.size() > 0)
@@ -188,271 +229,84 @@ Scene::~Scene()
 	{
 		delete children[0];
 	}
+	// meshes before the geometry buffer, which they release their geometry back to
+	for (int meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
+	{
+		delete meshes[meshIndex];
+	}
+	delete indirectRenderer;
 }
 
 void Scene::load_model_from_file(const char* filepath)
 {
-	// create buffers to hold vertex position, normal and texture coordinate data
-	std::vector<maths::vec3f> vertexPositions;
-	std::vector<maths::vec3f> vertexNormals;
-	std::vector<maths::vec2f> texCoords;
-
-	// create the new objMesh struct
 	Mesh* mesh = new Mesh();
-	// retrieve the objMesh data from filePath
-	std::ifstream meshFile;
-	// ensure ifstream objects can throw exceptions
-	meshFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
+	if (objectfile::read_mapped(filepath, mesh))
 	{
-		// open file
-		meshFile.open(filepath, std::ios::binary);
-
-		// get length
-		meshFile.seekg(0, std::ios::end);
-		std::streamsize fileSize = meshFile.tellg();
-		meshFile.seekg(0, std::ios::beg);
-
-		// read format
-		char* format = new char[4];
-		meshFile.read(format, 4);
-
-		// read material file name length
-		unsigned int materialFileNameLength;
-		meshFile.read((char*)&materialFileNameLength, 4);
-
-		// read material file name
-		char* materialFileName = (char*)malloc(materialFileNameLength + 1);
-		if (materialFileName == NULL)
-		{
-			std::cerr << "ERROR::MESH::OUT_OF_MEMORY\n";
-			return;
-		}
-		materialFileName[materialFileNameLength] = '\0';
-		meshFile.read(materialFileName, materialFileNameLength);
-		free(materialFileName);
-
-		// read primitive count
-		unsigned int primitiveCount;
-		meshFile.read((char*)&primitiveCount, 4);
-
-		for (unsigned int primitiveIndex = 0; primitiveIndex < primitiveCount; primitiveIndex++)
-		{
-			MeshPrimitive* primitive = new MeshPrimitive();
-			mesh->primitives.push_back(primitive);
-
-			// read material index
-			unsigned int materialIndex;
-			meshFile.read((char*)&materialIndex, 4);
-			primitive->materialIndex = materialIndex;
-
-			// read rendering mode
-			char renderingMode;
-			meshFile.read((char*)&renderingMode, 1);
-
-			// read vertex count
-			unsigned int vertexCount;
-			meshFile.read((char*)&vertexCount, 4);
-
-			// read vertex normal count
-			unsigned int vertexNormalCount;
-			meshFile.read((char*)&vertexNormalCount, 4);
-
-			// read texture coordinate count
-			unsigned int texCoordCount;
-			meshFile.read((char*)&texCoordCount, 4);
-
-			// read texture coordinate count
-			unsigned int edgeFaceCount;
-			meshFile.read((char*)&edgeFaceCount, 4);
-
-			// read vertex data
-			for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
-			{
-				maths::vec3f position;
-				meshFile.read((char*)&position, 12);
-				vertexPositions.push_back(position);
-			}
-
-			// read vertex normal data
-			for (unsigned int vertexNormalIndex = 0; vertexNormalIndex < vertexNormalCount; vertexNormalIndex++)
-			{
-				maths::vec3f normal;
-				meshFile.read((char*)&normal, 12);
-				vertexNormals.push_back(normal);
-			}
-
-			// read texture coordinate data
-			for (unsigned int texCoordIndex = 0; texCoordIndex < texCoordCount; texCoordIndex++)
-			{
-				maths::vec2f texCoord;
-				meshFile.read((char*)&texCoord, 8);
-				texCoords.push_back(texCoord);
-			}
-			
-			// read edge/face data
-			if (renderingMode == 0x00) // points
-			{
-				for (unsigned int vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
-				{
-					primitive->vertices.push_back(Vertex(vertexPositions[vertexIndex], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
-				}
-			}
-			else if (renderingMode == 0x01) // edge
-			{
-				for (unsigned int edgeIndex = 0; edgeIndex < edgeFaceCount; edgeIndex++)
-				{
-					// read edge index 1
-					unsigned int edgeIndex1;
-					meshFile.read((char*)&edgeIndex1, 4);
-					unsigned int realEdgeIndex1 = primitive->vertices.size();
-					primitive->vertices.push_back(Vertex(vertexPositions[edgeIndex1], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
-
-					// read edge index 2
-					unsigned int edgeIndex2;
-					meshFile.read((char*)&edgeIndex2, 4);
-					unsigned int realEdgeIndex2 = primitive->vertices.size();
-					primitive->vertices.push_back(Vertex(vertexPositions[edgeIndex2], maths::vec3f(0, 0, 0), maths::vec2f(0, 0)));
-
-					// add the edges to the edge list
-					primitive->edges.push_back(Edge(realEdgeIndex1, realEdgeIndex2));
-				}
-			}
-			else if (renderingMode == 0x02) // face
-			{
-				for (unsigned int faceIndex = 0; faceIndex < edgeFaceCount; faceIndex++)
-				{
-					// read face index 1
-					unsigned int positionIndex1;
-					unsigned int normalIndex1;
-					unsigned int texCoordIndex1;
-					meshFile.read((char*)&positionIndex1, 4);
-					meshFile.read((char*)&normalIndex1, 4);
-					meshFile.read((char*)&texCoordIndex1, 4);
-					unsigned int faceIndex1 = primitive->vertices.size();
-					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex1], vertexNormals[normalIndex1], texCoords[texCoordIndex1]));
-
-					// read face index 2
-					unsigned int positionIndex2;
-					unsigned int normalIndex2;
-					unsigned int texCoordIndex2;
-					meshFile.read((char*)&positionIndex2, 4);
-					meshFile.read((char*)&normalIndex2, 4);
-					meshFile.read((char*)&texCoordIndex2, 4);
-					unsigned int faceIndex2 = primitive->vertices.size();
-					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex2], vertexNormals[normalIndex2], texCoords[texCoordIndex2]));
-
-					// read face index 3
-					unsigned int positionIndex3;
-					unsigned int normalIndex3;
-					unsigned int texCoordIndex3;
-					meshFile.read((char*)&positionIndex3, 4);
-					meshFile.read((char*)&normalIndex3, 4);
-					meshFile.read((char*)&texCoordIndex3, 4);
-					unsigned int faceIndex3 = primitive->vertices.size();
-					primitive->vertices.push_back(Vertex(vertexPositions[positionIndex3], vertexNormals[normalIndex3], texCoords[texCoordIndex3]));
-
-					// add the face to the face list
-					primitive->faces.push_back(Face(faceIndex1, faceIndex2, faceIndex3));
-				}
-			}
-			primitive->setup();
-		}
+		prepare_mesh(mesh);
 		meshes.push_back(mesh);
 	}
-	catch (std::ifstream::failure e)
+	else
 	{
-		std::cerr << "ERROR::MESH::CANNOT_READ_FILE\n" << e.what() << std::endl;
+		delete mesh;
 	}
 }
 
-int Scene::load_model_from_obj(const char* filepath)
+/// <summary>
+/// Identifies a unique vertex of an .obj file: a primitive and the position, normal and texture coordinate indices of a face corner
+/// </summary>
+struct WeldKey
 {
-	fastObjMesh* objMesh = fast_obj_read(filepath);
+	unsigned int primitive;
+	unsigned int position;
+	unsigned int normal;
+	unsigned int texCoord;
 
-	// copy into my own mesh objects
+	bool operator==(const WeldKey& key) const
+	{
+		return primitive == key.primitive && position == key.position && normal == key.normal && texCoord == key.texCoord;
+	}
+};
 
-	// create a mesh
-	Mesh* mesh = new Mesh();
-	meshes.push_back(mesh);
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& key) const
+	{
+		// FNV-1a style mixing of the four indices
+		size_t hash = 2166136261u;
+		hash = (hash ^ key.primitive) * 16777619u;
+		hash = (hash ^ key.position) * 16777619u;
+		hash = (hash ^ key.normal) * 16777619u;
+		hash = (hash ^ key.texCoord) * 16777619u;
+		return hash;
+	}
+};
 
+/// <summary>
+/// Turn the faces of a parsed .obj into one primitive per material, welding face corners that share all their indices.
+/// Each primitive's material index is the index of its material in the .obj. Only reads the parsed .obj, so is safe on a worker thread.
+/// </summary>
+static void read_obj_primitives(fastObjMesh* objMesh, Mesh* mesh)
+{
 	// create a objMesh primitive for each material
 	for (int primitiveIndex = 0; primitiveIndex < objMesh->material_count; primitiveIndex++)
 	{
 		MeshPrimitive* primitive = new MeshPrimitive();
+		primitive->materialIndex = primitiveIndex;
 		mesh->primitives.push_back(primitive);
-
-		// setup the material
-		fastObjMaterial* objMaterial = &objMesh->materials[primitiveIndex];
-		int materialIndex = materialDictionary.get_entry(objMaterial->name);
-		if (materialIndex == -1)
-		{
-			// material does not yet exist
-			Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
-			materialIndex = materials.size();
-			materialDictionary.add_entry(objMaterial->name, materialIndex);
-			materials.push_back(material);
-			
-			// set properties
-			material->ambientColour = maths::vec3f(objMaterial->Ka[0], objMaterial->Ka[1], objMaterial->Ka[2]);
-			material->diffuseColour = maths::vec3f(objMaterial->Kd[0], objMaterial->Kd[1], objMaterial->Kd[2]);
-			material->specularColour = maths::vec3f(objMaterial->Ks[0], objMaterial->Ks[1], objMaterial->Ks[2]);
-			material->emissionColour = maths::vec3f(objMaterial->Ke[0], objMaterial->Ke[1], objMaterial->Ke[2]);
-			material->transmittanceColour = maths::vec3f(objMaterial->Kt[0], objMaterial->Kt[1], objMaterial->Kt[2]);
-			material->shininess = objMaterial->Ns;
-			material->indexOfRefraction = objMaterial->Ni;
-			material->transmissionFilter = maths::vec3f(objMaterial->Tf[0], objMaterial->Tf[1], objMaterial->Tf[2]);
-			material->dissolve = objMaterial->d;
-
-			// set textures
-			if (objMaterial->map_Ka != 0)
-			{
-				material->ambientMap = new Texture2D(objMesh->textures[objMaterial->map_Ka].name);
-			}
-			if (objMaterial->map_Kd != 0)
-			{
-				material->diffuseMap = new Texture2D(objMesh->textures[objMaterial->map_Kd].name);
-			}
-			if (objMaterial->map_Ks != 0)
-			{
-				material->specularMap = new Texture2D(objMesh->textures[objMaterial->map_Ks].name);
-			}
-			if (objMaterial->map_Ke != 0)
-			{
-				material->emissionMap = new Texture2D(objMesh->textures[objMaterial->map_Ke].name);
-			}
-			if (objMaterial->map_Kt != 0)
-			{
-				material->transmittanceMap = new Texture2D(objMesh->textures[objMaterial->map_Kt].name);
-			}
-			if (objMaterial->map_Ns != 0)
-			{
-				material->shininessMap = new Texture2D(objMesh->textures[objMaterial->map_Ns].name);
-			}
-			if (objMaterial->map_Ni != 0)
-			{
-				material->indexOfRefractionMap = new Texture2D(objMesh->textures[objMaterial->map_Ni].name);
-			}
-			if (objMaterial->map_d != 0)
-			{
-				material->dissolveMap = new Texture2D(objMesh->textures[objMaterial->map_d].name);
-			}
-			if (objMaterial->map_bump != 0)
-			{
-				material->bumpMap = new Texture2D(objMesh->textures[objMaterial->map_bump].name);
-			}
-		}
-		primitive->materialIndex = materialIndex;
 	}
 
 	// loop through all of the faces
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> weldedVertices;
+	weldedVertices.reserve(objMesh->index_count);
+	std::vector<unsigned int> faceVertices;
 	unsigned int indexIndex = 0;
 	for (int faceIndex = 0; faceIndex < objMesh->face_count; faceIndex++)
 	{
 		unsigned int primitiveIndex = objMesh->face_materials[faceIndex];
-		unsigned int startingPosition = mesh->primitives[primitiveIndex]->vertices.size();
+		MeshPrimitive* primitive = mesh->primitives[primitiveIndex];
 
-		// add each vertex to the associated primitive
+		// find or add each corner's vertex in the associated primitive
+		faceVertices.clear();
 		for (int vertexIndex = 0; vertexIndex < objMesh->face_vertices[faceIndex]; vertexIndex++)
 		{
 			unsigned int positionIndex = objMesh->indices[indexIndex].p;
@@ -460,48 +314,313 @@ int Scene::load_model_from_obj(const char* filepath)
 			unsigned int texCoordIndex = objMesh->indices[indexIndex].t;
 			indexIndex++;
 
-			Vertex vertex = Vertex(
-				maths::vec3f(
-					objMesh->positions[positionIndex * 3],
-					objMesh->positions[positionIndex * 3 + 1],
-					objMesh->positions[positionIndex * 3 + 2]
-				),
-				maths::vec3f(
-					objMesh->normals[normalIndex * 3],
-					objMesh->normals[normalIndex * 3 + 1],
-					objMesh->normals[normalIndex * 3 + 2]
-				),
-				maths::vec2f(
-					objMesh->texcoords[texCoordIndex * 2],
-					objMesh->texcoords[texCoordIndex * 2 + 1]
-				)
-			);
-			mesh->primitives[primitiveIndex]->vertices.push_back(vertex);
+			// corners that share a position, normal and texture coordinate are the same vertex
+			WeldKey key;
+			key.primitive = primitiveIndex;
+			key.position = positionIndex;
+			key.normal = normalIndex;
+			key.texCoord = texCoordIndex;
+			std::pair<std::unordered_map<WeldKey, unsigned int, WeldKeyHash>::iterator, bool> inserted = weldedVertices.insert(std::make_pair(key, (unsigned int)primitive->vertices.size()));
+			faceVertices.push_back(inserted.first->second);
+			if (inserted.second)
+			{
+				// first time this corner has been seen
+				Vertex vertex = Vertex(
+					maths::vec3f(
+						objMesh->positions[positionIndex * 3],
+						objMesh->positions[positionIndex * 3 + 1],
+						objMesh->positions[positionIndex * 3 + 2]
+					),
+					maths::vec3f(
+						objMesh->normals[normalIndex * 3],
+						objMesh->normals[normalIndex * 3 + 1],
+						objMesh->normals[normalIndex * 3 + 2]
+					),
+					maths::vec2f(
+						objMesh->texcoords[texCoordIndex * 2],
+						objMesh->texcoords[texCoordIndex * 2 + 1]
+					)
+				);
+				primitive->vertices.push_back(vertex);
+			}
 		}
 
 		// triangulate the face and add it to the associated primitive
-		for (int triangle = 2; triangle < objMesh->face_vertices[faceIndex]; triangle++)
+		for (int triangle = 2; triangle < faceVertices.size(); triangle++)
 		{
 			// triangulate between the first vertex, the vertex before the current, and the current
-			mesh->primitives[primitiveIndex]->faces.push_back(
+			primitive->faces.push_back(
 				Face(
-					startingPosition,
-					startingPosition + triangle - 1,
-					startingPosition + triangle
+					faceVertices[0],
+					faceVertices[triangle - 1],
+					faceVertices[triangle]
 				)
 			);
 		}
 	}
+}
 
-	// setup the primitives
-	for (int primitiveIndex = 0; primitiveIndex < objMesh->material_count; primitiveIndex++)
+/// <summary>
+/// Optimise a freshly read mesh's primitives, split them if the settings ask to, and lay them out in the chosen vertex format.
+/// Safe on a worker thread.
+/// </summary>
+/// <param name="mesh">The mesh to prepare</param>
+/// <param name="settings">ImportSetting bits</param>
+/// <param name="vertexData">Filled with each primitive's vertices, as MeshPrimitive::build lays them out</param>
+/// <param name="indexData">Filled with each primitive's indices</param>
+static void prepare_primitives(Mesh* mesh, unsigned int settings, std::vector<std::vector<unsigned char>>* vertexData, std::vector<std::vector<unsigned char>>* indexData)
+{
+	for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+	{
+		mesh->primitives[primitiveIndex]->optimise();
+	}
+	if (settings & IMPORT_SPLIT_LARGE_PRIMITIVES)
+	{
+		mesh->split_large_primitives(65536);
+	}
+	vertexData->resize(mesh->primitives.size());
+	indexData->resize(mesh->primitives.size());
+	for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+	{
+		MeshPrimitive* primitive = mesh->primitives[primitiveIndex];
+		primitive->format = settings & IMPORT_PACK_VERTICES ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_STANDARD;
+		primitive->build(&(*vertexData)[primitiveIndex], &(*indexData)[primitiveIndex]);
+	}
+}
+
+/*
+Mesh Load
+*/
+
+MeshLoad::MeshLoad(const char* path, unsigned int settings, JobSystem* jobs)
+{
+	this->path = path;
+	this->settings = settings;
+	this->jobs = jobs;
+	meshIndex = -1;
+	mesh = new Mesh();
+	cooked = NULL;
+	objMesh = NULL;
+	sourceFound = false;
+	materialsCreated = false;
+	primitivesUploaded = 0;
+}
+
+MeshLoad::~MeshLoad()
+{
+	delete mesh;
+	delete cooked;
+}
+
+void MeshLoad::read()
+{
+	// a cooked mesh skips parsing, welding and optimising entirely
+	sourceFound = source.read(path.c_str(), settings);
+	if (sourceFound)
+	{
+		cooked = new CookedMeshReader();
+		if (!cooked->open(cookedmesh::cooked_path(path.c_str()), source))
+		{
+			delete cooked;
+			cooked = NULL;
+		}
+	}
+	if (cooked == NULL)
+	{
+		objMesh = objParser.read(path.c_str(), jobs);
+		if (objMesh == NULL)
+		{
+			std::cerr << "ERROR::MESH::CANNOT_READ_FILE\n" << path << std::endl;
+		}
+		else
+		{
+			// the cooked mesh will be stale if any of these change
+			const std::vector<std::string>& libraries = objParser.material_libraries();
+			for (unsigned int libraryIndex = 0; libraryIndex < libraries.size(); libraryIndex++)
+			{
+				source.add_library(libraries[libraryIndex]);
+			}
+			read_obj_primitives(objMesh, mesh);
+			prepare_primitives(mesh, settings, &vertexData, &indexData);
+		}
+	}
+}
+
+/*
+Scene
+*/
+
+int Scene::load_model_from_obj(const char* filepath)
+{
+	MeshLoad* load = new MeshLoad(filepath, import_settings(), jobs);
+	meshes.push_back(new Mesh());
+	load->meshIndex = meshes.size() - 1;
+	load->read();
+	upload_mesh(load, std::chrono::steady_clock::time_point::max());
+	int meshIndex = load->meshIndex;
+	delete load;
+	return meshIndex;
+}
+
+int Scene::add_obj_material(fastObjMesh* objMesh, unsigned int objMaterialIndex)
+{
+	fastObjMaterial* objMaterial = &objMesh->materials[objMaterialIndex];
+	int materialIndex = materialDictionary.get_entry(objMaterial->name);
+	if (materialIndex == -1)
 	{
-		mesh->primitives[primitiveIndex]->setup();
+		// material does not yet exist
+		Material* material = new Material("shaders/shaded.vert", "shaders/shaded.frag");
+		materialIndex = materials.size();
+		materialDictionary.add_entry(objMaterial->name, materialIndex);
+		materials.push_back(material);
+		material->name = objMaterial->name;
+		material->textureCache = textureCache;
+		
+		// set properties
+		material->ambientColour = maths::vec3f(objMaterial->Ka[0], objMaterial->Ka[1], objMaterial->Ka[2]);
+		material->diffuseColour = maths::vec3f(objMaterial->Kd[0], objMaterial->Kd[1], objMaterial->Kd[2]);
+		material->specularColour = maths::vec3f(objMaterial->Ks[0], objMaterial->Ks[1], objMaterial->Ks[2]);
+		material->emissionColour = maths::vec3f(objMaterial->Ke[0], objMaterial->Ke[1], objMaterial->Ke[2]);
+		material->transmittanceColour = maths::vec3f(objMaterial->Kt[0], objMaterial->Kt[1], objMaterial->Kt[2]);
+		material->shininess = objMaterial->Ns;
+		material->indexOfRefraction = objMaterial->Ni;
+		material->transmissionFilter = maths::vec3f(objMaterial->Tf[0], objMaterial->Tf[1], objMaterial->Tf[2]);
+		material->dissolve = objMaterial->d;
+
+		// set textures: the colour maps, then the maps of other data
+		if (objMaterial->map_Ka != 0)
+		{
+			material->ambientMap = textureCache->acquire(objMesh->textures[objMaterial->map_Ka].name, true);
+		}
+		if (objMaterial->map_Kd != 0)
+		{
+			material->diffuseMap = textureCache->acquire(objMesh->textures[objMaterial->map_Kd].name, true);
+		}
+		if (objMaterial->map_Ks != 0)
+		{
+			material->specularMap = textureCache->acquire(objMesh->textures[objMaterial->map_Ks].name, true);
+		}
+		if (objMaterial->map_Ke != 0)
+		{
+			material->emissionMap = textureCache->acquire(objMesh->textures[objMaterial->map_Ke].name, true);
+		}
+		if (objMaterial->map_Kt != 0)
+		{
+			material->transmittanceMap = textureCache->acquire(objMesh->textures[objMaterial->map_Kt].name, true);
+		}
+		if (objMaterial->map_Ns != 0)
+		{
+			material->shininessMap = textureCache->acquire(objMesh->textures[objMaterial->map_Ns].name, false);
+		}
+		if (objMaterial->map_Ni != 0)
+		{
+			material->indexOfRefractionMap = textureCache->acquire(objMesh->textures[objMaterial->map_Ni].name, false);
+		}
+		if (objMaterial->map_d != 0)
+		{
+			material->dissolveMap = textureCache->acquire(objMesh->textures[objMaterial->map_d].name, false);
+		}
+		if (objMaterial->map_bump != 0)
+		{
+			material->bumpMap = textureCache->acquire(objMesh->textures[objMaterial->map_bump].name, false);
+		}
 	}
+	return materialIndex;
+}
 
-	fast_obj_destroy(objMesh);
+void Scene::prepare_mesh(Mesh* mesh)
+{
+	std::vector<std::vector<unsigned char>> vertexData;
+	std::vector<std::vector<unsigned char>> indexData;
+	prepare_primitives(mesh, import_settings(), &vertexData, &indexData);
+	for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+	{
+		mesh->primitives[primitiveIndex]->upload(&geometry, vertexData[primitiveIndex].data(), indexData[primitiveIndex].data());
+	}
+}
 
-	return meshes.size() - 1;
+unsigned int Scene::import_settings()
+{
+	return (packVertices ? IMPORT_PACK_VERTICES : 0) | (splitLargePrimitives ? IMPORT_SPLIT_LARGE_PRIMITIVES : 0);
+}
+
+bool Scene::upload_mesh(MeshLoad* load, std::chrono::steady_clock::time_point deadline)
+{
+	// materials first, since the primitives refer to them. Reuse materials that are already loaded, by name.
+	if (!load->materialsCreated)
+	{
+		if (load->cooked != NULL)
+		{
+			for (unsigned int cookedIndex = 0; cookedIndex < load->cooked->materials.size(); cookedIndex++)
+			{
+				int materialIndex = materialDictionary.get_entry(load->cooked->materials[cookedIndex].name);
+				if (materialIndex == -1)
+				{
+					materialIndex = materials.size();
+					materialDictionary.add_entry(load->cooked->materials[cookedIndex].name, materialIndex);
+					materials.push_back(load->cooked->create_material(cookedIndex, textureCache));
+				}
+				load->materialIndices.push_back(materialIndex);
+			}
+		}
+		else if (load->objMesh != NULL)
+		{
+			for (unsigned int objMaterialIndex = 0; objMaterialIndex < load->objMesh->material_count; objMaterialIndex++)
+			{
+				load->materialIndices.push_back(add_obj_material(load->objMesh, objMaterialIndex));
+			}
+		}
+		load->materialsCreated = true;
+	}
+
+	// then the primitives, straight from the cooked mesh's mapping or from the prepared data
+	unsigned int primitiveCount = load->cooked != NULL ? load->cooked->primitives.size() : load->mesh->primitives.size();
+	bool withinBudget = true;
+	while (load->primitivesUploaded < primitiveCount && withinBudget)
+	{
+		unsigned int primitiveIndex = load->primitivesUploaded;
+		if (load->cooked != NULL)
+		{
+			MeshPrimitive* primitive = load->cooked->create_primitive(primitiveIndex, &geometry);
+			primitive->materialIndex = load->materialIndices[load->cooked->primitives[primitiveIndex].record->material];
+			load->mesh->primitives.push_back(primitive);
+		}
+		else
+		{
+			MeshPrimitive* primitive = load->mesh->primitives[primitiveIndex];
+			primitive->materialIndex = load->materialIndices[primitive->materialIndex];
+			primitive->upload(&geometry, load->vertexData[primitiveIndex].data(), load->indexData[primitiveIndex].data());
+			load->writer.add_primitive(primitive, materials[primitive->materialIndex], load->vertexData[primitiveIndex], load->indexData[primitiveIndex]);
+			// the data isn't needed once it is uploaded and held by the writer
+			std::vector<unsigned char>().swap(load->vertexData[primitiveIndex]);
+			std::vector<unsigned char>().swap(load->indexData[primitiveIndex]);
+		}
+		load->primitivesUploaded++;
+		withinBudget = std::chrono::steady_clock::now() < deadline;
+	}
+
+	bool finished = load->primitivesUploaded == primitiveCount;
+	if (finished)
+	{
+		if (load->objMesh != NULL && load->sourceFound)
+		{
+			// writing a large mesh out can take longer than a frame, so a worker does it from the writer's own copy of the data
+			CookedMeshWriter* writer = new CookedMeshWriter(std::move(load->writer));
+			std::string cookedPath = cookedmesh::cooked_path(load->path.c_str());
+			CookedMeshSource source = load->source;
+			jobs->submit([writer, cookedPath, source]()
+			{
+				writer->write(cookedPath, source);
+				delete writer;
+			});
+		}
+		delete meshes[load->meshIndex];
+		meshes[load->meshIndex] = load->mesh;
+		load->mesh = NULL;
+		// the objects using the mesh need new bounds and draws
+		hierarchy_changed();
+	}
+	return finished;
 }
 
 int Scene::load_mesh(const char* filePath)
@@ -519,15 +638,353 @@ int Scene::load_mesh(const char* filePath)
 	return index;
 }
 
+int Scene::load_mesh_async(const char* filePath)
+{
+	int index = meshDictionary.get_entry(filePath);
+	if (index == -1)
+	{
+		// the slot holds an empty mesh until the load is finished
+		meshes.push_back(new Mesh());
+		index = meshes.size() - 1;
+		meshDictionary.add_entry(filePath, index);
+		MeshLoad* load = new MeshLoad(filePath, import_settings(), jobs);
+		load->meshIndex = index;
+		meshesLoading++;
+		jobs->submit([this, load]()
+		{
+			load->read();
+			std::lock_guard<std::mutex> lock(readLoadsMutex);
+			readLoads.push_back(load);
+		});
+	}
+	return index;
+}
+
+void Scene::update_loading()
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds((long long)(uploadBudget * 1000.0f));
+	{
+		std::lock_guard<std::mutex> lock(readLoadsMutex);
+		for (unsigned int loadIndex = 0; loadIndex < readLoads.size(); loadIndex++)
+		{
+			uploadQueue.push_back(readLoads[loadIndex]);
+		}
+		readLoads.clear();
+	}
+	bool withinBudget = true;
+	while (!uploadQueue.empty() && withinBudget)
+	{
+		MeshLoad* load = uploadQueue.front();
+		if (upload_mesh(load, deadline))
+		{
+			uploadQueue.pop_front();
+			delete load;
+			meshesLoading--;
+		}
+		withinBudget = std::chrono::steady_clock::now() < deadline;
+	}
+}
+
+unsigned int Scene::meshes_loading()
+{
+	return meshesLoading;
+}
+
+unsigned int Scene::textures_streaming()
+{
+	return textureStreamer->textures_streaming();
+}
+
 void Scene::add_object(Object* object)
 {
 	children.push_back(object);
 	object->scene = this;
 	object->parent = NULL;
+	hierarchy_changed();
+}
+
+void Scene::hierarchy_changed()
+{
+	hierarchyRebuildNeeded = true;
+}
+
+bool Scene::hierarchy_current()
+{
+	return !hierarchyRebuildNeeded;
+}
+
+maths::mat4f Scene::world_matrix(int hierarchyIndex)
+{
+	return worldMatrices[hierarchyIndex];
+}
+
+void Scene::rebuild_hierarchy()
+{
+	hierarchyObjects.clear();
+	hierarchyParents.clear();
+	for (int childIndex = 0; childIndex < children.size(); childIndex++)
+	{
+		hierarchyObjects.push_back(children[childIndex]);
+		hierarchyParents.push_back(-1);
+	}
+	// breadth first, so each object's children are appended after it
+	for (int objectIndex = 0; objectIndex < hierarchyObjects.size(); objectIndex++)
+	{
+		Object* object = hierarchyObjects[objectIndex];
+		object->hierarchyIndex = objectIndex;
+		for (int childIndex = 0; childIndex < object->children.size(); childIndex++)
+		{
+			hierarchyObjects.push_back(object->children[childIndex]);
+			hierarchyParents.push_back(objectIndex);
+		}
+	}
+	localMatrices.resize(hierarchyObjects.size());
+	worldMatrices.resize(hierarchyObjects.size());
+	worldMatrixDirty.resize(hierarchyObjects.size());
+	worldBounds.resize(hierarchyObjects.size());
+	hierarchyRebuildNeeded = false;
+}
+
+void Scene::update_transformations()
+{
+	bool rebuilt = hierarchyRebuildNeeded;
+	if (rebuilt)
+	{
+		rebuild_hierarchy();
+		indirectRebuildNeeded = true;
+		// take objects that were detached from the scene out of the bounding volume hierarchy
+		visibleObjects.clear();
+		bvh.all_objects(visibleObjects);
+		for (int objectIndex = 0; objectIndex < visibleObjects.size(); objectIndex++)
+		{
+			Object* object = visibleObjects[objectIndex];
+			bool inHierarchy = object->hierarchyIndex >= 0 && object->hierarchyIndex < hierarchyObjects.size() && hierarchyObjects[object->hierarchyIndex] == object;
+			if (!inHierarchy || !object->hasMesh)
+			{
+				bvh.destroy_proxy(object->bvhProxy);
+				object->bvhProxy = -1;
+			}
+		}
+	}
+
+	// gather every changed transformation (all of them after a rebuild, since indices moved)
+	transformationBatch.clear();
+	batchTargets.clear();
+	for (int objectIndex = 0; objectIndex < hierarchyObjects.size(); objectIndex++)
+	{
+		Transformation* transformation = &hierarchyObjects[objectIndex]->transformation;
+		bool changed = rebuilt || transformation->matrixDirty();
+		worldMatrixDirty[objectIndex] = changed;
+		if (changed)
+		{
+			transformationBatch.push_back(transformation->position(), transformation->rotation(), transformation->scale());
+			batchTargets.push_back(objectIndex);
+		}
+	}
+
+	// rebuild the local matrices in one pass and hand them back
+	batchMatrices.resize(batchTargets.size());
+	if (batchTargets.size() > 0)
+	{
+		transformationBatch.compute_matrices(&batchMatrices[0]);
+	}
+	for (unsigned int targetIndex = 0; targetIndex < batchTargets.size(); targetIndex++)
+	{
+		int objectIndex = batchTargets[targetIndex];
+		localMatrices[objectIndex] = batchMatrices[targetIndex];
+		hierarchyObjects[objectIndex]->transformation.transformationMatrix(batchMatrices[targetIndex]);
+	}
+
+	// forward sweep, parents are always already up to date when their children are reached
+	for (int objectIndex = 0; objectIndex < hierarchyObjects.size(); objectIndex++)
+	{
+		int parentIndex = hierarchyParents[objectIndex];
+		if (parentIndex == -1)
+		{
+			if (worldMatrixDirty[objectIndex])
+			{
+				worldMatrices[objectIndex] = localMatrices[objectIndex];
+			}
+		}
+		else if (worldMatrixDirty[objectIndex] || worldMatrixDirty[parentIndex])
+		{
+			worldMatrixDirty[objectIndex] = true;
+			worldMatrices[objectIndex] = worldMatrices[parentIndex] * localMatrices[objectIndex];
+		}
+
+		if (worldMatrixDirty[objectIndex])
+		{
+			Object* object = hierarchyObjects[objectIndex];
+			if (object->hasMesh)
+			{
+				indirectRebuildNeeded = true;
+				worldBounds[objectIndex] = maths::bounding_box::transform(worldMatrices[objectIndex], meshes[object->mesh]->bounds());
+				if (object->bvhProxy != -1)
+				{
+					bvh.move_proxy(object->bvhProxy, worldBounds[objectIndex]);
+				}
+				else if (!worldBounds[objectIndex].empty())
+				{
+					// meshes still loading are empty, and get a proxy once they are finished
+					object->bvhProxy = bvh.create_proxy(worldBounds[objectIndex], object);
+				}
+			}
+			else
+			{
+				worldBounds[objectIndex] = maths::bounding_box();
+			}
+		}
+	}
+}
+
+void Scene::materials_changed()
+{
+	materialBufferDirty = true;
+}
+
+void Scene::update_material_buffer()
+{
+	if (materialBufferDirty || materialBufferCount != materials.size())
+	{
+		materialData.resize(materials.size());
+		for (int materialIndex = 0; materialIndex < materials.size(); materialIndex++)
+		{
+			materials[materialIndex]->pack(&materialData[materialIndex]);
+		}
+		if (materialData.size() != 0)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, materialData.size() * sizeof(MaterialData), &materialData[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, materialBuffer);
+		}
+		materialBufferCount = materials.size();
+		materialBufferDirty = false;
+	}
+}
+
+void Scene::render_objects(maths::mat4f viewMatrix)
+{
+	// number the primitives of every mesh consecutively, so each primitive gets a compact ID for its sort keys
+	primitiveNumbers.resize(meshes.size());
+	unsigned int primitiveCount = 0;
+	for (int meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
+	{
+		primitiveNumbers[meshIndex] = primitiveCount;
+		primitiveCount += meshes[meshIndex]->primitives.size();
+	}
+
+	maths::frustum viewFrustum = maths::frustum(activeCamera->projection_matrix() * viewMatrix);
+	if (gpuCulling)
+	{
+		// hand every instance to the indirect renderer, which culls and draws them on the GPU
+		if (indirectRebuildNeeded)
+		{
+			indirectRenderer->clear();
+			for (int objectIndex = 0; objectIndex < hierarchyObjects.size(); objectIndex++)
+			{
+				Object* object = hierarchyObjects[objectIndex];
+				if (object->hasMesh)
+				{
+					Mesh* mesh = meshes[object->mesh];
+					for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+					{
+						MeshPrimitive* primitive = mesh->primitives[primitiveIndex];
+						indirectRenderer->add(primitiveNumbers[object->mesh] + primitiveIndex, primitive, materials[primitive->materialIndex], primitive->materialIndex, worldMatrices[objectIndex]);
+					}
+				}
+			}
+			indirectRenderer->build();
+			indirectRebuildNeeded = false;
+		}
+		indirectRenderer->render(viewFrustum);
+		return;
+	}
+
+	visibleObjects.clear();
+	bvh.query_frustum(viewFrustum, visibleObjects);
+	objectsVisible = visibleObjects.size();
+	objectsCulled = bvh.proxy_count() - objectsVisible;
+
+	renderQueue.clear();
+	for (int visibleIndex = 0; visibleIndex < visibleObjects.size(); visibleIndex++)
+	{
+		Object* object = visibleObjects[visibleIndex];
+		int objectIndex = object->hierarchyIndex;
+		unsigned int primitiveNumber = primitiveNumbers[object->mesh];
+		maths::mat4f worldMatrix = worldMatrices[objectIndex];
+		maths::vec4f viewPosition = viewMatrix * maths::vec4f(worldMatrix.m14, worldMatrix.m24, worldMatrix.m34, 1);
+		Mesh* mesh = meshes[object->mesh];
+		for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+		{
+			MeshPrimitive* primitive = mesh->primitives[primitiveIndex];
+			Material* material = materials[primitive->materialIndex];
+			unsigned long long key = RenderQueue::make_key(material->get_shader(primitive->format)->ID, primitive->materialIndex, primitiveNumber + primitiveIndex, viewPosition.z);
+			renderQueue.push(key, primitive, material, primitive->materialIndex, worldMatrix);
+		}
+	}
+	renderQueue.submit();
+}
+
+void Scene::update_texture_residency(maths::mat4f viewMatrix)
+{
+	residencyFrame++;
+	if (residencyFrame < RESIDENCY_INTERVAL)
+	{
+		return;
+	}
+	residencyFrame = 0;
+
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	maths::mat4f projection = activeCamera->projection_matrix();
+	visibleObjects.clear();
+	bvh.query_frustum(maths::frustum(projection * viewMatrix), visibleObjects);
+	for (int visibleIndex = 0; visibleIndex < visibleObjects.size(); visibleIndex++)
+	{
+		Object* object = visibleObjects[visibleIndex];
+		maths::bounding_box bounds = worldBounds[object->hierarchyIndex];
+		maths::vec3f centre = bounds.centre();
+		maths::vec3f extent = bounds.extent();
+		float radius = sqrtf(maths::vec3f::dot(extent, extent));
+		maths::vec4f viewCentre = viewMatrix * maths::vec4f(centre.x, centre.y, centre.z, 1);
+		float distance = sqrtf(viewCentre.x * viewCentre.x + viewCentre.y * viewCentre.y + viewCentre.z * viewCentre.z);
+		// the height of the bounding sphere on screen, or the whole screen from inside it
+		float pixels = viewport[2] > viewport[3] ? viewport[2] : viewport[3];
+		if (distance > radius)
+		{
+			pixels = radius * projection.m22 / distance * viewport[3];
+		}
+		Mesh* mesh = meshes[object->mesh];
+		for (int primitiveIndex = 0; primitiveIndex < mesh->primitives.size(); primitiveIndex++)
+		{
+			Material* material = materials[mesh->primitives[primitiveIndex]->materialIndex];
+			Texture2D* maps[3] = { material->ambientMap, material->diffuseMap, material->specularMap };
+			for (int map = 0; map < 3; map++)
+			{
+				if (maps[map] != NULL)
+				{
+					maps[map]->record_screen_size(pixels);
+				}
+			}
+		}
+	}
+	// moved textures have new IDs for the batches to pick up
+	if (textureCache->update_residency((size_t)(textureBudget * 1024.0f * 1024.0f)) > 0)
+	{
+		indirectRebuildNeeded = true;
+	}
 }
 
 void Scene::render()
 {
+	update_loading();
+	// batches are keyed on texture IDs, which change as textures replace their placeholder
+	if (textureStreamer->update() > 0)
+	{
+		indirectRebuildNeeded = true;
+	}
+	update_transformations();
 	if (activeCamera != NULL)
 	{
 		// update the projection and view matrix buffers if they need to be updated
@@ -544,10 +1001,20 @@ void Scene::render()
 		// render background
 		glClearColor(backgroundColour.x, backgroundColour.y, backgroundColour.z, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// fit the textures' levels to the sizes they are drawn at
+		update_texture_residency(viewMatrix);
 		// render the objects in the scene
-		for (int childIndex = 0; childIndex < children.size(); childIndex++)
-		{
-			children[childIndex]->render();
-		}
+		update_material_buffer();
+		render_objects(viewMatrix);
 	}
+}
+
+unsigned int Scene::gpu_instances_tested()
+{
+	return indirectRenderer->instancesTested;
+}
+
+unsigned int Scene::gpu_draw_calls()
+{
+	return indirectRenderer->drawCalls;
 }
\ No newline at end of file
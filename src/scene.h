@@ -1,12 +1,25 @@
 #ifndef STERLING_SCENE_H
 #define STERLING_SCENE_H
 
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
 #include <vector>
 #include "mesh.h"
 #include "material.h"
 #include "object.h"
+#include "renderqueue.h"
+#include "bvh.h"
+#include "geometry.h"
+#include "indirectrenderer.h"
+#include "cookedmesh.h"
+#include "jobs.h"
+#include "objparser.h"
+#include "texturestreamer.h"
 
 class Object;
+struct Transformation;
 class Camera;
 class AmbientLight;
 class AmbientLight;
@@ -21,7 +34,10 @@ class PathDictionary
 private:
 	struct PathDictionaryEntry
 	{
-		const char* path;
+		/// <summary>
+		/// A copy of the path, since the caller's string may not outlive the entry
+		/// </summary>
+		std::string path;
 		int index;
 		PathDictionaryEntry* leftChild;
 		PathDictionaryEntry* rightChild;
@@ -58,6 +74,69 @@ public:
 	void add_entry(const char* path, int index);
 };
 
+/// <summary>
+/// Bits for the import settings that change how a mesh is prepared
+/// </summary>
+enum ImportSetting
+{
+	IMPORT_PACK_VERTICES = 1,
+	IMPORT_SPLIT_LARGE_PRIMITIVES = 2
+};
+
+/// <summary>
+/// A mesh being loaded from a .obj file or its cooked mesh. read() does the file I/O, parsing and vertex processing
+/// and is safe to run on a worker thread, as it touches nothing but the load. The scene then creates the materials
+/// and uploads the primitives on the main thread.
+/// </summary>
+class MeshLoad
+{
+public:
+	std::string path;
+	/// <summary>
+	/// The import settings when the load was started, as ImportSetting bits
+	/// </summary>
+	unsigned int settings;
+	/// <summary>
+	/// The slot in the scene's mesh list the finished mesh goes in
+	/// </summary>
+	int meshIndex;
+	/// <summary>
+	/// The mesh being built, handed to the scene when every primitive is uploaded
+	/// </summary>
+	Mesh* mesh;
+
+	/// <summary>
+	/// Set by read(): the cooked mesh if there is a current one, otherwise the parsed .obj and the primitives
+	/// prepared from it, with their material indices into the .obj's materials
+	/// </summary>
+	CookedMeshReader* cooked;
+	fastObjMesh* objMesh;
+	ObjParser objParser;
+	/// <summary>
+	/// The workers the .obj is parsed on, NULL to parse it on the reading thread alone
+	/// </summary>
+	JobSystem* jobs;
+	std::vector<std::vector<unsigned char>> vertexData;
+	std::vector<std::vector<unsigned char>> indexData;
+	CookedMeshSource source;
+	bool sourceFound;
+
+	/// <summary>
+	/// The progress of the main thread's part of the load
+	/// </summary>
+	bool materialsCreated;
+	std::vector<int> materialIndices;
+	unsigned int primitivesUploaded;
+	CookedMeshWriter writer;
+
+	MeshLoad(const char* path, unsigned int settings, JobSystem* jobs);
+	~MeshLoad();
+	/// <summary>
+	/// Map the cooked mesh, or parse the .obj and prepare its primitives if there isn't a current one
+	/// </summary>
+	void read();
+};
+
 /// <summary>
 /// Represents a 3D environment, with objects, lights, cameras etc.
 /// </summary>
@@ -76,12 +155,127 @@ private:
 	void update_spotlights(maths::mat4f viewMatrix, bool updateLightPositions);
 	void update_directional_lights(maths::mat4f viewMatrix, bool updateLightPositions);
 
+	/// <summary>
+	/// The object tree flattened breadth first, so every parent comes before its children.
+	/// hierarchyParents holds the index of each object's parent (-1 for top level objects).
+	/// </summary>
+	std::vector<Object*> hierarchyObjects;
+	std::vector<int> hierarchyParents;
+	std::vector<maths::mat4f> localMatrices;
+	std::vector<maths::mat4f> worldMatrices;
+	std::vector<unsigned char> worldMatrixDirty;
+	/// <summary>
+	/// World space box around each object's mesh, empty for objects without one. Updated alongside the world matrices.
+	/// </summary>
+	std::vector<maths::bounding_box> worldBounds;
+	bool hierarchyRebuildNeeded;
+	/// <summary>
+	/// Scratch storage for rebuilding the matrices of every changed transformation in one batch
+	/// </summary>
+	maths::transformation_batch transformationBatch;
+	std::vector<int> batchTargets;
+	std::vector<maths::mat4f> batchMatrices;
+	/// <summary>
+	/// Flatten the object tree into the hierarchy arrays
+	/// </summary>
+	void rebuild_hierarchy();
+	/// <summary>
+	/// Optimise a freshly loaded mesh's primitives, split them if asked to, and upload them in the chosen vertex format
+	/// </summary>
+	void prepare_mesh(Mesh* mesh);
+	/// <summary>
+	/// The current import settings as ImportSetting bits, which are also stored in cooked meshes
+	/// </summary>
+	unsigned int import_settings();
+	/// <summary>
+	/// Create a .obj material, or find it if a material with the same name is already loaded
+	/// </summary>
+	/// <param name="objMesh">The parsed .obj</param>
+	/// <param name="objMaterialIndex">The index of the material in the .obj</param>
+	/// <returns>The index into the material list</returns>
+	int add_obj_material(fastObjMesh* objMesh, unsigned int objMaterialIndex);
+	/// <summary>
+	/// The main thread's part of a load: create the materials, then upload primitives until they are all uploaded
+	/// or the deadline passes. At least one primitive is uploaded per call. When finished the mesh takes its slot in the mesh list.
+	/// </summary>
+	/// <param name="load">A load that has been read</param>
+	/// <param name="deadline">When to stop uploading</param>
+	/// <returns>Whether the load is finished</returns>
+	bool upload_mesh(MeshLoad* load, std::chrono::steady_clock::time_point deadline);
+
+	/// <summary>
+	/// Runs the reading part of asynchronous loads
+	/// </summary>
+	JobSystem* jobs;
+	/// <summary>
+	/// Loads the workers have finished reading, waiting to be picked up by the main thread
+	/// </summary>
+	std::vector<MeshLoad*> readLoads;
+	std::mutex readLoadsMutex;
+	/// <summary>
+	/// Loads being uploaded by the main thread, in the order they were read
+	/// </summary>
+	std::deque<MeshLoad*> uploadQueue;
+	unsigned int meshesLoading;
+	/// <summary>
+	/// Decodes material textures on the workers and uploads them a little each frame
+	/// </summary>
+	TextureStreamer* textureStreamer;
+	/// <summary>
+	/// The frames between each estimate of how large the textures are drawn, and the frames since the last
+	/// </summary>
+	static const unsigned int RESIDENCY_INTERVAL = 10;
+	unsigned int residencyFrame;
+	/// <summary>
+	/// Every so many frames, estimate how many pixels each visible object covers from its bounds and record it on
+	/// the textures its materials bind, then have the texture cache fit the textures' levels to those sizes
+	/// </summary>
+	/// <param name="viewMatrix">The camera's view matrix</param>
+	void update_texture_residency(maths::mat4f viewMatrix);
+
+	/// <summary>
+	/// The parameters of every material, indexed by material index, read by the shaders from binding 2
+	/// </summary>
+	unsigned int materialBuffer;
+	unsigned int materialBufferCount;
+	bool materialBufferDirty;
+	std::vector<MaterialData> materialData;
+	/// <summary>
+	/// Upload the material parameters if materials were added or changed since the last upload
+	/// </summary>
+	void update_material_buffer();
+
+	/// <summary>
+	/// The objects the bounding volume hierarchy found inside the frustum this frame
+	/// </summary>
+	std::vector<Object*> visibleObjects;
+	/// <summary>
+	/// The number of the first primitive of each mesh, counting across all meshes
+	/// </summary>
+	std::vector<unsigned int> primitiveNumbers;
+	/// <summary>
+	/// Queue a draw item for every primitive of every mesh-bearing object, then sort and submit them.
+	/// Objects the bounding volume hierarchy finds entirely outside the camera's frustum are skipped.
+	/// </summary>
+	/// <param name="viewMatrix">The camera's view matrix, for culling and the depth part of the sort keys</param>
+	void render_objects(maths::mat4f viewMatrix);
+	/// <summary>
+	/// Culls and draws on the GPU when gpuCulling is set. Its instances are only rebuilt when a mesh-bearing object
+	/// moves or the hierarchy changes.
+	/// </summary>
+	IndirectRenderer* indirectRenderer;
+	bool indirectRebuildNeeded;
+
 public:
 	/// <summary>
 	/// List of all of the meshes in the scene.
 	/// </summary>
 	std::vector<Mesh*> meshes;
 	/// <summary>
+	/// The shared vertex and index buffers every mesh primitive's geometry is placed in
+	/// </summary>
+	GeometryBuffer geometry;
+	/// <summary>
 	/// List of all of the materials in the scene.
 	/// </summary>
 	std::vector<Material*> materials;
@@ -94,6 +288,10 @@ public:
 	/// </summary>
 	PathDictionary materialDictionary;
 	/// <summary>
+	/// Every texture the scene's materials use, shared by all the materials using the same image file
+	/// </summary>
+	TextureCache* textureCache;
+	/// <summary>
 	/// The camera that scenes should be rendered from the perspective of
 	/// </summary>
 	Camera* activeCamera;
@@ -117,6 +315,40 @@ public:
 	/// List of all of the highest objects in the scene hierarchy
 	/// </summary>
 	std::vector<Object*> children;
+	/// <summary>
+	/// Sorts and submits the draw calls each frame, and counts how much state switching it saved
+	/// </summary>
+	RenderQueue renderQueue;
+	/// <summary>
+	/// Bounding volume hierarchy over every mesh-bearing object in the scene, kept up to date by update_transformations.
+	/// Use it for frustum, box and ray queries against the scene's objects.
+	/// </summary>
+	BoundingVolumeHierarchy bvh;
+	/// <summary>
+	/// How many mesh-bearing objects were drawn and how many were culled in the last frame
+	/// </summary>
+	unsigned int objectsVisible;
+	unsigned int objectsCulled;
+	/// <summary>
+	/// Cull on the GPU and draw with multi-draw indirect instead of the CPU culling and render queue
+	/// </summary>
+	bool gpuCulling;
+	/// <summary>
+	/// Store the vertices of meshes loaded from now on in the packed vertex format, half the size of the standard one
+	/// </summary>
+	bool packVertices;
+	/// <summary>
+	/// Split the primitives of meshes loaded from now on into pieces of at most 65536 vertices, so they all use 16 bit indices
+	/// </summary>
+	bool splitLargePrimitives;
+	/// <summary>
+	/// How long update_loading() may spend uploading each frame, in milliseconds
+	/// </summary>
+	float uploadBudget;
+	/// <summary>
+	/// The video memory the textures should fit in, in MiB. Distant objects' textures give up their finest levels first.
+	/// </summary>
+	float textureBudget;
 
 	/// <summary>
 	/// Load a mesh from a .mesh file and add it to the mesh list
@@ -143,14 +375,61 @@ public:
 	/// <returns>An index into the mesh list</returns>
 	int load_mesh(const char* filePath);
 	/// <summary>
+	/// Ask the scene to load a .obj file without waiting for it. The mesh is read on a worker thread and uploaded by
+	/// update_loading(); until then its slot in the mesh list holds an empty mesh, so objects using it draw nothing.
+	/// </summary>
+	/// <param name="filePath">The relative path to the .obj file</param>
+	/// <returns>An index into the mesh list</returns>
+	int load_mesh_async(const char* filePath);
+	/// <summary>
+	/// Upload meshes the workers have finished reading, until the upload budget for this frame is used up.
+	/// Called at the start of render().
+	/// </summary>
+	void update_loading();
+	/// <summary>
+	/// The number of asynchronous loads not yet finished
+	/// </summary>
+	unsigned int meshes_loading();
+	/// <summary>
+	/// The number of textures not yet fully uploaded
+	/// </summary>
+	unsigned int textures_streaming();
+	/// <summary>
 	/// Add an object to the scene's children
 	/// </summary>
 	/// <param name="object">The object to add</param>
 	void add_object(Object* object);
 	/// <summary>
+	/// Tell the scene that the parameters of existing materials changed so the material buffer gets re-uploaded
+	/// </summary>
+	void materials_changed();
+	/// <summary>
+	/// Tell the scene that objects were added, removed or re-parented so the flattened hierarchy gets rebuilt
+	/// </summary>
+	void hierarchy_changed();
+	/// <summary>
+	/// Whether the flattened hierarchy matches the object tree
+	/// </summary>
+	bool hierarchy_current();
+	/// <summary>
+	/// The cached local space -> world space matrix of an object in the flattened hierarchy
+	/// </summary>
+	/// <param name="hierarchyIndex">The object's index into the flattened hierarchy</param>
+	maths::mat4f world_matrix(int hierarchyIndex);
+	/// <summary>
+	/// Rebuild the local matrix of every object whose position, rotation or scale changed, then
+	/// recompute the world matrices and bounds of those objects and everything below them in one forward sweep
+	/// </summary>
+	void update_transformations();
+	/// <summary>
 	/// Render the scene
 	/// </summary>
 	void render();
+	/// <summary>
+	/// How many instances the GPU culling tested and how many indirect draw calls it made in the last frame
+	/// </summary>
+	unsigned int gpu_instances_tested();
+	unsigned int gpu_draw_calls();
 };
 
 #endif
\ No newline at end of file
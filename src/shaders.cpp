@@ -1,6 +1,125 @@
 #include "shaders.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+std::unordered_map<std::string, Shader*> Shader::programCache;
+
+/// <summary>
+/// 64-bit FNV-1a hash of both shader sources, used to name and validate cached program binaries
+/// </summary>
+static unsigned long long source_hash(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t index = 0; index < vertexCode.size(); index++)
+	{
+		hash = (hash ^ (unsigned char)vertexCode[index]) * 1099511628211ULL;
+	}
+	// separator so moving text between the two files changes the hash
+	hash = (hash ^ 0xFF) * 1099511628211ULL;
+	for (size_t index = 0; index < fragmentCode.size(); index++)
+	{
+		hash = (hash ^ (unsigned char)fragmentCode[index]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/// <summary>
+/// Identifies the GPU and driver, since program binaries are only valid on the driver that produced them
+/// </summary>
+static std::string driver_string()
+{
+	std::string driver;
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	driver += vendor != NULL ? vendor : "";
+	driver += "|";
+	driver += renderer != NULL ? renderer : "";
+	driver += "|";
+	driver += version != NULL ? version : "";
+	return driver;
+}
+
+/// <summary>
+/// Insert lines of defines straight after the #version directive, which has to stay the first line
+/// </summary>
+static std::string insert_defines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+	{
+		return source;
+	}
+	size_t versionLine = source.find("#version");
+	size_t insertAt = 0;
+	if (versionLine != std::string::npos)
+	{
+		insertAt = source.find('\n', versionLine);
+		insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+	}
+	return source.substr(0, insertAt) + defines + source.substr(insertAt);
+}
+
+Shader* Shader::load(const char* vertexPath, const char* fragmentPath, const std::string& defines)
+{
+	std::string key = std::string(vertexPath) + "\n" + fragmentPath + "\n" + defines;
+	std::unordered_map<std::string, Shader*>::iterator entry = programCache.find(key);
+	if (entry != programCache.end())
+	{
+		return entry->second;
+	}
+	Shader* shader = new Shader(vertexPath, fragmentPath, defines);
+	programCache[key] = shader;
+	return shader;
+}
+
+Shader* Shader::load_compute(const char* computePath, const std::string& defines)
+{
+	std::string key = std::string(computePath) + "\n" + defines;
+	std::unordered_map<std::string, Shader*>::iterator entry = programCache.find(key);
+	if (entry != programCache.end())
+	{
+		return entry->second;
+	}
+
+	std::string computeCode;
+	std::ifstream cShaderFile;
+	cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	try
+	{
+		cShaderFile.open(computePath);
+		std::stringstream cShaderStream;
+		cShaderStream << cShaderFile.rdbuf();
+		cShaderFile.close();
+		computeCode = insert_defines(cShaderStream.str(), defines);
+	}
+	catch (const std::ifstream::failure& e)
+	{
+		std::cerr << "ERROR::SHADER::CANNOT_READ_FILE\n" << e.what() << std::endl;
+	}
+
+	// compute programs are cached with an empty fragment shader, which no graphics program can have
+	Shader* shader = new Shader();
+	shader->ID = glCreateProgram();
+	std::string binaryPath = program_binary_path(computeCode, "");
+	if (!shader->load_program_binary(binaryPath, computeCode, ""))
+	{
+		shader->compile_and_link_compute(computeCode);
+		shader->save_program_binary(binaryPath, computeCode, "");
+	}
+	shader->reflect_uniforms();
+
+	programCache[key] = shader;
+	return shader;
+}
+
+Shader::Shader()
+{
+	ID = 0;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
 {
 	// 1. retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
@@ -23,17 +142,31 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 		vShaderFile.close();
 		fShaderFile.close();
 		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
+		vertexCode = insert_defines(vShaderStream.str(), defines);
+		fragmentCode = insert_defines(fShaderStream.str(), defines);
 	}
 	catch (std::ifstream::failure e)
 	{
 		std::cerr << "ERROR::SHADER::CANNOT_READ_FILE\n" << e.what() << std::endl;
 	}
+	// 2. use the cached program binary if this driver has already built these sources, otherwise compile them
+	ID = glCreateProgram();
+	std::string binaryPath = program_binary_path(vertexCode, fragmentCode);
+	if (!load_program_binary(binaryPath, vertexCode, fragmentCode))
+	{
+		compile_and_link(vertexCode, fragmentCode);
+		save_program_binary(binaryPath, vertexCode, fragmentCode);
+	}
+
+	reflect_uniforms();
+}
+
+void Shader::compile_and_link(const std::string& vertexCode, const std::string& fragmentCode)
+{
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// 2. compile shaders
+	// compile shaders
 	unsigned int vertex, fragment;
 	int success;
 	char infoLog[512];
@@ -63,9 +196,10 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 	}
 
 	// shader program
-	ID = glCreateProgram();
 	glAttachShader(ID, vertex);
 	glAttachShader(ID, fragment);
+	// ask the driver to keep the linked binary around so it can be written to the cache
+	glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(ID);
 	// print linking errors if any
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -80,43 +214,262 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 	glDeleteShader(fragment);
 }
 
+void Shader::compile_and_link_compute(const std::string& computeCode)
+{
+	const char* cShaderCode = computeCode.c_str();
+	int success;
+	char infoLog[512];
+
+	unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(compute, 1, &cShaderCode, NULL);
+	glCompileShader(compute);
+	glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(compute, 512, NULL, infoLog);
+		std::cerr << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+	}
+
+	glAttachShader(ID, compute);
+	glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(ID);
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(ID, 512, NULL, infoLog);
+		std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+	}
+
+	glDeleteShader(compute);
+}
+
+std::string Shader::program_binary_path(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)source_hash(vertexCode, fragmentCode));
+	return std::string(PROGRAM_BINARY_CACHE_DIRECTORY) + "/" + name;
+}
+
+bool Shader::load_program_binary(const std::string& path, const std::string& vertexCode, const std::string& fragmentCode)
+{
+	int formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount == 0)
+	{
+		return false;
+	}
+
+	std::ifstream binaryFile(path, std::ios::binary);
+	if (!binaryFile.is_open())
+	{
+		return false;
+	}
+	// the lengths in the file are checked against its size, so a corrupt one can't make a huge allocation
+	std::error_code error;
+	unsigned long long fileSize = std::filesystem::file_size(path, error);
+	if (error)
+	{
+		return false;
+	}
+
+	// header: magic, version, source hash, driver identification
+	char magic[4];
+	unsigned int version = 0;
+	unsigned long long hash = 0;
+	unsigned int driverLength = 0;
+	binaryFile.read(magic, 4);
+	binaryFile.read((char*)&version, 4);
+	binaryFile.read((char*)&hash, 8);
+	binaryFile.read((char*)&driverLength, 4);
+	if (!binaryFile || memcmp(magic, "STPB", 4) != 0 || version != PROGRAM_BINARY_CACHE_VERSION || hash != source_hash(vertexCode, fragmentCode))
+	{
+		return false;
+	}
+	if (driverLength > fileSize - (unsigned long long)binaryFile.tellg())
+	{
+		return false;
+	}
+	std::string driver(driverLength, '\0');
+	binaryFile.read(&driver[0], driverLength);
+	if (!binaryFile || driver != driver_string())
+	{
+		// built by a different GPU or driver version
+		return false;
+	}
+
+	// program binary
+	unsigned int binaryFormat = 0;
+	unsigned int binaryLength = 0;
+	binaryFile.read((char*)&binaryFormat, 4);
+	binaryFile.read((char*)&binaryLength, 4);
+	if (!binaryFile || binaryLength > fileSize - (unsigned long long)binaryFile.tellg())
+	{
+		return false;
+	}
+	std::vector<char> binary(binaryLength);
+	if (binaryLength > 0)
+	{
+		binaryFile.read(&binary[0], binaryLength);
+	}
+	if (!binaryFile || binaryLength == 0)
+	{
+		return false;
+	}
+
+	// the driver may still reject it, in which case fall back to compiling
+	int success = 0;
+	glProgramBinary(ID, binaryFormat, &binary[0], binaryLength);
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+void Shader::save_program_binary(const std::string& path, const std::string& vertexCode, const std::string& fragmentCode)
+{
+	int success = 0;
+	int binaryLength = 0;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (!success || binaryLength <= 0)
+	{
+		return;
+	}
+	std::vector<char> binary(binaryLength);
+	unsigned int binaryFormat = 0;
+	glGetProgramBinary(ID, binaryLength, &binaryLength, &binaryFormat, &binary[0]);
+
+	std::error_code error;
+	std::filesystem::create_directories(PROGRAM_BINARY_CACHE_DIRECTORY, error);
+	std::ofstream binaryFile(path, std::ios::binary | std::ios::trunc);
+	if (!binaryFile.is_open())
+	{
+		std::cerr << "ERROR::SHADER::CANNOT_WRITE_BINARY_CACHE\n" << path << std::endl;
+		return;
+	}
+	unsigned int version = PROGRAM_BINARY_CACHE_VERSION;
+	unsigned long long hash = source_hash(vertexCode, fragmentCode);
+	std::string driver = driver_string();
+	unsigned int driverLength = driver.size();
+	unsigned int length = binaryLength;
+	binaryFile.write("STPB", 4);
+	binaryFile.write((char*)&version, 4);
+	binaryFile.write((char*)&hash, 8);
+	binaryFile.write((char*)&driverLength, 4);
+	binaryFile.write(driver.c_str(), driverLength);
+	binaryFile.write((char*)&binaryFormat, 4);
+	binaryFile.write((char*)&length, 4);
+	binaryFile.write(&binary[0], binaryLength);
+}
+
+void Shader::reflect_uniforms()
+{
+	int uniformCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	std::string name(maxNameLength, '\0');
+	for (int uniformIndex = 0; uniformIndex < uniformCount; uniformIndex++)
+	{
+		int nameLength = 0;
+		int size = 0;
+		unsigned int type = 0;
+		glGetActiveUniform(ID, uniformIndex, maxNameLength, &nameLength, &size, &type, &name[0]);
+		std::string uniformName = name.substr(0, nameLength);
+		int location = glGetUniformLocation(ID, uniformName.c_str());
+		// members of uniform blocks have no location
+		if (location != -1)
+		{
+			uniformLocations[uniformName] = location;
+			// arrays are reported as "name[0]", also allow them to be found by "name"
+			if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+			{
+				uniformLocations[uniformName.substr(0, uniformName.size() - 3)] = location;
+			}
+		}
+	}
+}
+
 void Shader::use() const
 {
 	glUseProgram(ID);
 }
 
+int Shader::uniform_location(const std::string& name) const
+{
+	std::unordered_map<std::string, int>::const_iterator entry = uniformLocations.find(name);
+	if (entry == uniformLocations.end())
+	{
+		return -1;
+	}
+	return entry->second;
+}
+
 void Shader::setBool(const std::string& name, bool value) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniform1i(uniformLocation, (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniform1i(uniformLocation, value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniform1f(uniformLocation, value);
 }
 
 void Shader::setVec4f(const std::string& name, float x, float y, float z, float w) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniform4f(uniformLocation, x, y, z, w);
 }
 
 void Shader::setVec3f(const std::string& name, float x, float y, float z) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniform3f(uniformLocation, x, y, z);
 }
 
 void Shader::setMat4f(const std::string& name, maths::mat4f value) const
 {
-	int uniformLocation = glGetUniformLocation(ID, name.c_str());
+	int uniformLocation = uniform_location(name);
 	glUniformMatrix4fv(uniformLocation, 1, GL_TRUE, &(value.m11));
+}
+
+void Shader::setBool(int location, bool value) const
+{
+	glUniform1i(location, (int)value);
+}
+
+void Shader::setInt(int location, int value) const
+{
+	glUniform1i(location, value);
+}
+
+void Shader::setFloat(int location, float value) const
+{
+	glUniform1f(location, value);
+}
+
+void Shader::setVec4f(int location, float x, float y, float z, float w) const
+{
+	glUniform4f(location, x, y, z, w);
+}
+
+void Shader::setVec3f(int location, float x, float y, float z) const
+{
+	glUniform3f(location, x, y, z);
+}
+
+void Shader::setMat4f(int location, maths::mat4f value) const
+{
+	glUniformMatrix4fv(location, 1, GL_TRUE, &(value.m11));
+}
+
+void Shader::setVec4fArray(int location, const float* values, int count) const
+{
+	glUniform4fv(location, count, values);
 }
\ No newline at end of file
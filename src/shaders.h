@@ -7,11 +7,53 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 
 #include "maths.h"
 
+// Linked program binaries are cached here, keyed by a hash of the shader sources
+#define PROGRAM_BINARY_CACHE_DIRECTORY "shaders/cache"
+#define PROGRAM_BINARY_CACHE_VERSION 1
+
 class Shader
 {
+private:
+	// Locations of every active uniform, read once after linking
+	std::unordered_map<std::string, int> uniformLocations;
+	// Every program created through load(), keyed by source paths and defines
+	static std::unordered_map<std::string, Shader*> programCache;
+
+	/// <summary>
+	/// Query the linked program for its active uniforms and fill the location table
+	/// </summary>
+	void reflect_uniforms();
+	/// <summary>
+	/// Compile both shaders from source and link them into the program
+	/// </summary>
+	void compile_and_link(const std::string& vertexCode, const std::string& fragmentCode);
+	/// <summary>
+	/// Compile a compute shader from source and link it into the program
+	/// </summary>
+	void compile_and_link_compute(const std::string& computeCode);
+	/// <summary>
+	/// The cache file for a pair of shader sources
+	/// </summary>
+	static std::string program_binary_path(const std::string& vertexCode, const std::string& fragmentCode);
+	/// <summary>
+	/// Creates an empty shader, for load_compute to fill in
+	/// </summary>
+	Shader();
+	/// <summary>
+	/// Load the program from the binary cache. Fails if there is no cache file, it was built from different sources,
+	/// or by a different driver, or the driver rejects the binary.
+	/// </summary>
+	/// <returns>true if the program is linked and ready to use</returns>
+	bool load_program_binary(const std::string& path, const std::string& vertexCode, const std::string& fragmentCode);
+	/// <summary>
+	/// Write the linked program's binary to the cache
+	/// </summary>
+	void save_program_binary(const std::string& path, const std::string& vertexCode, const std::string& fragmentCode);
+
 public:
 	// The unique shader program ID, for use with OpenGL functions
 	unsigned int ID;
@@ -21,12 +63,33 @@ public:
 	/// </summary>
 	/// <param name="vertexPath">: The path of the vertex shader to compile and link</param>
 	/// <param name="fragmentPath">: The path of the fragment shader to compile and link</param>
-	Shader(const char* vertexPath, const char* fragmentPath);
+	/// <param name="defines">: Extra lines (e.g. "#define NAME\n") inserted after the #version line of both shaders</param>
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+	/// <summary>
+	/// Returns the shared program for a vertex/fragment pair and set of defines, compiling it the first time it is asked for
+	/// </summary>
+	/// <param name="vertexPath">: The path of the vertex shader</param>
+	/// <param name="fragmentPath">: The path of the fragment shader</param>
+	/// <param name="defines">: Extra lines inserted after the #version line of both shaders</param>
+	static Shader* load(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
+	/// <summary>
+	/// Returns the shared compute program for a compute shader and set of defines, compiling it the first time it is asked for
+	/// </summary>
+	/// <param name="computePath">: The path of the compute shader</param>
+	/// <param name="defines">: Extra lines inserted after the #version line of the shader</param>
+	static Shader* load_compute(const char* computePath, const std::string& defines = "");
 	/// <summary>
 	/// Binds the shader
 	/// </summary>
 	void use() const;
 	/// <summary>
+	/// Looks up the location of a uniform in the table built at link time. Resolve locations once and keep them,
+	/// then use the location overloads of the setters on hot paths.
+	/// </summary>
+	/// <param name="name">: The identifier of the uniform inside the shader code</param>
+	/// <returns>The location, -1 if the uniform doesn't exist or was optimised out</returns>
+	int uniform_location(const std::string& name) const;
+	/// <summary>
 	/// Sets a Boolean inside the shader
 	/// </summary>
 	/// <param name="name">: The identifier of the bool inside the shader code</param>
@@ -62,6 +125,15 @@ public:
 	/// <param name="name">: The identifier of the matrix4 inside the shader code</param>
 	/// <param name="value">: The values to give the matrix4</param>
 	void setMat4f(const std::string& name, maths::mat4f) const;
+
+	// Setters for locations already resolved with uniform_location
+	void setBool(int location, bool value) const;
+	void setInt(int location, int value) const;
+	void setFloat(int location, float value) const;
+	void setVec4f(int location, float x, float y, float z, float w) const;
+	void setVec3f(int location, float x, float y, float z) const;
+	void setMat4f(int location, maths::mat4f value) const;
+	void setVec4fArray(int location, const float* values, int count) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,13 +1,45 @@
 #include "textures.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <vector>
 #include <glad/glad.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
+#include "compressedtexture.h"
+#include "texturestreamer.h"
 
+static int level_size(int size, int level)
+{
+	return size >> level > 1 ? size >> level : 1;
+}
+
+/// <summary>
+/// Set the wrapping and filtering of a texture created with glCreateTextures
+/// </summary>
+static void set_parameters(unsigned int texture)
+{
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
 Texture2D::Texture2D(const char* path)
 {
+	filePath = path;
+	resident = true;
+	placeholderID = 0;
+	colour = true;
+	stream = NULL;
+	levelCount = 0;
+	storageLevel = 0;
+	residentLevel = 0;
+	internalFormat = GL_RGB8;
+	blockBytes = 0;
+	screenSize = 0.0f;
+	lastScreenSize = 0.0f;
 	glGenTextures(1, &ID);
 	glBindTexture(GL_TEXTURE_2D, ID);
 
@@ -16,20 +48,18 @@ Texture2D::Texture2D(const char* path)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	unsigned char* data = stbi_load(path, &width, &height, &channelCount, 0);
-	short format = GL_RGB;
-	if (channelCount == 1)
-	{
-		format = GL_DEPTH_COMPONENT;
-	}
-	else if (channelCount == 4)
-	{
-		format = GL_RGBA;
-	}
+	unsigned char* data = stbi_load(path, &width, &height, &channelCount, 4);
 	if (data)
 	{
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// the levels are built here rather than by glGenerateMipmap, which would average the sRGB colour as if it were linear
+		std::vector<std::vector<unsigned char>> levels;
+		levels.push_back(std::vector<unsigned char>(data, data + (size_t)width * height * 4));
+		compressedtexture::build_levels(width, height, true, &levels);
+		levelCount = levels.size();
+		for (int level = 0; level < levelCount; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, level_size(width, level), level_size(height, level), 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+		}
 	}
 	else
 	{
@@ -38,7 +68,246 @@ Texture2D::Texture2D(const char* path)
 	stbi_image_free(data);
 }
 
+Texture2D::Texture2D(const char* path, TextureStreamer* streamer, bool colour)
+{
+	this->colour = colour;
+	filePath = path;
+	width = 0;
+	height = 0;
+	channelCount = 0;
+	resident = false;
+	placeholderID = streamer->placeholder_id();
+	stream = NULL;
+	levelCount = 0;
+	storageLevel = 0;
+	residentLevel = 0;
+	internalFormat = GL_RGB8;
+	blockBytes = 0;
+	screenSize = 0.0f;
+	lastScreenSize = 0.0f;
+	// the storage is allocated once the image is decoded and its size known
+	glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+	set_parameters(ID);
+	streamer->stream(this);
+}
+
+Texture2D::~Texture2D()
+{
+	if (stream != NULL)
+	{
+		// the streamer drops streams whose texture is gone
+		stream->texture = NULL;
+	}
+	glDeleteTextures(1, &ID);
+}
+
 void Texture2D::use()
 {
-	glBindTexture(GL_TEXTURE_2D, ID);
+	glBindTexture(GL_TEXTURE_2D, id());
+}
+
+unsigned int Texture2D::id()
+{
+	return resident ? ID : placeholderID;
+}
+
+bool Texture2D::is_resident()
+{
+	return resident;
+}
+
+const char* Texture2D::path()
+{
+	return filePath.c_str();
+}
+
+void Texture2D::record_screen_size(float pixels)
+{
+	if (pixels > screenSize)
+	{
+		screenSize = pixels;
+	}
+}
+
+int Texture2D::level_for_screen_size(float pixels)
+{
+	int size = width > height ? width : height;
+	int level = 0;
+	while (level < levelCount - 1 && (float)(size >> (level + 1)) >= pixels)
+	{
+		level++;
+	}
+	return level;
+}
+
+size_t Texture2D::storage_bytes(int finestLevel)
+{
+	size_t bytes = 0;
+	for (int level = finestLevel; level < levelCount; level++)
+	{
+		int levelWidth = level_size(width, level);
+		int levelHeight = level_size(height, level);
+		bytes += blockBytes != 0 ? (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes : (size_t)levelWidth * levelHeight * 4;
+	}
+	return bytes;
+}
+
+void Texture2D::reallocate(int finestLevel)
+{
+	// immutable storage can't be resized, so the levels kept are copied into a new texture on the GPU
+	unsigned int replacement;
+	glCreateTextures(GL_TEXTURE_2D, 1, &replacement);
+	set_parameters(replacement);
+	glTextureStorage2D(replacement, levelCount - finestLevel, internalFormat, level_size(width, finestLevel), level_size(height, finestLevel));
+	int keptLevel = residentLevel > finestLevel ? residentLevel : finestLevel;
+	for (int level = keptLevel; level < levelCount; level++)
+	{
+		glCopyImageSubData(ID, GL_TEXTURE_2D, level - storageLevel, 0, 0, 0, replacement, GL_TEXTURE_2D, level - finestLevel, 0, 0, 0, level_size(width, level), level_size(height, level), 1);
+	}
+	glTextureParameteri(replacement, GL_TEXTURE_BASE_LEVEL, keptLevel - finestLevel);
+	glDeleteTextures(1, &ID);
+	ID = replacement;
+	storageLevel = finestLevel;
+	residentLevel = keptLevel;
+}
+
+/*
+Texture Cache
+*/
+
+TextureCache::TextureCache(TextureStreamer* streamer)
+{
+	this->streamer = streamer;
+}
+
+TextureCache::~TextureCache()
+{
+	for (std::unordered_map<std::string, TextureCacheEntry>::iterator entry = entries.begin(); entry != entries.end(); entry++)
+	{
+		delete entry->second.texture;
+	}
+}
+
+std::string TextureCache::key(const char* path)
+{
+	return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+Texture2D* TextureCache::acquire(const char* path, bool colour)
+{
+	std::string entryKey = key(path);
+	std::unordered_map<std::string, TextureCacheEntry>::iterator entry = entries.find(entryKey);
+	if (entry != entries.end())
+	{
+		entry->second.references++;
+		return entry->second.texture;
+	}
+	TextureCacheEntry newEntry;
+	newEntry.texture = new Texture2D(path, streamer, colour);
+	newEntry.references = 1;
+	entries[entryKey] = newEntry;
+	return newEntry.texture;
+}
+
+void TextureCache::release(Texture2D* texture)
+{
+	std::unordered_map<std::string, TextureCacheEntry>::iterator entry = entries.find(key(texture->path()));
+	if (entry != entries.end() && entry->second.texture == texture)
+	{
+		entry->second.references--;
+		if (entry->second.references == 0)
+		{
+			delete texture;
+			entries.erase(entry);
+		}
+	}
+}
+
+unsigned int TextureCache::count()
+{
+	return entries.size();
+}
+
+size_t TextureCache::video_memory()
+{
+	size_t bytes = 0;
+	for (std::unordered_map<std::string, TextureCacheEntry>::iterator entry = entries.begin(); entry != entries.end(); entry++)
+	{
+		bytes += entry->second.texture->storage_bytes(entry->second.texture->storageLevel);
+	}
+	return bytes;
+}
+
+unsigned int TextureCache::update_residency(size_t budget)
+{
+	// the textures whose levels can change, and what the storage would take if every texture had the levels it wants
+	std::vector<Texture2D*> textures;
+	size_t stored = 0;
+	size_t wanted = 0;
+	for (std::unordered_map<std::string, TextureCacheEntry>::iterator entry = entries.begin(); entry != entries.end(); entry++)
+	{
+		Texture2D* texture = entry->second.texture;
+		texture->lastScreenSize = texture->screenSize;
+		texture->screenSize = 0.0f;
+		size_t textureBytes = texture->storage_bytes(texture->storageLevel);
+		stored += textureBytes;
+		if (texture->levelCount > 0 && texture->stream == NULL)
+		{
+			textures.push_back(texture);
+		}
+		else
+		{
+			wanted += textureBytes;
+		}
+	}
+	std::sort(textures.begin(), textures.end(), [](Texture2D* texture1, Texture2D* texture2)
+	{
+		return texture1->lastScreenSize < texture2->lastScreenSize;
+	});
+	std::vector<int> wantedLevels(textures.size());
+	for (unsigned int textureIndex = 0; textureIndex < textures.size(); textureIndex++)
+	{
+		wantedLevels[textureIndex] = textures[textureIndex]->level_for_screen_size(textures[textureIndex]->lastScreenSize);
+		wanted += textures[textureIndex]->storage_bytes(wantedLevels[textureIndex]);
+	}
+
+	// over budget, every texture gives up its finest level in turn, smallest on screen first
+	bool reduced = true;
+	while (wanted > budget && reduced)
+	{
+		reduced = false;
+		for (unsigned int textureIndex = 0; textureIndex < textures.size() && wanted > budget; textureIndex++)
+		{
+			Texture2D* texture = textures[textureIndex];
+			int level = wantedLevels[textureIndex];
+			if (level < texture->levelCount - 1)
+			{
+				wanted -= texture->storage_bytes(level) - texture->storage_bytes(level + 1);
+				wantedLevels[textureIndex] = level + 1;
+				reduced = true;
+			}
+		}
+	}
+
+	// largest on screen first, so they are the first refined
+	unsigned int reallocated = 0;
+	unsigned int refinements = 0;
+	for (int textureIndex = (int)textures.size() - 1; textureIndex >= 0; textureIndex--)
+	{
+		Texture2D* texture = textures[textureIndex];
+		int level = wantedLevels[textureIndex];
+		// a level of slack stops textures drawn at around a level's size being moved back and forth, unless the memory is needed
+		if (level > texture->storageLevel + 1 || (level > texture->storageLevel && stored > budget))
+		{
+			stored -= texture->storage_bytes(texture->storageLevel) - texture->storage_bytes(level);
+			texture->reallocate(level);
+			reallocated++;
+		}
+		else if (level < texture->residentLevel && refinements < REFINEMENTS_PER_UPDATE)
+		{
+			streamer->refine(texture, level);
+			refinements++;
+		}
+	}
+	return reallocated;
 }
\ No newline at end of file
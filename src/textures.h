@@ -1,6 +1,12 @@
 #ifndef STERLING_TEXTURES_H
 #define STERLING_TEXTURES_H
 
+#include <string>
+#include <unordered_map>
+
+class TextureStreamer;
+struct TextureStream;
+
 struct ColourRGBA
 {
 public:
@@ -17,10 +23,155 @@ private:
 	int width;
 	int height;
 	int channelCount;
+	std::string filePath;
+	/// <summary>
+	/// Whether any of the texture's levels have been uploaded. Until then a placeholder is bound in its place.
+	/// </summary>
+	bool resident;
+	unsigned int placeholderID;
+	/// <summary>
+	/// Whether the image is sRGB colour, rather than data such as bumps or shininess, so its levels are averaged in linear light
+	/// </summary>
+	bool colour;
+	/// <summary>
+	/// The texture's stream while it is still being loaded, NULL once it has finished
+	/// </summary>
+	TextureStream* stream;
+	/// <summary>
+	/// How much of the texture's full chain of levels is in video memory. Its storage holds the levels from storageLevel
+	/// down, and OpenGL numbers them from there. Of those, the levels from residentLevel down have been uploaded.
+	/// levelCount is 0 until the image has been decoded.
+	/// </summary>
+	int levelCount;
+	int storageLevel;
+	int residentLevel;
+	unsigned int internalFormat;
+	/// <summary>
+	/// The bytes of each 4x4 block if the texture is block compressed, 0 if it takes 4 bytes a pixel
+	/// </summary>
+	unsigned int blockBytes;
+	/// <summary>
+	/// The most pixels the texture was drawn across since the cache last updated residency, and at that update
+	/// </summary>
+	float screenSize;
+	float lastScreenSize;
+
+	/// <summary>
+	/// Move the texture into new storage holding the levels from a level down, copying over the uploaded levels it keeps.
+	/// The texture's ID changes.
+	/// </summary>
+	void reallocate(int finestLevel);
+
+	friend class TextureStreamer;
+	friend class TextureCache;
 
 public:
+	/// <summary>
+	/// Load a colour texture on the spot, decoding and uploading it before returning
+	/// </summary>
 	Texture2D(const char* path);
+	/// <summary>
+	/// Load a texture in the background. The placeholder stands in for it until its smallest levels have been uploaded.
+	/// </summary>
+	/// <param name="path">The image file</param>
+	/// <param name="streamer">What decodes and uploads the texture</param>
+	/// <param name="colour">Whether the image is sRGB colour rather than data</param>
+	Texture2D(const char* path, TextureStreamer* streamer, bool colour);
+	/// <summary>
+	/// Delete the OpenGL texture, abandoning its stream if it is still loading
+	/// </summary>
+	~Texture2D();
 	void use();
+	/// <summary>
+	/// The OpenGL texture ID, the placeholder's while the texture isn't resident
+	/// </summary>
+	unsigned int id();
+	/// <summary>
+	/// Whether at least some of the texture's own levels have been uploaded
+	/// </summary>
+	bool is_resident();
+	/// <summary>
+	/// The path the texture was loaded from
+	/// </summary>
+	const char* path();
+	/// <summary>
+	/// Record that the texture was drawn across a number of pixels, for deciding which of its levels it keeps
+	/// </summary>
+	void record_screen_size(float pixels);
+	/// <summary>
+	/// The finest level worth keeping for a texture drawn across a number of pixels: the coarsest with at least as many
+	/// texels across as there are pixels, which is the finest trilinear filtering samples. The coarsest level if the
+	/// texture wasn't drawn.
+	/// </summary>
+	int level_for_screen_size(float pixels);
+	/// <summary>
+	/// The bytes of video memory the levels from a level down take
+	/// </summary>
+	size_t storage_bytes(int finestLevel);
+};
+
+/// <summary>
+/// Shares one texture between everything using the same image file, so each image is decoded and uploaded once.
+/// Textures are counted by reference and deleted when the last is given back.
+/// </summary>
+class TextureCache
+{
+private:
+	struct TextureCacheEntry
+	{
+		Texture2D* texture;
+		unsigned int references;
+	};
+	/// <summary>
+	/// Keyed by the normalised path, so different spellings of the same file share an entry
+	/// </summary>
+	std::unordered_map<std::string, TextureCacheEntry> entries;
+	TextureStreamer* streamer;
+
+	static std::string key(const char* path);
+
+public:
+	/// <summary>
+	/// The most textures update_residency starts streaming finer levels for at once
+	/// </summary>
+	static const unsigned int REFINEMENTS_PER_UPDATE = 8;
+
+	/// <param name="streamer">What loads textures that aren't in the cache</param>
+	TextureCache(TextureStreamer* streamer);
+	/// <summary>
+	/// Delete every texture, whatever its references
+	/// </summary>
+	~TextureCache();
+
+	/// <summary>
+	/// Take a reference to the texture of an image file, streaming it in if it isn't already cached
+	/// </summary>
+	/// <param name="path">The image file</param>
+	/// <param name="colour">Whether the image is sRGB colour rather than data, which decides how its levels are
+	/// averaged. The first acquisition of a file decides it for everything sharing the texture.</param>
+	/// <returns>The shared texture</returns>
+	Texture2D* acquire(const char* path, bool colour);
+	/// <summary>
+	/// Give back a reference taken with acquire, deleting the texture if it was the last
+	/// </summary>
+	void release(Texture2D* texture);
+	/// <summary>
+	/// The number of distinct textures in the cache
+	/// </summary>
+	unsigned int count();
+	/// <summary>
+	/// The bytes of video memory the textures' storage takes
+	/// </summary>
+	size_t video_memory();
+	/// <summary>
+	/// Fit the textures' levels to the sizes they were drawn at since the last call. Textures drawn larger than their
+	/// finest level are streamed up to the level they need, and textures holding levels much finer than they need give
+	/// them up. If everything needed doesn't fit in the budget, the textures drawn smallest give up a level first, round
+	/// after round until it does. Textures still streaming are left as they are.
+	/// </summary>
+	/// <param name="budget">The most bytes of video memory the textures should take</param>
+	/// <returns>The number of textures moved to new storage, so their IDs changed</returns>
+	unsigned int update_residency(size_t budget);
 };
 
 #endif
\ No newline at end of file
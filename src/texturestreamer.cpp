@@ -0,0 +1,303 @@
+#include "texturestreamer.h"
+
+#include <filesystem>
+#include <iostream>
+#include <string.h>
+#include "stb/stb_image.h"
+
+/// <summary>
+/// A worker's part of a stream: read the transcoded .dds if there is a current one, otherwise decode the image as RGBA
+/// and build every level below it
+/// </summary>
+static void decode(TextureStream* stream)
+{
+	const char* path = stream->path.c_str();
+	bool isCompressed = std::filesystem::path(path).extension() == ".dds";
+	stream->decoded = false;
+	if (isCompressed || compressedtexture::has_current_compressed(path))
+	{
+		CompressedImage image;
+		stream->decoded = compressedtexture::read_dds(isCompressed ? path : compressedtexture::compressed_path(path).c_str(), &image);
+		if (stream->decoded)
+		{
+			stream->compressed = true;
+			stream->format = image.format;
+			stream->width = image.width;
+			stream->height = image.height;
+			stream->levels.swap(image.levels);
+		}
+	}
+	if (!stream->decoded && !isCompressed)
+	{
+		int channelCount;
+		unsigned char* data = stbi_load(path, &stream->width, &stream->height, &channelCount, 4);
+		stream->decoded = data != NULL;
+		if (stream->decoded)
+		{
+			stream->levels.push_back(std::vector<unsigned char>(data, data + (size_t)stream->width * stream->height * 4));
+			stbi_image_free(data);
+			compressedtexture::build_levels(stream->width, stream->height, stream->colour, &stream->levels);
+		}
+	}
+}
+
+TextureStreamer::TextureStreamer(JobSystem* jobs)
+{
+	this->jobs = jobs;
+	segment = 0;
+	streaming = 0;
+	fences.resize(SEGMENT_COUNT, NULL);
+
+	unsigned char white[4] = { 255, 255, 255, 255 };
+	glCreateTextures(GL_TEXTURE_2D, 1, &placeholder);
+	glTextureStorage2D(placeholder, 1, GL_RGBA8, 1, 1);
+	glTextureSubImage2D(placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, white);
+
+	// coherent, so rows copied in are visible to the uploads without flushing
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, SEGMENT_COUNT * SEGMENT_SIZE, NULL, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SEGMENT_COUNT * SEGMENT_SIZE, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for (unsigned int streamIndex = 0; streamIndex < decodedStreams.size(); streamIndex++)
+	{
+		delete decodedStreams[streamIndex];
+	}
+	for (unsigned int streamIndex = 0; streamIndex < uploadQueue.size(); streamIndex++)
+	{
+		delete uploadQueue[streamIndex];
+	}
+	for (unsigned int fence = 0; fence < fences.size(); fence++)
+	{
+		if (fences[fence] != NULL)
+		{
+			glDeleteSync(fences[fence]);
+		}
+	}
+	glUnmapNamedBuffer(buffer);
+	glDeleteBuffers(1, &buffer);
+	glDeleteTextures(1, &placeholder);
+}
+
+void TextureStreamer::start(Texture2D* texture, int firstLevel)
+{
+	TextureStream* stream = new TextureStream();
+	stream->texture = texture;
+	stream->path = texture->path();
+	stream->colour = texture->colour;
+	stream->width = 0;
+	stream->height = 0;
+	stream->decoded = false;
+	stream->compressed = false;
+	stream->format = BLOCK_FORMAT_BC1;
+	stream->firstLevel = firstLevel;
+	stream->uploadLevel = -1;
+	stream->uploadRow = 0;
+	texture->stream = stream;
+	streaming++;
+	jobs->submit([this, stream]()
+	{
+		decode(stream);
+		std::lock_guard<std::mutex> lock(decodedStreamsMutex);
+		decodedStreams.push_back(stream);
+	});
+}
+
+void TextureStreamer::stream(Texture2D* texture)
+{
+	start(texture, -1);
+}
+
+void TextureStreamer::refine(Texture2D* texture, int level)
+{
+	if (texture->stream == NULL && texture->levelCount > 0 && level < texture->residentLevel)
+	{
+		start(texture, level);
+	}
+}
+
+void TextureStreamer::begin_upload(TextureStream* stream, unsigned int* changedIDs)
+{
+	Texture2D* texture = stream->texture;
+	// a refinement's file must still hold the chain the texture was allocated for
+	bool matches = true;
+	if (texture != NULL && stream->decoded && texture->levelCount > 0)
+	{
+		unsigned int blockBytes = stream->compressed ? compressedtexture::block_bytes(stream->format) : 0;
+		matches = stream->width == texture->width && stream->height == texture->height && (int)stream->levels.size() == texture->levelCount && blockBytes == texture->blockBytes;
+	}
+	if (texture == NULL || !stream->decoded || !matches)
+	{
+		if (texture != NULL)
+		{
+			std::cerr << (matches ? "ERROR::TEXTURE::LOAD_FAILED\n" : "ERROR::TEXTURE::CHANGED_ON_DISK\n") << stream->path << std::endl;
+			texture->stream = NULL;
+		}
+		delete stream;
+		streaming--;
+		return;
+	}
+
+	if (texture->levelCount == 0)
+	{
+		texture->width = stream->width;
+		texture->height = stream->height;
+		texture->channelCount = 4;
+		texture->levelCount = stream->levels.size();
+		texture->internalFormat = stream->compressed ? compressedtexture::gl_format(stream->format) : GL_RGB8;
+		texture->blockBytes = stream->compressed ? compressedtexture::block_bytes(stream->format) : 0;
+		// the levels the last residency pass saw the texture drawn large enough to need. Before it has been seen every
+		// level is uploaded, since the image is decoded now and fetching finer levels later would decode it again.
+		stream->firstLevel = texture->lastScreenSize > 0.0f ? texture->level_for_screen_size(texture->lastScreenSize) : 0;
+		texture->storageLevel = stream->firstLevel;
+		texture->residentLevel = texture->levelCount;
+		int storageWidth = stream->width >> texture->storageLevel > 1 ? stream->width >> texture->storageLevel : 1;
+		int storageHeight = stream->height >> texture->storageLevel > 1 ? stream->height >> texture->storageLevel : 1;
+		glTextureStorage2D(texture->ID, texture->levelCount - texture->storageLevel, texture->internalFormat, storageWidth, storageHeight);
+	}
+	else if (stream->firstLevel < texture->storageLevel)
+	{
+		texture->reallocate(stream->firstLevel);
+		(*changedIDs)++;
+	}
+	// the levels finer than the first, and those the texture already has, are never uploaded
+	for (int level = 0; level < stream->firstLevel; level++)
+	{
+		std::vector<unsigned char>().swap(stream->levels[level]);
+	}
+	stream->uploadLevel = texture->residentLevel - 1;
+	stream->uploadRow = 0;
+	if (stream->uploadLevel < stream->firstLevel)
+	{
+		texture->stream = NULL;
+		delete stream;
+		streaming--;
+	}
+	else
+	{
+		uploadQueue.push_back(stream);
+	}
+}
+
+bool TextureStreamer::upload_rows(TextureStream* stream, size_t segmentStart, size_t* used, unsigned int* changedIDs)
+{
+	Texture2D* texture = stream->texture;
+	int levelWidth = stream->width >> stream->uploadLevel > 1 ? stream->width >> stream->uploadLevel : 1;
+	int levelHeight = stream->height >> stream->uploadLevel > 1 ? stream->height >> stream->uploadLevel : 1;
+	// OpenGL numbers the levels from the finest in the texture's storage
+	int storedLevel = stream->uploadLevel - texture->storageLevel;
+	// compressed levels are uploaded a row of blocks at a time
+	int rowHeight = stream->compressed ? 4 : 1;
+	int rowCount = (levelHeight + rowHeight - 1) / rowHeight;
+	size_t rowBytes = stream->compressed ? (size_t)((levelWidth + 3) / 4) * compressedtexture::block_bytes(stream->format) : (size_t)levelWidth * 4;
+	size_t rows = (SEGMENT_SIZE - *used) / rowBytes;
+	if (rows > (size_t)(rowCount - stream->uploadRow))
+	{
+		rows = rowCount - stream->uploadRow;
+	}
+	if (rows == 0)
+	{
+		return true;
+	}
+	memcpy(mapped + segmentStart + *used, stream->levels[stream->uploadLevel].data() + stream->uploadRow * rowBytes, rows * rowBytes);
+	int top = stream->uploadRow * rowHeight;
+	int height = (int)rows * rowHeight < levelHeight - top ? (int)rows * rowHeight : levelHeight - top;
+	if (stream->compressed)
+	{
+		glCompressedTextureSubImage2D(texture->ID, storedLevel, 0, top, levelWidth, height, compressedtexture::gl_format(stream->format), rows * rowBytes, (const void*)(segmentStart + *used));
+	}
+	else
+	{
+		glTextureSubImage2D(texture->ID, storedLevel, 0, top, levelWidth, height, GL_RGBA, GL_UNSIGNED_BYTE, (const void*)(segmentStart + *used));
+	}
+	*used += rows * rowBytes;
+	stream->uploadRow += rows;
+	if (stream->uploadRow == rowCount)
+	{
+		// sampling can start from the completed level
+		glTextureParameteri(texture->ID, GL_TEXTURE_BASE_LEVEL, storedLevel);
+		texture->residentLevel = stream->uploadLevel;
+		std::vector<unsigned char>().swap(stream->levels[stream->uploadLevel]);
+		if (!texture->resident)
+		{
+			texture->resident = true;
+			(*changedIDs)++;
+		}
+		stream->uploadLevel--;
+		stream->uploadRow = 0;
+		if (stream->uploadLevel < stream->firstLevel)
+		{
+			texture->stream = NULL;
+			uploadQueue.pop_front();
+			delete stream;
+			streaming--;
+		}
+	}
+	return false;
+}
+
+unsigned int TextureStreamer::update()
+{
+	unsigned int changedIDs = 0;
+	{
+		std::lock_guard<std::mutex> lock(decodedStreamsMutex);
+		for (unsigned int streamIndex = 0; streamIndex < decodedStreams.size(); streamIndex++)
+		{
+			begin_upload(decodedStreams[streamIndex], &changedIDs);
+		}
+		decodedStreams.clear();
+	}
+
+	bool segmentFree = true;
+	if (fences[segment] != NULL)
+	{
+		// the GPU may still be reading the segment from the last time round the ring
+		segmentFree = glClientWaitSync(fences[segment], 0, 0) != GL_TIMEOUT_EXPIRED;
+		if (segmentFree)
+		{
+			glDeleteSync(fences[segment]);
+			fences[segment] = NULL;
+		}
+	}
+	if (segmentFree && !uploadQueue.empty())
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		size_t segmentStart = (size_t)segment * SEGMENT_SIZE;
+		size_t used = 0;
+		bool segmentFull = false;
+		while (!uploadQueue.empty() && !segmentFull)
+		{
+			TextureStream* stream = uploadQueue.front();
+			if (stream->texture == NULL)
+			{
+				// the texture was deleted before it finished loading
+				uploadQueue.pop_front();
+				delete stream;
+				streaming--;
+			}
+			else
+			{
+				segmentFull = upload_rows(stream, segmentStart, &used, &changedIDs);
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		segment = (segment + 1) % SEGMENT_COUNT;
+	}
+	return changedIDs;
+}
+
+unsigned int TextureStreamer::placeholder_id()
+{
+	return placeholder;
+}
+
+unsigned int TextureStreamer::textures_streaming()
+{
+	return streaming;
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#ifndef STERLING_TEXTURESTREAMER_H
+#define STERLING_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "compressedtexture.h"
+#include "jobs.h"
+#include "textures.h"
+
+/// <summary>
+/// A texture on its way to the GPU: decoded on a worker into a full chain of levels, then uploaded smallest level first.
+/// A texture that is already resident is refined by a stream of just the finer levels it is missing.
+/// </summary>
+struct TextureStream
+{
+	/// <summary>
+	/// NULL if the texture was deleted before it finished loading
+	/// </summary>
+	Texture2D* texture;
+	std::string path;
+	/// <summary>
+	/// Every level, largest first, as tightly packed RGBA or as blocks if compressed. Each is freed once uploaded.
+	/// </summary>
+	std::vector<std::vector<unsigned char>> levels;
+	int width;
+	int height;
+	/// <summary>
+	/// Whether the image is sRGB colour, so its levels are averaged in linear light
+	/// </summary>
+	bool colour;
+	bool decoded;
+	bool compressed;
+	BlockFormat format;
+	/// <summary>
+	/// The finest level to upload. Until the image is decoded this is only known for refinements, and is -1 otherwise.
+	/// </summary>
+	int firstLevel;
+	/// <summary>
+	/// The level being uploaded, and the first of its rows (of blocks, if compressed) not yet uploaded
+	/// </summary>
+	int uploadLevel;
+	int uploadRow;
+};
+
+/// <summary>
+/// Streams textures in without stalling the main thread. Workers read transcoded .dds files, or decode the images and
+/// build their mip chains, and each frame the main thread copies as many rows as fit into the next segment of a
+/// persistently mapped pixel buffer ring and uploads them from there. A segment is only refilled once the GPU has
+/// signalled it is done reading it.
+/// </summary>
+class TextureStreamer
+{
+private:
+	JobSystem* jobs;
+	/// <summary>
+	/// A white pixel, bound in place of textures that aren't resident yet
+	/// </summary>
+	unsigned int placeholder;
+	/// <summary>
+	/// The pixel buffer ring, mapped for the streamer's lifetime, and a fence per segment for the uploads from it
+	/// </summary>
+	unsigned int buffer;
+	unsigned char* mapped;
+	std::vector<GLsync> fences;
+	unsigned int segment;
+	/// <summary>
+	/// Streams the workers have finished decoding, waiting to be picked up by the main thread
+	/// </summary>
+	std::vector<TextureStream*> decodedStreams;
+	std::mutex decodedStreamsMutex;
+	/// <summary>
+	/// Streams being uploaded, in the order they were decoded
+	/// </summary>
+	std::deque<TextureStream*> uploadQueue;
+	unsigned int streaming;
+
+	/// <summary>
+	/// Queue a texture's levels from a level down to be decoded and uploaded, -1 to leave it to when its size is known
+	/// </summary>
+	void start(Texture2D* texture, int firstLevel);
+	/// <summary>
+	/// Allocate the storage of a decoded texture, or make room in it for a refinement, and queue its levels.
+	/// Reports it if it couldn't be decoded.
+	/// </summary>
+	/// <param name="changedIDs">Counts the textures moved to new storage</param>
+	void begin_upload(TextureStream* stream, unsigned int* changedIDs);
+	/// <summary>
+	/// Copy as many of a stream's remaining rows in its current level as fit into the segment, and upload them
+	/// </summary>
+	/// <param name="used">The bytes of the segment already used, advanced past the rows copied</param>
+	/// <param name="changedIDs">Counts the textures made resident</param>
+	/// <returns>Whether the segment was too full for even one row</returns>
+	bool upload_rows(TextureStream* stream, size_t segmentStart, size_t* used, unsigned int* changedIDs);
+
+public:
+	static const unsigned int SEGMENT_COUNT = 3;
+	/// <summary>
+	/// The most bytes uploaded in a frame
+	/// </summary>
+	static const unsigned int SEGMENT_SIZE = 4 * 1024 * 1024;
+
+	/// <param name="jobs">The workers to decode on</param>
+	TextureStreamer(JobSystem* jobs);
+	/// <summary>
+	/// The job system must be finished with before the streamer is deleted
+	/// </summary>
+	~TextureStreamer();
+
+	/// <summary>
+	/// Queue a texture to be decoded and uploaded. Called by the texture's streaming constructor. A texture a residency
+	/// pass has already seen drawn only gets the levels needed for that size; otherwise every level is uploaded.
+	/// </summary>
+	void stream(Texture2D* texture);
+	/// <summary>
+	/// Stream in the levels of a resident texture finer than it has, from a level down. Ignored while it is still streaming.
+	/// </summary>
+	void refine(Texture2D* texture, int level);
+	/// <summary>
+	/// Upload the next segment's worth of levels. Called once a frame.
+	/// </summary>
+	/// <returns>The number of textures that became resident or were moved to new storage, so their IDs changed</returns>
+	unsigned int update();
+	unsigned int placeholder_id();
+	/// <summary>
+	/// The number of textures queued but not yet fully uploaded
+	/// </summary>
+	unsigned int textures_streaming();
+};
+
+#endif
\ No newline at end of file